@@ -17,36 +17,133 @@ Customer::~Customer() {
 	term.meta.control.cmd = Control::TERMINATE;
 	receive_queue_.Push(term);
 	receive_thread_->join();
+
+	for (auto& chunk: trackers_) {
+		delete[] chunk.load();
+	}
 }
 
 int Customer::NewRequest(int receiver) {
-	std::lock_guard lock(tracker_mu_);
 	int num_nodes = PostOffice::Get()->GetNodeIDs(receiver).size();
-	tracker_.emplace_back(num_nodes, 0);
-	return tracker_.size() - 1;
+	int request_id = next_request_.fetch_add(1);
+	unsigned chunk = std::bit_width((static_cast<unsigned>(request_id) >> kFirstChunkBits) + 1) - 1;
+	CHECK_LT(chunk, (unsigned)kMaxChunks) << "too many requests";
+	if (!trackers_[chunk].load(std::memory_order_acquire)) {
+		// 多个线程同时需要新的块时，只有一个分配的块被使用
+		Tracker* fresh = new Tracker[static_cast<size_t>(kFirstChunk) << chunk];
+		Tracker* expected = nullptr;
+		if (!trackers_[chunk].compare_exchange_strong(expected, fresh, std::memory_order_acq_rel)) {
+			delete[] fresh;
+		}
+	}
+	// Tracker 不回收：块按 2 的幂增大，分配的总数不超过请求数的两倍加 kFirstChunk
+	GetTracker(request_id).expected.store(num_nodes, std::memory_order_release);
+	return request_id;
 }
 
 void Customer::WaitRequest(int request_id) {
-	std::unique_lock ulock(tracker_mu_);
-	while (tracker_[request_id].first != tracker_[request_id].second) {
-		tracker_cond_.wait(ulock);
+	Tracker& t = GetTracker(request_id);
+	while (true) {
+		int received = t.received.load(std::memory_order_acquire);
+		if (received == t.expected.load(std::memory_order_acquire)) break;
+		t.received.wait(received, std::memory_order_acquire);
+	}
+}
+
+bool Customer::WaitRequest(int request_id, std::chrono::milliseconds timeout) {
+	if (timeout.count() < 0) {
+		WaitRequest(request_id);
+		return true;
+	}
+	return WaitAll({request_id}, timeout);
+}
+
+bool Customer::WaitAll(const std::vector<int>& request_ids, std::chrono::milliseconds timeout) {
+	if (timeout.count() < 0) {
+		for (int id: request_ids) {
+			WaitRequest(id);
+		}
+		return true;
+	}
+	auto deadline = std::chrono::steady_clock::now() + timeout;
+	// 已完成的请求不需要再检查
+	size_t done = 0;
+	return WaitUntil([&]() {
+		while (done < request_ids.size() && IsDone(request_ids[done])) ++done;
+		return done == request_ids.size();
+	}, &deadline);
+}
+
+int Customer::WaitAny(const std::vector<int>& request_ids, std::chrono::milliseconds timeout) {
+	int index = -1;
+	auto any_done = [&]() {
+		for (size_t i = 0; i < request_ids.size(); ++i) {
+			if (IsDone(request_ids[i])) {
+				index = i;
+				return true;
+			}
+		}
+		return false;
+	};
+	if (timeout.count() < 0) {
+		WaitUntil(any_done, nullptr);
+	} else {
+		auto deadline = std::chrono::steady_clock::now() + timeout;
+		WaitUntil(any_done, &deadline);
+	}
+	return index;
+}
+
+bool Customer::WaitUntil(const std::function<bool()>& done, const std::chrono::steady_clock::time_point* deadline) {
+	if (!deadline) {
+		while (true) {
+			// 先读取完成数再检查，使检查之后完成的请求一定会唤醒等待
+			uint64_t completions = completions_.load();
+			if (done()) return true;
+			completions_.wait(completions);
+		}
 	}
-	// TODO: tracker_[rid] 不会被删除，vector 会一直变大。
-	// 考虑记录 Wait 的数量，然后在解除 Wait、数量降低到0时尝试删除。还需要保证后续进入 Wait 的能直接返回。
-	// 由于是 vector，可以记录一个偏移量 base，tracker[t] 实际对应 base+t 的时间戳
-	// ts < base 的请求都已完成，ts >= base 的请求保证仍在 vector 内
-	// 当“Wait 数量降低到0时”触发一次检查：如果 ts 之前的请求都已完成（可能还要一个 bool 数组/bitset）
-	// 且 ts-base 即当前下标较大，加锁将 vector 后面的对象移动到前面、减少其最大大小，更新 base
+	// seq_cst，见 Complete
+	timed_waiters_.fetch_add(1, std::memory_order_seq_cst);
+	bool ok;
+	{
+		std::unique_lock<std::mutex> lk(timed_mu_);
+		ok = timed_cond_.wait_until(lk, *deadline, done);
+	}
+	--timed_waiters_;
+	return ok;
 }
 
 int Customer::GetResponse(int request_id) {
-	std::lock_guard<std::mutex> lock(tracker_mu_);
-	return tracker_[request_id].second;
+	return GetTracker(request_id).received.load(std::memory_order_acquire);
+}
+
+void Customer::Complete(int request_id, int cnt) {
+	Tracker& t = GetTracker(request_id);
+	// 与带超时的等待者构成 Dekker 式的握手：等待者先增加 timed_waiters_ 再检查 received，这里先增加 received 再检查 timed_waiters_。
+	// 两边都需要 seq_cst，否则双方可能都读到旧值，等待者错过通知，一直等到超时
+	int received = t.received.fetch_add(cnt, std::memory_order_seq_cst) + cnt;
+	if (!cnt || received != t.expected.load(std::memory_order_seq_cst)) return;
+	t.received.notify_all();
+	completions_.fetch_add(1);
+	completions_.notify_all();
+	if (timed_waiters_.load(std::memory_order_seq_cst)) {
+		// 加锁使等待者不会在检查条件之后、开始等待之前错过通知
+		std::lock_guard<std::mutex> lk(timed_mu_);
+		timed_cond_.notify_all();
+	}
 }
 
 void Customer::AddResponse(int request_id, int cnt) {
-	std::lock_guard<std::mutex> lock(tracker_mu_);
-	tracker_[request_id].second += cnt;
+	Complete(request_id, cnt);
+}
+
+void Customer::AddExpectedResponse(int request_id, int cnt) {
+	GetTracker(request_id).expected.fetch_add(cnt, std::memory_order_acq_rel);
+}
+
+int Customer::GetExpectedResponse(int request_id) {
+	return GetTracker(request_id).expected.load(std::memory_order_acquire);
 }
 
 void Customer::ReceiveThread() {
@@ -60,11 +157,7 @@ void Customer::ReceiveThread() {
 		if (!msg.meta.request) {
 			// 该消息是一条回复
 			// 回复的 request_id 肯定是之前发送的有效的下标
-			std::lock_guard<std::mutex> lock(tracker_mu_);
-			int r_id = msg.meta.timestamp;
-			if (++tracker_[r_id].second == tracker_[r_id].first) {
-				tracker_cond_.notify_all();
-			}
+			Complete(msg.meta.timestamp, 1);
 		}
 	}
 }
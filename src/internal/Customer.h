@@ -2,7 +2,14 @@
  * @file Customer.h
  */
 #pragma once
+#include <bit>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
 #include <functional>
+#include <condition_variable>
 
 #include "../internal/ThreadsafePQueue.h"
 
@@ -43,6 +50,36 @@ class Customer final {
 	 * @param request_id 请求所使用的 request ID
 	 */
 	void WaitRequest(int request_id);
+	/**
+	 * @brief 最多等待 timeout，返回请求是否已完成。timeout 为负数时不限制
+	 */
+	bool WaitRequest(int request_id, std::chrono::milliseconds timeout);
+
+	/**
+	 * @brief 请求是否已完成，不阻塞。也是带超时的等待的条件，读取需要 seq_cst（见 Complete）
+	 */
+	bool IsDone(int request_id) {
+		const Tracker& t = GetTracker(request_id);
+		return t.received.load(std::memory_order_seq_cst) == t.expected.load(std::memory_order_seq_cst);
+	}
+
+	/**
+	 * @brief 等待所有请求完成，最多等待 timeout（负数时不限制）。返回是否都已完成
+	 */
+	bool WaitAll(const std::vector<int>& request_ids, std::chrono::milliseconds timeout = std::chrono::milliseconds(-1));
+
+	/**
+	 * @brief 等待任意一个请求完成，最多等待 timeout（负数时不限制）。
+	 * @return 已完成的请求在 request_ids 中的下标（有多个时为最小的），超时为 -1
+	 */
+	int WaitAny(const std::vector<int>& request_ids, std::chrono::milliseconds timeout = std::chrono::milliseconds(-1));
+
+	/**
+	 * @brief 调用者是否为接收线程（回调在其中执行）。接收线程中等待请求会使其永远无法完成
+	 */
+	bool InReceiveThread() const {
+		return std::this_thread::get_id() == receive_thread_->get_id();
+	}
 
 	/**
 	 * @brief 返回指定请求已有多少个节点收到并回复确认。
@@ -51,11 +88,24 @@ class Customer final {
 	int GetResponse(int request_id);
 
 	/**
-	 * @brief 增加收到并确认指定请求的节点数量。
+	 * @brief 增加收到并确认指定请求的节点数量。请求因此完成时唤醒等待它的线程（如批量确认的 push）。
 	 * @param request_id 请求所使用的 request ID
 	 */
 	void AddResponse(int request_id, int cnt = 1);
 
+	/**
+	 * @brief 增加指定请求需要收到的回复数量。请求被分块发送时，每块都会得到一个回复。
+	 * 需要在发送请求前调用，使请求不会在所有块完成前被视为完成。
+	 * @param request_id 请求所使用的 request ID
+	 */
+	void AddExpectedResponse(int request_id, int cnt);
+
+	/**
+	 * @brief 返回指定请求需要收到的回复数量。
+	 * @param request_id 请求所使用的 request ID
+	 */
+	int GetExpectedResponse(int request_id);
+
 	/**
 	 * @brief 当系统收到*数据消息*时会执行的函数。由 Van 调用。
 	 * @param received
@@ -64,6 +114,13 @@ class Customer final {
 		receive_queue_.Push(received);
 	}
 
+	/**
+	 * @brief 已收到、还未处理的消息数
+	 */
+	size_t queue_depth() const {
+		return receive_queue_.Size();
+	}
+
 	int app_id() const {
 		return app_id_;
 	}
@@ -72,6 +129,39 @@ class Customer final {
 	}
 
  private:
+	/**
+	 * @brief 一个请求的完成情况
+	 */
+	struct Tracker {
+		/* 该请求需要的回复数量（发送给的节点数，分块时每块一个） */
+		std::atomic<int> expected{0};
+		/* 已收到的回复数量，等于 expected 时请求完成。单个请求的 WaitRequest 在它上面等待 */
+		std::atomic<int> received{0};
+	};
+
+	/* 第一块的 Tracker 数量，第 i 块为 (kFirstChunk << i) 个 */
+	static constexpr int kFirstChunkBits = 10;
+	static constexpr int kFirstChunk = 1 << kFirstChunkBits;
+	static constexpr int kMaxChunks = 32 - kFirstChunkBits;
+
+	/**
+	 * @brief 返回 request_id 的 Tracker，它所在的块需要已分配
+	 */
+	Tracker& GetTracker(int request_id) {
+		unsigned id = request_id;
+		int chunk = std::bit_width((id >> kFirstChunkBits) + 1) - 1;
+		unsigned offset = id - ((1u << chunk) - 1) * kFirstChunk;
+		return trackers_[chunk].load(std::memory_order_acquire)[offset];
+	}
+	/**
+	 * @brief 增加请求收到的回复数量，请求因此完成时唤醒等待者
+	 */
+	void Complete(int request_id, int cnt);
+	/**
+	 * @brief 阻塞直到 done 返回 true，或超过 deadline（为 nullptr 时不限制）。返回 done 的结果
+	 */
+	bool WaitUntil(const std::function<bool()>& done, const std::chrono::steady_clock::time_point* deadline);
+
 	void ReceiveThread();
 
 	int app_id_;
@@ -85,11 +175,16 @@ class Customer final {
 	/* 接收线程 */
 	std::unique_ptr<std::thread> receive_thread_;
 
-	/* tracker_[request_id] = pair(该请求被发送给了多少个节点, 已有多少个节点收到并回复确认).
-	* 记录所有请求的完成情况，以能够阻塞直到请求完成 */
-	std::vector<std::pair<int, int>> tracker_;
-	std::condition_variable tracker_cond_;
-	std::mutex tracker_mu_; // cv 用不了读写锁
+	/* 所有请求的完成情况，分块保存，块的大小依次翻倍。块分配后不会移动，读写 Tracker 不需要加锁 */
+	std::atomic<Tracker*> trackers_[kMaxChunks]{};
+	/* 下一个请求的 request ID */
+	std::atomic<int> next_request_{0};
+	/* 已完成的请求数，WaitAny 等等待多个请求时在它上面等待 */
+	std::atomic<uint64_t> completions_{0};
+	/* 带超时的等待使用条件变量（atomic 的 wait 不支持超时），只在有这样的等待者时通知 */
+	std::atomic<int> timed_waiters_{0};
+	std::condition_variable timed_cond_;
+	std::mutex timed_mu_;
 
 	DISABLE_COPY_AND_ASSIGN(Customer);
 };
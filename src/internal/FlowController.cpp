@@ -0,0 +1,89 @@
+#include "FlowController.h"
+
+#include <vector>
+
+#include "../internal/Van.h"
+
+namespace ps {
+
+FlowController::FlowController(size_t max_bytes, int max_requests, FlowControlMode mode, Van* van)
+		: max_bytes_(max_bytes), max_requests_(max_requests), mode_(mode), van_(van) {
+	CHECK_GE(max_requests_, 0);
+}
+
+bool FlowController::Admit(const Peer& peer, size_t bytes) const {
+	if (peer.requests == 0) return true;
+	if (max_requests_ && peer.requests >= max_requests_) return false;
+	if (max_bytes_ && peer.bytes + bytes > max_bytes_) return false;
+	return true;
+}
+
+void FlowController::Acquire(const Message& msg, size_t bytes) {
+	Peer& peer = peers_[msg.meta.receiver];
+	++peer.requests;
+	peer.bytes += bytes;
+	Credit& credit = credits_[{msg.meta.receiver, msg.meta.app_id, msg.meta.customer_id, msg.meta.timestamp}];
+	++credit.messages;
+	credit.bytes += bytes;
+}
+
+void FlowController::Release(int sender, int app_id, int customer_id, int timestamp) {
+	auto it = credits_.find({sender, app_id, customer_id, timestamp});
+	if (it == credits_.end()) return;
+	// 分块的回复不一定按块的顺序到达，每块归还平均的字节数，最后一块归还剩余的
+	Credit& credit = it->second;
+	size_t bytes = credit.bytes / credit.messages;
+	credit.bytes -= bytes;
+	if (--credit.messages == 0) {
+		bytes += credit.bytes;
+		credits_.erase(it);
+	}
+	Peer& peer = peers_[sender];
+	--peer.requests;
+	peer.bytes -= bytes;
+}
+
+void FlowController::Send(const Message& msg) {
+	size_t bytes = 0;
+	for (const auto& d: msg.data) {
+		bytes += d.size();
+	}
+	std::unique_lock<std::mutex> lk(mu_);
+	Peer& peer = peers_[msg.meta.receiver];
+	if (mode_ == FLOW_QUEUE) {
+		// 有请求在排队时也排队，按发送的顺序放行
+		if (!peer.queue.empty() || !Admit(peer, bytes)) {
+			peer.queue.emplace_back(msg, bytes);
+			++stalls_;
+			return;
+		}
+	} else if (!Admit(peer, bytes)) {
+		++stalls_;
+		cond_.wait(lk, [&] { return Admit(peer, bytes); });
+	}
+	Acquire(msg, bytes);
+	lk.unlock();
+	van_->Send(msg);
+}
+
+void FlowController::OnResponse(const Message& msg) {
+	std::vector<Message> ready;
+	{
+		std::lock_guard<std::mutex> lk(mu_);
+		int sender = msg.meta.sender;
+		Release(sender, msg.meta.app_id, msg.meta.customer_id, msg.meta.timestamp);
+		Peer& peer = peers_[sender];
+		while (!peer.queue.empty() && Admit(peer, peer.queue.front().second)) {
+			auto& [m, bytes] = peer.queue.front();
+			Acquire(m, bytes);
+			ready.push_back(std::move(m));
+			peer.queue.pop_front();
+		}
+	}
+	cond_.notify_all();
+	for (const auto& m: ready) {
+		van_->Send(m);
+	}
+}
+
+} // namespace ps
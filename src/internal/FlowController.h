@@ -0,0 +1,115 @@
+/**
+ * @file FlowController.h
+ */
+#pragma once
+#include <map>
+#include <deque>
+#include <mutex>
+#include <tuple>
+#include <atomic>
+#include <unordered_map>
+#include <condition_variable>
+
+#include "../internal/Message.h"
+
+namespace ps {
+
+class Van;
+
+/**
+ * @brief 对方的额度不足时如何处理新的请求
+ */
+enum FlowControlMode {
+	/* 发送请求的线程阻塞，直到额度足够 */
+	FLOW_BLOCK,
+	/* 请求放入队列，调用立即返回；收到回复、额度足够时由接收线程发送 */
+	FLOW_QUEUE
+};
+
+inline const char* const FlowControlModeName[] = {
+	"BLOCK",
+	"QUEUE"
+};
+
+/**
+ * @brief worker 对每个 server 的基于额度的流量控制：限制已发出、还未收到回复的数据请求的数量与字节数，
+ * 使 worker 发送得再快，server 的接收队列（Customer::receive_queue_）中来自它的请求也不超过额度。
+ * 由 Van 创建（worker 设置了 PS_MAX_INFLIGHT_BYTES 或 PS_MAX_INFLIGHT_REQUESTS 时），KVWorker 通过 Send 发送数据请求，
+ * Van 收到回复时调用 OnResponse 归还额度。不能与批量确认的 push（见 KVWorker::SetPushAck）同时使用。
+ *
+ * 字节数按数据帧的大小计算。对方没有进行中的请求时，超过额度的请求也会发送，使单个很大的请求不会一直等待。
+ * 未经 Send 发送的消息（如控制消息、确认请求）不受限制。
+ */
+class FlowController {
+ public:
+	/**
+	 * @param max_bytes 每个 server 最多进行中的字节数，为 0 时不限制
+	 * @param max_requests 每个 server 最多进行中的请求数（分块时每块一个），为 0 时不限制
+	 */
+	FlowController(size_t max_bytes, int max_requests, FlowControlMode mode, Van* van);
+
+	/**
+	 * @brief 发送一条数据请求。额度足够时立即发送，否则按模式阻塞或放入队列。
+	 * 阻塞模式下不能在 Van 的接收线程中调用（额度由它归还）；Customer 的接收线程（回调）中可以调用。
+	 */
+	void Send(const Message& msg);
+	/**
+	 * @brief 收到数据请求的回复时调用（由 Van 在接收线程中调用），归还额度并发送队列中可以发送的请求
+	 */
+	void OnResponse(const Message& msg);
+
+	/**
+	 * @brief 因额度不足等待过（阻塞或排队）的请求数
+	 */
+	size_t stalls() const {
+		return stalls_;
+	}
+
+ private:
+	/**
+	 * @brief 一个 server 的额度使用情况
+	 */
+	struct Peer {
+		/* 进行中的请求数与字节数 */
+		int requests{0};
+		size_t bytes{0};
+		/* QUEUE 模式下等待发送的请求 */
+		std::deque<std::pair<Message, size_t>> queue;
+	};
+	/**
+	 * @brief 一个请求发给某个 server 的所有消息（分块时有多个）还未归还的额度
+	 */
+	struct Credit {
+		int messages{0};
+		size_t bytes{0};
+	};
+	/* (server, app_id, customer_id, timestamp) */
+	using RequestID = std::tuple<int, int, int, int>;
+
+	/**
+	 * @brief 是否可以向 peer 再发送 bytes 字节的请求。需要持有 mu_
+	 */
+	bool Admit(const Peer& peer, size_t bytes) const;
+	/**
+	 * @brief 记录将要发送的请求占用的额度。需要持有 mu_
+	 */
+	void Acquire(const Message& msg, size_t bytes);
+	/**
+	 * @brief 归还一条消息占用的额度。需要持有 mu_
+	 */
+	void Release(int sender, int app_id, int customer_id, int timestamp);
+
+	size_t max_bytes_;
+	int max_requests_;
+	FlowControlMode mode_;
+	Van* van_;
+
+	/* server 节点 ID -> 额度使用情况 */
+	std::unordered_map<int, Peer> peers_;
+	std::map<RequestID, Credit> credits_;
+	std::mutex mu_;
+	std::condition_variable cond_;
+	std::atomic<size_t> stalls_{0};
+};
+
+} // namespace ps
@@ -15,7 +15,11 @@ enum DataType: int32_t {
 	CHAR, UCHAR,
 	INT8, INT16, INT32, INT64,
 	UINT8, UINT16, UINT32, UINT64,
-	FLOAT, DOUBLE, OTHER
+	FLOAT, DOUBLE, OTHER,
+	/* 经过 utility/KeyCodec.h 编码的 key */
+	ENCODED_KEY,
+	/* 经过 utility/Quantize.h 编码的 value：FP16、BF16、按块缩放的 INT8 */
+	FLOAT16, BFLOAT16, QINT8
 };
 /**
  * @brief for debug output
@@ -24,7 +28,9 @@ static const char* DataTypeName[] = {
 	"CHAR", "UCHAR",
 	"INT8", "INT16", "INT32", "INT64",
 	"UINT8", "UINT16", "UINT32", "UINT64",
-	"FLOAT", "DOUBLE", "OTHER"
+	"FLOAT", "DOUBLE", "OTHER",
+	"ENCODED_KEY",
+	"FLOAT16", "BFLOAT16", "QINT8"
 };
 
 template <class T>
@@ -67,8 +73,9 @@ struct Control {
 	Control(): cmd(EMPTY) {}
 	~Control() = default;
 
+	/* LOAD_REPORT、PAUSE、UPDATE_RANGES 用于 server 区间的负载均衡，见 Rebalancer */
 	enum Command: int32_t {
-		EMPTY, ADD_NODE, ACK, BARRIER, HEARTBEAT, TERMINATE,
+		EMPTY, ADD_NODE, ACK, BARRIER, HEARTBEAT, TERMINATE, LOAD_REPORT, PAUSE, UPDATE_RANGES,
 	};
 
 	bool IsEmpty() const {
@@ -102,6 +109,9 @@ struct Control {
 				case BARRIER: return "BARRIER";
 				case HEARTBEAT: return "HEARTBEAT";
 				case TERMINATE: return "TERMINATE";
+				case LOAD_REPORT: return "LOAD_REPORT";
+				case PAUSE: return "PAUSE";
+				case UPDATE_RANGES: return "UPDATE_RANGES";
 			}
 			return "IMPOSSIBLE";
 		}();
@@ -163,6 +173,40 @@ struct Meta {
 	int priority{0};
 	/* 消息包含数据的总长度（指 Message::Data） */
 	size_t data_size{0};
+	/* server 回复时其参数的版本（server 已处理的 push 次数），用于 worker 判断缓存是否过时 */
+	int version{kEmpty};
+	/* worker 注册的 key 列表编号（见 KVWorker::RegisterKeys）。server 已保存该 key 列表时，消息中的 key 为空 */
+	int key_handle{kEmpty};
+	/* worker 希望 pull 回复中 value 使用的编码（quantize::Codec），0 为不编码 */
+	int pull_codec{0};
+	/* push 只包含已注册 key 列表（key_handle）的一个有序子集，server 需要将其余 value 补为 0（见 KVWorker::SetSparsification） */
+	bool sparse{false};
+	/* 第 i 位为 1 表示 data[i] 已被 Van 压缩（见 Van::SetCompressor），只由 Van 使用 */
+	uint32_t compressed{0};
+	/* pull 请求：worker 按自己保存的切分放置回复中的 value，回复的 key 与请求的相同时，server 可以不发送 key */
+	bool omit_keys{false};
+	/* 请求：worker 将 key 划分到 server 的方式（ps::Partition），使用自定义 slicer 时为空 */
+	int partition{kEmpty};
+	/* 请求：切分时使用的 server 区间表的版本（见 Rebalancer），区间表从未更新时为 0 */
+	int range_version{0};
+	/* 热点 key 副本相关的消息（ps::ReplicaOp，见 KVServer::SetHotKeyReplication），否则为空。回复中原样返回 */
+	int replica{kEmpty};
+	/* 批量确认（见 KVWorker::SetPushAck），为 0 时不使用。push 请求：server 不单独回复，这是 worker 发给它的第 ack_seq 个这样的消息；
+	 * 不是 push 的请求：请求 server 在前 ack_seq 个消息都回复后确认；回复：确认，data[0] 为确认的请求的时间戳（每个消息一个） */
+	uint64_t ack_seq{0};
+	/* 回复：server 发送时接收队列中还未处理的消息数，worker 据此调整发送顺序与间隔（见 KVWorker::SetSendOrder） */
+	int queue_depth{0};
+	/* pull 请求：worker 缓存的 value 对应的该 server 的参数版本（见 KVWorker::SetDeltaPull），否则为空。
+	 * server 可以只回复此后可能改变的 key */
+	int since_version{kEmpty};
+	/* 回复：只包含 since_version 之后可能改变的 key 及其 value，key 不省略；没有改变时 key 与 value 都为空 */
+	bool delta{false};
+	/* push 请求：worker 的这次 push 没有发给该 server 的 key，只推进它在 server 上的时钟（见 ConsistencyController::OnTick），不带数据。
+	 * push 的回复：server 使用 BSP 或 SSP，worker 需要向没有 key 的 server 发送时钟 */
+	bool tick{false};
+	/* 请求被分为 num_chunks 块分别发送（见 KVWorker::SetChunkSize），这是第 chunk_id 块。回复中原样返回 */
+	int chunk_id{0};
+	int num_chunks{1};
 	/* 可选的消息体 */
 	std::string body;
 	/* msg.data 各成员的数据类型。
@@ -187,7 +231,53 @@ struct Meta {
 				<< ", customer_id: " << customer_id
 				<< ", push: " << push
 				<< ", pull: " << pull
-				<< ", simple_app: " << simple_app << ",\n";
+				<< ", simple_app: " << simple_app;
+			if (version != kEmpty) {
+				ss << ", version: " << version;
+			}
+			if (key_handle != kEmpty) {
+				ss << ", key_handle: " << key_handle;
+			}
+			if (pull_codec) {
+				ss << ", pull_codec: " << pull_codec;
+			}
+			if (sparse) {
+				ss << ", sparse: " << sparse;
+			}
+			if (compressed) {
+				ss << ", compressed: " << compressed;
+			}
+			if (omit_keys) {
+				ss << ", omit_keys: " << omit_keys;
+			}
+			if (partition != kEmpty) {
+				ss << ", partition: " << partition;
+			}
+			if (range_version) {
+				ss << ", range_version: " << range_version;
+			}
+			if (replica != kEmpty) {
+				ss << ", replica: " << replica;
+			}
+			if (ack_seq) {
+				ss << ", ack_seq: " << ack_seq;
+			}
+			if (queue_depth) {
+				ss << ", queue_depth: " << queue_depth;
+			}
+			if (since_version != kEmpty) {
+				ss << ", since_version: " << since_version;
+			}
+			if (delta) {
+				ss << ", delta: " << delta;
+			}
+			if (tick) {
+				ss << ", tick: " << tick;
+			}
+			if (num_chunks > 1) {
+				ss << ", chunk: " << chunk_id << "/" << num_chunks;
+			}
+			ss << ",\n";
 		} else {
 			// 系统控制信息
 			NewLine("control: ") << control.DebugString(tab + 1) << ",\n";
@@ -227,6 +317,15 @@ struct Message {
 		meta.data_size += new_data.size();
 		data.push_back(std::move(new_data));
 	}
+	/**
+	 * @brief 添加已经序列化的数据，并指定其类型（比如编码后的 key）。
+	 */
+	void AddData(const SVector<char>& value, DataType type) {
+		CHECK_EQ(data.size(), meta.data_type.size());
+		meta.data_type.push_back(type);
+		meta.data_size += value.size();
+		data.push_back(value);
+	}
 
 	SVector<char>& GetKeys() {
 		CHECK_GE(data.size(), 2);
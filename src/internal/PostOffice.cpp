@@ -102,6 +102,7 @@ void PostOffice::Finalize(int customer_id, bool need_barrier) {
 		num_workers_ = 0;
 		start_stage_ = 0;
 		server_key_ranges_.clear();
+		server_key_ranges_version_ = 0;
 		heartbeats_.clear();
 		customers_.clear();
 		barrier_done_.clear();
@@ -208,7 +209,7 @@ bool PostOffice::is_recovered() const {
 	return van_->my_node().is_recovered;
 }
 
-const std::vector<Range>& PostOffice::GetServerRanges() {
+std::vector<Range> PostOffice::GetServerRanges(int* version) {
 	std::lock_guard lock(server_key_ranges_mu_);
 	if (server_key_ranges_.empty()) {
 		for (int i = 0; i < num_servers_; ++i) {
@@ -217,9 +218,37 @@ const std::vector<Range>& PostOffice::GetServerRanges() {
 			server_key_ranges_.emplace_back(begin, end);
 		}
 	}
+	if (version) {
+		*version = server_key_ranges_version_;
+	}
 	return server_key_ranges_;
 }
 
+void PostOffice::UpdateServerRanges(const std::vector<Range>& ranges, int version) {
+	CHECK_EQ(ranges.size(), static_cast<size_t>(num_servers_));
+	{
+		std::lock_guard lock(server_key_ranges_mu_);
+		server_key_ranges_ = ranges;
+		server_key_ranges_version_ = version;
+	}
+	{
+		std::unique_lock lock(requests_mu_);
+		requests_paused_ = false;
+	}
+	requests_cond_.notify_all();
+}
+
+std::shared_lock<std::shared_mutex> PostOffice::BeginRequest() {
+	std::shared_lock lock(requests_mu_);
+	requests_cond_.wait(lock, [this] { return !requests_paused_; });
+	return lock;
+}
+
+void PostOffice::PauseRequests() {
+	std::unique_lock lock(requests_mu_);
+	requests_paused_ = true;
+}
+
 std::vector<int> PostOffice::GetDeadNodes(int time_in_sec) {
 	if (!van_->IsReady() || time_in_sec == 0) {
 		return {};
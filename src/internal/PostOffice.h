@@ -2,6 +2,7 @@
 #include <mutex>
 #include <vector>
 #include <functional>
+#include <shared_mutex>
 #include <unordered_map>
 #include <condition_variable>
 
@@ -125,8 +126,30 @@ class PostOffice final {
 
 	/**
 	 * @brief 获取每个服务器存储的 key 的区间。
+	 * 区间表可能被负载均衡更新（见 Rebalancer），因此返回副本。
+	 * @param version 如果不为 nullptr，保存区间表的版本（初始为 0，每次更新加 1）
 	 */
-	const std::vector<Range>& GetServerRanges();
+	std::vector<Range> GetServerRanges(int* version = nullptr);
+	/**
+	 * @brief 区间表的版本
+	 */
+	int GetServerRangesVersion() const {
+		std::lock_guard lock(server_key_ranges_mu_);
+		return server_key_ranges_version_;
+	}
+	/**
+	 * @brief 更新区间表，并恢复被 PauseRequests 暂停的请求。
+	 */
+	void UpdateServerRanges(const std::vector<Range>& ranges, int version);
+	/**
+	 * @brief worker 发送数据请求前调用，返回的锁需要保持到请求的所有消息发出。
+	 * 区间表切换期间（PauseRequests 之后、UpdateServerRanges 之前）阻塞，保证请求不会按旧的区间表切分。
+	 */
+	std::shared_lock<std::shared_mutex> BeginRequest();
+	/**
+	 * @brief 暂停之后的数据请求：等待已进入 BeginRequest 的请求发送完，之后的 BeginRequest 阻塞。
+	 */
+	void PauseRequests();
 	/**
 	 * @brief 获取某个组所包含的节点 ID。
 	 * 如果 group_id 只是某个节点的 id，则返回 {group_id}。
@@ -193,7 +216,14 @@ class PostOffice final {
 
 	/* 每个服务器存储的 key 的区间 */
 	std::vector<Range> server_key_ranges_;
+	/* 区间表的版本 */
+	int server_key_ranges_version_{0};
 	mutable std::mutex server_key_ranges_mu_;
+	/* 发送数据请求时持有共享锁，暂停请求时持有独占锁 */
+	std::shared_mutex requests_mu_;
+	std::condition_variable_any requests_cond_;
+	/* 请求是否被暂停（区间表切换中） */
+	bool requests_paused_{false};
 	/* 每个节点上次收到心跳的时间 */
 	std::unordered_map<int, time_t> heartbeats_;
 	mutable std::mutex heartbeat_mu_;
@@ -215,6 +245,9 @@ class PostOffice final {
 	/* 日志输出。注意给初值，因为初始化 Env 和 verbose 前就可能使用 PS_LOG */
 	int verbose_{0};
 
+	/* Customer 的单元测试不启动系统，直接设置 node_ids_ */
+	friend class CustomerTest;
+
 	DISABLE_COPY_AND_ASSIGN(PostOffice);
 };
 
@@ -0,0 +1,376 @@
+#include "Rebalancer.h"
+
+#include <thread>
+#include <cstring>
+#include <algorithm>
+
+#include "../internal/Van.h"
+#include "../internal/PostOffice.h"
+
+namespace ps {
+
+namespace {
+
+/* server 每个请求抽样记录的 key 数 */
+constexpr size_t kSamplesPerRequest = 16;
+/* server 保存的样本超过这么多时压缩 */
+constexpr size_t kMaxSamples = 1 << 16;
+/* 每个负载报告包含的样本数 */
+constexpr size_t kReportSamples = 1024;
+/* 新区间的预计最大负载至少比当前低这么多才切换，避免单个热点 key 无法拆分时反复切换 */
+constexpr double kMinImprovement = 0.9;
+
+using Sample = std::pair<Key, double>;
+
+template <typename T>
+void Append(std::string* body, const T& v) {
+	body->append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+template <typename T>
+T Read(const std::string& body, size_t* pos) {
+	CHECK_LE(*pos + sizeof(T), body.size()) << "invalid rebalance message";
+	T v;
+	memcpy(&v, body.data() + *pos, sizeof(T));
+	*pos += sizeof(T);
+	return v;
+}
+
+/**
+ * @brief UPDATE_RANGES 的 body：[版本][区间数][各区间的 begin, end]
+ */
+std::string RangesBody(int version, const std::vector<Range>& ranges) {
+	std::string body;
+	Append(&body, static_cast<int32_t>(version));
+	Append(&body, static_cast<int32_t>(ranges.size()));
+	for (const auto& r: ranges) {
+		Append(&body, r.begin);
+		Append(&body, r.end);
+	}
+	return body;
+}
+std::vector<Range> BodyRanges(const std::string& body) {
+	size_t pos = sizeof(int32_t);
+	int n = Read<int32_t>(body, &pos);
+	std::vector<Range> ranges(n);
+	for (auto& r: ranges) {
+		r.begin = Read<uint64_t>(body, &pos);
+		r.end = Read<uint64_t>(body, &pos);
+	}
+	return ranges;
+}
+
+/**
+ * @brief 各区间的负载
+ */
+std::vector<double> RangeLoads(const std::vector<Sample>& samples, const std::vector<Range>& ranges) {
+	std::vector<double> loads(ranges.size(), 0);
+	for (const auto& [key, w]: samples) {
+		auto it = std::upper_bound(ranges.begin(), ranges.end(), key,
+				[](Key k, const Range& r) { return k < r.end; });
+		if (it != ranges.end()) loads[it - ranges.begin()] += w;
+	}
+	return loads;
+}
+
+} // namespace
+
+Rebalancer::Rebalancer(int interval_in_ms, double skew, Van* van)
+		: interval_(interval_in_ms), skew_(skew), van_(van) {
+	CHECK_GT(interval_, 0);
+	if (PostOffice::Get()->is_server()) {
+		report_thread_ = new std::thread(&Rebalancer::ReportThread, this);
+	}
+}
+
+Rebalancer::~Rebalancer() {
+	if (report_thread_) {
+		{
+			std::lock_guard<std::mutex> lk(exit_mu_);
+			exit_ = true;
+		}
+		exit_cond_.notify_all();
+		report_thread_->join();
+		delete report_thread_;
+	}
+}
+
+void Rebalancer::RecordLoad(const Key* keys, size_t n) {
+	if (n == 0) return;
+	size_t s = std::min(n, kSamplesPerRequest);
+	double w = static_cast<double>(n) / s;
+	std::lock_guard<std::mutex> lk(samples_mu_);
+	for (size_t i = 0; i < s; ++i) {
+		samples_.emplace_back(keys[i * n / s], w);
+	}
+	if (samples_.size() > kMaxSamples) {
+		Compact(&samples_, kMaxSamples / 4);
+	}
+}
+
+void Rebalancer::SetMigrationHandle(const std::function<void(const Message&)>& handle) {
+	std::lock_guard<std::mutex> lk(samples_mu_);
+	CHECK(!migration_handle_) << "only one KVServer per process supports rebalancing";
+	migration_handle_ = handle;
+}
+
+void Rebalancer::FinishMigration(int version) {
+	{
+		// 之前的样本按旧的区间统计，丢弃
+		std::lock_guard<std::mutex> lk(samples_mu_);
+		samples_.clear();
+	}
+	PS_LOG_INFO << "Server " << PostOffice::Get()->my_rank() << " migrated parameters for key ranges version " << version;
+	Reply(Control::UPDATE_RANGES, version);
+}
+
+void Rebalancer::OnResponse() {
+	if (--inflight_ == 0 && pausing_) {
+		pausing_ = false;
+		Reply(Control::PAUSE, version_);
+	}
+}
+
+void Rebalancer::OnControl(const Message& msg) {
+	auto cmd = msg.meta.control.cmd;
+	int version = BodyVersion(msg);
+	if (PostOffice::Get()->is_scheduler()) {
+		if (cmd == Control::LOAD_REPORT) {
+			HandleReport(msg);
+		} else if (!msg.meta.request) {
+			HandleReply(msg);
+		}
+	} else if (PostOffice::Get()->is_worker()) {
+		if (cmd == Control::PAUSE) {
+			// 等待正在发送的请求发完，之后的请求阻塞
+			PostOffice::Get()->PauseRequests();
+			version_ = version;
+			if (inflight_ == 0) {
+				Reply(Control::PAUSE, version);
+			} else {
+				pausing_ = true;
+			}
+		} else if (cmd == Control::UPDATE_RANGES) {
+			PostOffice::Get()->UpdateServerRanges(BodyRanges(msg.meta.body), version);
+			PS_LOG_INFO << "Worker " << PostOffice::Get()->my_rank() << " uses key ranges version " << version;
+		}
+	} else if (cmd == Control::UPDATE_RANGES) {
+		std::function<void(const Message&)> handle;
+		{
+			std::lock_guard<std::mutex> lk(samples_mu_);
+			handle = migration_handle_;
+		}
+		CHECK(static_cast<bool>(handle)) << "received key migration but KVServer::SetMigrationHandle is not called";
+		if (msg.meta.sender == kScheduler) {
+			PostOffice::Get()->UpdateServerRanges(BodyRanges(msg.meta.body), version);
+		}
+		handle(msg);
+	}
+}
+
+std::string Rebalancer::VersionBody(int version) {
+	std::string body;
+	Append(&body, static_cast<int32_t>(version));
+	return body;
+}
+
+int Rebalancer::BodyVersion(const Message& msg) {
+	size_t pos = 0;
+	return Read<int32_t>(msg.meta.body, &pos);
+}
+
+std::vector<Range> Rebalancer::BalanceRanges(std::vector<std::pair<Key, double>> samples, int num_servers) {
+	Compact(&samples, samples.size());
+	double total = 0;
+	for (const auto& s: samples) total += s.second;
+	std::vector<Range> ranges(num_servers);
+	Key begin = 0;
+	double sum = 0;
+	size_t i = 0;
+	for (int r = 0; r + 1 < num_servers; ++r) {
+		double target = total * (r + 1) / num_servers;
+		while (i < samples.size() && sum + samples[i].second <= target) {
+			sum += samples[i++].second;
+		}
+		// 跨过目标的样本放在离目标更近的一侧
+		Key end = kMaxKey;
+		if (i < samples.size()) {
+			if (target - sum > sum + samples[i].second - target) {
+				sum += samples[i].second;
+				end = samples[i++].first + 1;
+			} else {
+				end = samples[i].first;
+			}
+		}
+		// 每个区间至少包含一个 key，且给之后的区间留出位置
+		end = std::min(std::max(end, begin + 1), kMaxKey - (num_servers - 1 - r));
+		ranges[r] = Range(begin, end);
+		begin = end;
+	}
+	ranges[num_servers - 1] = Range(begin, kMaxKey);
+	return ranges;
+}
+
+void Rebalancer::ReportThread() {
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lk(exit_mu_);
+			if (exit_cond_.wait_for(lk, std::chrono::milliseconds(interval_), [this] { return exit_; })) {
+				return;
+			}
+		}
+		if (!van_->IsReady()) continue;
+		int version;
+		PostOffice::Get()->GetServerRanges(&version);
+		std::string body = VersionBody(version);
+		{
+			std::lock_guard<std::mutex> lk(samples_mu_);
+			if (!migration_handle_) continue;
+			Compact(&samples_, kReportSamples);
+			for (const auto& [key, w]: samples_) {
+				Append(&body, key);
+				Append(&body, w);
+			}
+			samples_.clear();
+		}
+		// 没有请求时也报告，scheduler 需要收齐所有 server 的报告
+		Message msg;
+		msg.meta.receiver = kScheduler;
+		msg.meta.request = true;
+		msg.meta.control.cmd = Control::LOAD_REPORT;
+		msg.meta.timestamp = van_->GetAvailableTimestamp();
+		msg.meta.body = std::move(body);
+		van_->Send(msg);
+	}
+}
+
+void Rebalancer::HandleReport(const Message& msg) {
+	int n = PostOffice::Get()->num_servers();
+	if (static_cast<int>(reports_.size()) != n) {
+		reports_.assign(n, {});
+		reported_.assign(n, false);
+	}
+	// 切换期间与旧区间表的报告不再有意义
+	if (state_ != IDLE || BodyVersion(msg) != version_) return;
+	int rank = PostOffice::IDToRank(msg.meta.sender);
+	CHECK_LT(rank, n);
+	const std::string& body = msg.meta.body;
+	size_t pos = sizeof(int32_t);
+	std::vector<Sample> samples;
+	while (pos < body.size()) {
+		Key key = Read<Key>(body, &pos);
+		samples.emplace_back(key, Read<double>(body, &pos));
+	}
+	reports_[rank] = std::move(samples);
+	if (!reported_[rank]) {
+		reported_[rank] = true;
+		++num_reports_;
+	}
+	if (num_reports_ < n) return;
+
+	std::vector<Sample> all;
+	for (auto& r: reports_) {
+		all.insert(all.end(), r.begin(), r.end());
+		r.clear();
+	}
+	reported_.assign(n, false);
+	num_reports_ = 0;
+	std::vector<double> loads = RangeLoads(all, PostOffice::Get()->GetServerRanges());
+	double total = 0, max = 0;
+	for (double l: loads) {
+		total += l;
+		max = std::max(max, l);
+	}
+	double mean = total / n;
+	if (total <= 0 || max <= skew_ * mean) return;
+
+	std::vector<Range> ranges = BalanceRanges(all, n);
+	std::vector<double> expected = RangeLoads(all, ranges);
+	double expected_max = *std::max_element(expected.begin(), expected.end());
+	if (expected_max > kMinImprovement * max) {
+		PS_LOG_DEBUG << "Key ranges are unbalanced (" << max / mean << "x of mean) but cannot be improved";
+		return;
+	}
+	PS_LOG_INFO << "Rebalancing key ranges: max server load " << max / mean << "x of mean, expected "
+			<< expected_max / mean << "x after rebalancing";
+	pending_ranges_ = std::move(ranges);
+	state_ = PAUSING;
+	waiting_ = SendToGroup(kWorkerGroup, Control::PAUSE, VersionBody(version_ + 1));
+}
+
+void Rebalancer::HandleReply(const Message& msg) {
+	int version = BodyVersion(msg);
+	if (version != version_ + 1) {
+		LOG(WARNING) << "Dropped outdated rebalance reply: " << msg.DebugString();
+		return;
+	}
+	auto cmd = msg.meta.control.cmd;
+	if (cmd == Control::PAUSE && state_ == PAUSING) {
+		if (--waiting_ > 0) return;
+		// 所有 worker 都没有进行中的请求，server 开始迁移参数
+		state_ = MIGRATING;
+		waiting_ = SendToGroup(kServerGroup, Control::UPDATE_RANGES, RangesBody(version, pending_ranges_));
+	} else if (cmd == Control::UPDATE_RANGES && state_ == MIGRATING) {
+		if (--waiting_ > 0) return;
+		version_ = version;
+		PostOffice::Get()->UpdateServerRanges(pending_ranges_, version);
+		SendToGroup(kWorkerGroup, Control::UPDATE_RANGES, RangesBody(version, pending_ranges_));
+		state_ = IDLE;
+		PS_LOG_INFO << "Key ranges updated to version " << version;
+	}
+}
+
+int Rebalancer::SendToGroup(int group, Control::Command cmd, const std::string& body) {
+	Message msg;
+	msg.meta.request = true;
+	msg.meta.control.cmd = cmd;
+	msg.meta.body = body;
+	std::vector<int> ids = van_->GetProcessNodeIDs(group);
+	for (int id: ids) {
+		msg.meta.receiver = id;
+		msg.meta.timestamp = van_->GetAvailableTimestamp();
+		van_->Send(msg);
+	}
+	return ids.size();
+}
+
+void Rebalancer::Reply(Control::Command cmd, int version) {
+	Message msg;
+	msg.meta.receiver = kScheduler;
+	msg.meta.request = false;
+	msg.meta.control.cmd = cmd;
+	msg.meta.timestamp = van_->GetAvailableTimestamp();
+	msg.meta.body = VersionBody(version);
+	van_->Send(msg);
+}
+
+void Rebalancer::Compact(std::vector<std::pair<Key, double>>* samples, size_t max_samples) {
+	auto& s = *samples;
+	std::sort(s.begin(), s.end());
+	// 合并相同的 key
+	size_t m = 0;
+	for (size_t i = 0; i < s.size(); ++i) {
+		if (m && s[m - 1].first == s[i].first) {
+			s[m - 1].second += s[i].second;
+		} else {
+			s[m++] = s[i];
+		}
+	}
+	s.resize(m);
+	if (m <= max_samples) return;
+	// 按累计负载分为 max_samples 段，每段用最后一个 key 代表
+	double total = 0;
+	for (const auto& p: s) total += p.second;
+	double step = total / max_samples;
+	size_t out = 0;
+	double acc = 0;
+	for (size_t i = 0; i < m; ++i) {
+		acc += s[i].second;
+		if (acc >= step || i + 1 == m) {
+			s[out++] = {s[i].first, acc};
+			acc = 0;
+		}
+	}
+	s.resize(out);
+}
+
+} // namespace ps
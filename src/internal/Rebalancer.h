@@ -0,0 +1,167 @@
+/**
+ * @file Rebalancer.h
+ */
+#pragma once
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <condition_variable>
+
+#include "../ps/Base.h"
+#include "../ps/Range.h"
+#include "../internal/Message.h"
+
+namespace std {
+class thread;
+} // std
+
+namespace ps {
+
+class Van;
+
+/**
+ * @brief 按负载调整各 server 负责的 key 区间，并在 server 之间迁移参数。只影响按区间划分（RANGE_PARTITION）的 key。
+ * 由 Van 创建（设置了 PS_REBALANCE_INTERVAL 时），需要在收发消息时调用 OnControl、OnRequestSent、OnResponse。
+ *
+ * 流程：
+ * 1. server 抽样统计请求中的 key（RecordLoad），每 interval 毫秒将负载的分布以 LOAD_REPORT 发给 scheduler；
+ * 2. scheduler 收齐所有 server 的报告后，如果负载最高的 server 超过平均的 skew 倍，按负载的分位数计算新的区间；
+ * 3. scheduler 向 worker 发送 PAUSE：worker 暂停之后的请求，等已发出的请求都收到回复后回复 scheduler；
+ * 4. scheduler 向 server 发送 UPDATE_RANGES（新的区间表与版本）：server 将不再属于自己的参数发给新的负责者
+ *    （也是 UPDATE_RANGES，带有数据），收到其它所有 server 发来的参数后回复 scheduler；
+ * 5. scheduler 向 worker 发送 UPDATE_RANGES：worker 更新区间表，恢复请求。
+ * 切换时没有进行中的请求，暂停的请求恢复后按新的区间表切分。请求带有切分时区间表的版本，server 会检查。
+ *
+ * 参数的导出与导入由 KVServer::SetMigrationHandle 设置。server 使用 BSP、SSP 时不统计负载：
+ * 暂停的 worker 会使其它 worker 的请求无法完成，且时钟是按 server 统计的。
+ */
+class Rebalancer {
+ public:
+	/**
+	 * @param interval_in_ms server 发送负载报告的间隔
+	 * @param skew 负载最高的 server 超过平均的多少倍时调整区间
+	 */
+	Rebalancer(int interval_in_ms, double skew, Van* van);
+	~Rebalancer();
+
+	/**
+	 * @brief server：记录一个请求中的 key。负载按 key 的数量计算，每个请求只抽样记录一部分 key。
+	 */
+	void RecordLoad(const Key* keys, size_t n);
+	/**
+	 * @brief server：设置收到迁移消息（UPDATE_RANGES）时的处理，由 KVServer 设置，只支持一个。
+	 * 在接收线程中调用，需要尽快返回。收到 scheduler 的 UPDATE_RANGES 时，区间表已经更新。
+	 * 设置之后才会发送负载报告。
+	 */
+	void SetMigrationHandle(const std::function<void(const Message&)>& handle);
+	/**
+	 * @brief server：已发出不再属于自己的参数，并收到其它所有 server 发来的参数后调用，通知 scheduler。
+	 */
+	void FinishMigration(int version);
+
+	/**
+	 * @brief worker：发送每条数据请求前调用（在 PostOffice::BeginRequest 之后）
+	 */
+	void OnRequestSent() {
+		++inflight_;
+	}
+	/**
+	 * @brief worker：收到数据请求的回复时调用（由 Van 在接收线程中调用）
+	 */
+	void OnResponse();
+
+	/**
+	 * @brief 处理 LOAD_REPORT、PAUSE、UPDATE_RANGES 消息（由 Van 在接收线程中调用）
+	 */
+	void OnControl(const Message& msg);
+
+	/**
+	 * @brief 迁移消息的 body，只包含区间表的版本
+	 */
+	static std::string VersionBody(int version);
+	/**
+	 * @brief 取出 UPDATE_RANGES 等消息 body 中的区间表版本
+	 */
+	static int BodyVersion(const Message& msg);
+
+	/**
+	 * @brief 按负载样本计算新的区间，使每个区间的负载接近平均。
+	 * @param samples (key, 负载)，不需要排序，key 可以重复
+	 */
+	static std::vector<Range> BalanceRanges(std::vector<std::pair<Key, double>> samples, int num_servers);
+
+ private:
+	/* scheduler 的状态 */
+	enum State {
+		/* 收集负载报告 */
+		IDLE,
+		/* 等待 worker 暂停 */
+		PAUSING,
+		/* 等待 server 迁移参数 */
+		MIGRATING
+	};
+
+	/**
+	 * @brief server 发送负载报告的线程
+	 */
+	void ReportThread();
+	/**
+	 * @brief scheduler：收到一个 server 的负载报告，收齐后判断是否需要调整区间
+	 */
+	void HandleReport(const Message& msg);
+	/**
+	 * @brief scheduler：收到 PAUSE 或 UPDATE_RANGES 的回复，推进切换流程
+	 */
+	void HandleReply(const Message& msg);
+	/**
+	 * @brief 向 group 中的每个进程发送一条控制消息
+	 * @return 发送的消息数
+	 */
+	int SendToGroup(int group, Control::Command cmd, const std::string& body);
+	/**
+	 * @brief 回复 scheduler
+	 */
+	void Reply(Control::Command cmd, int version);
+	/**
+	 * @brief 压缩样本：按 key 排序后合并为最多 max_samples 个等负载的样本
+	 */
+	static void Compact(std::vector<std::pair<Key, double>>* samples, size_t max_samples);
+	/* 单元测试直接调用 Compact */
+	friend class RebalancerTest;
+
+	int interval_;
+	double skew_;
+	Van* van_;
+
+	/* server：抽样的负载 */
+	std::vector<std::pair<Key, double>> samples_;
+	std::mutex samples_mu_;
+	std::function<void(const Message&)> migration_handle_;
+	std::thread* report_thread_{nullptr};
+	bool exit_{false};
+	std::mutex exit_mu_;
+	std::condition_variable exit_cond_;
+
+	/* worker：已发出、还没有收到回复的请求数 */
+	std::atomic<int> inflight_{0};
+	/* worker：是否在等待请求完成以回复 PAUSE。只在接收线程中访问 */
+	bool pausing_{false};
+
+	/* 以下只在接收线程中访问 */
+	State state_{IDLE};
+	/* scheduler：当前区间表的版本；worker：正在暂停以切换到的版本 */
+	int version_{0};
+	/* 各 server 的负载报告，reported_[i] 表示是否已收到 server i 的报告 */
+	std::vector<std::vector<std::pair<Key, double>>> reports_;
+	std::vector<bool> reported_;
+	int num_reports_{0};
+	/* 切换中的新区间表 */
+	std::vector<Range> pending_ranges_;
+	/* 还需要收到的回复数 */
+	int waiting_{0};
+};
+
+} // namespace ps
@@ -45,6 +45,14 @@ class ThreadsafePQueue {
 		return ret; // NRVO
 	}
 
+	/**
+	 * @brief 队列中的元素数
+	 */
+	size_t Size() const {
+		std::lock_guard<std::mutex> lock(mu_);
+		return queue_.size();
+	}
+
  private:
 	struct Comparator {
 		bool operator() (const Message& x, const Message& y) {
@@ -1,5 +1,8 @@
 #include "Van.h"
+#include <chrono>
 #include <random>
+#include <cstring>
+#include <algorithm>
 
 #include "base/Log.h"
 #include "ps/Base.h"
@@ -7,6 +10,8 @@
 #include "internal/ZMQVan.h"
 #include "internal/Customer.h"
 #include "internal/Resender.h"
+#include "internal/Rebalancer.h"
+#include "internal/FlowController.h"
 #include "internal/PostOffice.h"
 #include "utility/NetworkUtils.h"
 
@@ -85,6 +90,36 @@ void Van::Start(int customer_id) {
 		heartbeat_timeout_ = Environment::GetInt("PS_HEARTBEAT_TIMEOUT");
 		drop_rate_ = Environment::GetInt("PS_DROP_RATE");
 
+		// 数据帧压缩
+		if (const char* type = Environment::Get("PS_COMPRESSION")) {
+			compressor_.reset(Compressor::Create(type));
+			CHECK(compressor_) << "Unsupported compression: " << type;
+		}
+		compress_threshold_ = Environment::GetIntOrDefault("PS_COMPRESSION_THRESHOLD", 4096);
+		compress_adaptive_ = Environment::GetIntOrDefault("PS_COMPRESSION_ADAPTIVE", 1) != 0;
+		// MB/s -> 字节/纳秒
+		compress_bandwidth_ = Environment::GetIntOrDefault("PS_COMPRESSION_BANDWIDTH", 1250) / 1000.;
+
+		// 区间负载均衡。需要在接收线程启动前创建
+		if (int interval = Environment::GetInt("PS_REBALANCE_INTERVAL"); interval != 0) {
+			rebalancer_ = new Rebalancer(interval, Environment::GetIntOrDefault("PS_REBALANCE_SKEW", 150) / 100., this);
+		}
+
+		// worker 对各 server 的流量控制
+		int max_bytes = Environment::GetInt("PS_MAX_INFLIGHT_BYTES");
+		int max_requests = Environment::GetInt("PS_MAX_INFLIGHT_REQUESTS");
+		if (PostOffice::Get()->is_worker() && (max_bytes > 0 || max_requests > 0)) {
+			FlowControlMode mode = FLOW_BLOCK;
+			if (const char* name = Environment::Get("PS_FLOW_CONTROL_MODE")) {
+				std::string upper(name);
+				std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+				auto it = std::find(std::begin(FlowControlModeName), std::end(FlowControlModeName), upper);
+				CHECK(it != std::end(FlowControlModeName)) << "unknown PS_FLOW_CONTROL_MODE: " << name;
+				mode = static_cast<FlowControlMode>(it - std::begin(FlowControlModeName));
+			}
+			flow_controller_ = new FlowController(std::max(max_bytes, 0), std::max(max_requests, 0), mode, this);
+		}
+
 		// 绑定到对应地址和端口
 		Bind(my_node_, is_scheduler_ ? 0 : 30); // scheduler 必须位于指定端口上，其它节点无所谓
 		CHECK_NE(my_node_.port, -1) << "Bind node failed";
@@ -154,6 +189,10 @@ void Van::Stop() {
 	if (resender_) {
 		delete resender_;
 	}
+	delete rebalancer_;
+	rebalancer_ = nullptr;
+	delete flow_controller_;
+	flow_controller_ = nullptr;
 
 	// 清空成员
 	start_stage_ = 0;
@@ -168,7 +207,8 @@ void Van::Stop() {
 }
 
 int Van::Send(const Message& msg) {
-	int sent = SendMsg(msg);
+	Message compressed;
+	int sent = compressor_ && Compress(msg, &compressed) ? SendMsg(compressed) : SendMsg(msg);
 	CHECK_NE(sent, -1);
 	send_bytes_ += sent;
 	if (resender_) {
@@ -179,6 +219,88 @@ int Van::Send(const Message& msg) {
 }
 
 // ---
+namespace {
+
+/* 自适应模式下暂停压缩时，每隔这么多个帧尝试压缩一次 */
+constexpr int kCompressProbe = 64;
+/* 估计的解压耗时与压缩耗时之比 */
+constexpr double kDecompressCost = 0.5;
+
+} // namespace
+
+bool Van::Compress(const Message& msg, Message* out) {
+	bool any = false;
+	for (size_t i = 0; i < msg.data.size() && i < 32; ++i) {
+		const SVector<char>& data = msg.data[i];
+		DataType type = i < msg.meta.data_type.size() ? msg.meta.data_type[i] : OTHER;
+		if (data.size() < compress_threshold_ || !ShouldCompress(type)) continue;
+		auto start = std::chrono::steady_clock::now();
+		SVector<char> buf;
+		buf.resize_uninitialized(sizeof(uint64_t) + compressor_->MaxCompressedSize(data.size()));
+		uint64_t raw_size = data.size();
+		memcpy(buf.data(), &raw_size, sizeof(raw_size));
+		size_t size = compressor_->Compress(data.data(), data.size(), buf.data() + sizeof(raw_size));
+		int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - start).count();
+		if (compress_adaptive_) {
+			RecordCompression(type, data.size(), size, ns);
+		}
+		if (sizeof(raw_size) + size >= data.size()) continue;
+		if (!any) {
+			*out = msg;
+			any = true;
+		}
+		buf.resize_uninitialized(sizeof(raw_size) + size);
+		out->data[i] = buf;
+		out->meta.compressed |= 1u << i;
+	}
+	return any;
+}
+
+void Van::Decompress(Message* msg) {
+	// 发送方可能未设置 PS_COMPRESSION，此时使用内置的算法
+	static const LZCompressor kDefault;
+	const Compressor* compressor = compressor_ ? compressor_.get() : &kDefault;
+	for (size_t i = 0; i < msg->data.size() && i < 32; ++i) {
+		if (!(msg->meta.compressed & (1u << i))) continue;
+		const SVector<char>& data = msg->data[i];
+		uint64_t raw_size;
+		CHECK_GE(data.size(), sizeof(raw_size));
+		memcpy(&raw_size, data.data(), sizeof(raw_size));
+		// 原始大小来自网络，超过压缩比的上限时数据一定有误，不能用它分配内存
+		CHECK_LE(raw_size, compressor->MaxDecompressedSize(data.size() - sizeof(raw_size)))
+				<< "Invalid raw size of data[" << i << "] from node " << msg->meta.sender;
+		SVector<char> raw = recv_pool_.Get(raw_size);
+		CHECK(compressor->Decompress(data.data() + sizeof(raw_size), data.size() - sizeof(raw_size), raw.data(), raw_size))
+				<< "Failed to decompress data[" << i << "] from node " << msg->meta.sender;
+		msg->data[i] = raw;
+	}
+	msg->meta.compressed = 0;
+}
+
+bool Van::ShouldCompress(DataType type) {
+	if (!compress_adaptive_) return true;
+	std::lock_guard<std::mutex> lk(compress_mu_);
+	if (compress_gain_[type] >= 0) return true;
+	if (--compress_probe_[type] > 0) return false;
+	compress_probe_[type] = kCompressProbe;
+	return true;
+}
+
+void Van::RecordCompression(DataType type, size_t raw, size_t compressed, int64_t ns) {
+	double saved = raw > compressed ? (raw - compressed) / compress_bandwidth_ : 0;
+	double gain = (saved - ns * (1 + kDecompressCost)) / raw;
+	std::lock_guard<std::mutex> lk(compress_mu_);
+	double& avg = compress_gain_[type];
+	bool was_on = avg >= 0;
+	avg = 0.75 * avg + 0.25 * gain;
+	if (was_on != (avg >= 0)) {
+		compress_probe_[type] = kCompressProbe;
+		PS_LOG_INFO << "Compression of " << DataTypeName[type] << (was_on ? " paused: " : " resumed: ")
+				<< avg << "ns/B";
+	}
+}
+
 void Van::HandleTerminateCmd() {
 	PS_LOG_INFO << my_node_.ShortDebugString() << " terminated";
 	ready_ = false;
@@ -253,6 +375,12 @@ void Van::HandleDataMsg(const Message& msg) {
 	Customer* customer = PostOffice::Get()->GetCustomer(app_id, customer_id, 5);
 	CHECK(customer) << "Cannot find customer with app_id: " << app_id << ", customer_id: " << customer_id
 		<< " after waiting for 5s";
+	if (rebalancer_ && !msg.meta.request && !msg.meta.simple_app) {
+		rebalancer_->OnResponse();
+	}
+	if (flow_controller_ && !msg.meta.request && !msg.meta.simple_app) {
+		flow_controller_->OnResponse(msg);
+	}
 	customer->OnReceive(msg);
 }
 
@@ -441,6 +569,16 @@ void Van::HandleAddNodeCmdAtSAndW(const Message& msg) {
 	ready_ = true;
 }
 
+std::vector<int> Van::GetProcessNodeIDs(int group) const {
+	std::vector<int> ids;
+	for (int id: PostOffice::Get()->GetNodeIDs(group)) {
+		if (shared_node_mapping_.find(id) == shared_node_mapping_.end()) {
+			ids.push_back(id);
+		}
+	}
+	return ids;
+}
+
 // ---
 void Van::ReceiveThread() {
 	std::vector<Node> nodes; // 所有已注册的节点
@@ -458,6 +596,9 @@ void Van::ReceiveThread() {
 		}
 
 		receive_bytes_ += received;
+		if (msg.meta.compressed) {
+			Decompress(&msg);
+		}
 		PS_LOG_DEBUG << "Received a msg (" << received << "B): " << msg.DebugString(0, 1);
 
 		// 发送 ACK，并检查：如果消息已接收过、无需重复处理，或只是 ACK 消息，则跳过处理
@@ -480,6 +621,9 @@ void Van::ReceiveThread() {
 			} else if (cmd == Control::TERMINATE) {
 				HandleTerminateCmd();
 				break;
+			} else if (rebalancer_ && (cmd == Control::LOAD_REPORT || cmd == Control::PAUSE ||
+					cmd == Control::UPDATE_RANGES)) {
+				rebalancer_->OnControl(msg);
 			} else {
 				LOG(WARNING) << "Dropped msg due to invalid command: " << msg.DebugString();
 			}
@@ -519,6 +663,24 @@ void Van::PackMetaToString(const Meta& meta, char** meta_buf, int* buf_size) {
 	pb.set_simple_app(meta.simple_app);
 	pb.set_priority(meta.priority);
 	pb.set_customer_id(meta.customer_id);
+	if (meta.version != Meta::kEmpty) pb.set_version(meta.version);
+	if (meta.key_handle != Meta::kEmpty) pb.set_key_handle(meta.key_handle);
+	if (meta.pull_codec) pb.set_pull_codec(meta.pull_codec);
+	if (meta.sparse) pb.set_sparse(true);
+	if (meta.compressed) pb.set_compressed(meta.compressed);
+	if (meta.omit_keys) pb.set_omit_keys(true);
+	if (meta.partition != Meta::kEmpty) pb.set_partition(meta.partition);
+	if (meta.range_version) pb.set_range_version(meta.range_version);
+	if (meta.replica != Meta::kEmpty) pb.set_replica(meta.replica);
+	if (meta.ack_seq) pb.set_ack_seq(meta.ack_seq);
+	if (meta.queue_depth) pb.set_queue_depth(meta.queue_depth);
+	if (meta.since_version != Meta::kEmpty) pb.set_since_version(meta.since_version);
+	if (meta.delta) pb.set_delta(true);
+	if (meta.tick) pb.set_tick(true);
+	if (meta.num_chunks > 1) {
+		pb.set_chunk_id(meta.chunk_id);
+		pb.set_num_chunks(meta.num_chunks);
+	}
 	for (auto d : meta.data_type) pb.add_data_type(d);
 	if (!meta.control.IsEmpty()) {
 		auto ctrl = pb.mutable_control();
@@ -565,6 +727,22 @@ void Van::UnpackMetaFromString(const char* meta_buf, int buf_size, Meta* meta) {
 	meta->priority = pb.priority();
 	meta->body = pb.body();
 	meta->customer_id = pb.customer_id();
+	meta->version = pb.has_version() ? pb.version() : Meta::kEmpty;
+	meta->key_handle = pb.has_key_handle() ? pb.key_handle() : Meta::kEmpty;
+	meta->pull_codec = pb.pull_codec();
+	meta->sparse = pb.sparse();
+	meta->compressed = pb.compressed();
+	meta->omit_keys = pb.omit_keys();
+	meta->partition = pb.has_partition() ? pb.partition() : Meta::kEmpty;
+	meta->range_version = pb.range_version();
+	meta->replica = pb.has_replica() ? pb.replica() : Meta::kEmpty;
+	meta->ack_seq = pb.ack_seq();
+	meta->queue_depth = pb.queue_depth();
+	meta->since_version = pb.has_since_version() ? pb.since_version() : Meta::kEmpty;
+	meta->delta = pb.delta();
+	meta->tick = pb.tick();
+	meta->chunk_id = pb.chunk_id();
+	meta->num_chunks = pb.has_num_chunks() ? pb.num_chunks() : 1;
 	meta->data_type.resize(pb.data_type_size());
 	for (int i = 0; i < pb.data_type_size(); ++i) {
 		meta->data_type[i] = static_cast<DataType>(pb.data_type(i));
@@ -11,11 +11,15 @@
 #include <unordered_map>
 
 #include "../internal/Message.h"
+#include "../utility/BufferPool.h"
+#include "../utility/Compressor.h"
 
 namespace ps {
 
 class PBMeta;
 class Resender;
+class Rebalancer;
+class FlowController;
 
 /**
  * @brief 具体执行信息收发的对象。
@@ -74,6 +78,31 @@ class Van {
 	const Node& my_node() const {
 		return my_node_;
 	}
+	/**
+	 * @brief 设置压缩数据帧使用的算法，Van 取得其所有权；为 nullptr 时不压缩。
+	 * 默认由环境变量 PS_COMPRESSION 决定。需要在开始发送数据前调用，且各节点使用相同的算法。
+	 * 不小于 PS_COMPRESSION_THRESHOLD 字节的数据帧在发送前压缩（压缩后没有变小则发送原数据），接收时解压。
+	 */
+	void SetCompressor(Compressor* compressor) {
+		compressor_.reset(compressor);
+	}
+	/**
+	 * @brief 按负载调整 server 区间的 Rebalancer，未设置 PS_REBALANCE_INTERVAL 时为 nullptr。
+	 */
+	Rebalancer* rebalancer() {
+		return rebalancer_;
+	}
+	/**
+	 * @brief worker 对各 server 的流量控制，未设置 PS_MAX_INFLIGHT_BYTES 与 PS_MAX_INFLIGHT_REQUESTS 时为 nullptr。
+	 */
+	FlowController* flow_controller() {
+		return flow_controller_;
+	}
+	/**
+	 * @brief 获取组中每个进程的节点 ID：同一进程的多个 customer 只保留最早加入的那个，用于每个进程只需收到一次的消息。
+	 * 只能在接收线程中调用。
+	 */
+	std::vector<int> GetProcessNodeIDs(int group) const;
 
  protected:
 	/**
@@ -164,6 +193,27 @@ class Van {
 	 */
 	void HandleAddNodeCmdAtSAndW(const Message& msg);
 
+	/**
+	 * @brief 将 msg 中需要压缩的数据帧压缩后保存到 out。
+	 * 压缩后的帧为 [原始字节数: 8B][压缩结果]，并在 meta.compressed 中标记。
+	 * @return 没有压缩任何帧时返回 false，此时 out 不变
+	 */
+	bool Compress(const Message& msg, Message* out);
+	/**
+	 * @brief 解压 meta.compressed 标记的数据帧，解压结果使用 recv_pool_ 中的缓冲区。
+	 */
+	void Decompress(Message* msg);
+	/**
+	 * @brief 是否压缩下一个类型为 type 的足够大的帧。
+	 * 自适应模式下按数据类型分别统计（key 与 value 的可压缩程度通常不同），压缩不划算时暂停，每 kCompressProbe 个帧尝试一次。
+	 */
+	bool ShouldCompress(DataType type);
+	/**
+	 * @brief 自适应模式下记录一次压缩：节省的传输时间减去压缩与解压的耗时，按原始字节数平均后计入该类型的滑动平均。
+	 * @param ns 压缩耗时
+	 */
+	void RecordCompression(DataType type, size_t raw, size_t compressed, int64_t ns);
+
 	/**
 	 * @brief 接收线程的执行逻辑。接收消息是单线程的，处理消息的各函数也是单线程执行的。
 	 */
@@ -186,6 +236,10 @@ class Van {
 
 	/* Resender 需要在 Stop 时手动释放，以等待 resend 线程正常发送完再退出 */
 	Resender* resender_{nullptr};
+	/* 区间负载均衡，见 Rebalancer */
+	Rebalancer* rebalancer_{nullptr};
+	/* 流量控制，见 FlowController */
+	FlowController* flow_controller_{nullptr};
 	std::unique_ptr<std::thread> receive_thread_;
 	std::unique_ptr<std::thread> heartbeat_thread_;
 	/* 心跳超时时间，从配置中读取。单位为秒。为0则不检查 */
@@ -196,6 +250,22 @@ class Van {
 	/* 历史总共接收的字节数。由接收线程单线程处理，无需原子 */
 	size_t receive_bytes_{0};
 
+	/* 压缩数据帧的算法，为 nullptr 时不压缩（仍能解压收到的帧） */
+	std::unique_ptr<Compressor> compressor_;
+	/* 只压缩不小于该字节数的数据帧 */
+	size_t compress_threshold_{4096};
+	/* 是否自适应：压缩与解压的耗时多于节省的传输时间时暂停压缩 */
+	bool compress_adaptive_{true};
+	/* 估计的网络带宽，字节/纳秒 */
+	double compress_bandwidth_{1.25};
+	/* 各数据类型压缩每个原始字节节省的时间（纳秒）的滑动平均，为负时暂停压缩该类型 */
+	std::array<double, std::size(DataTypeName)> compress_gain_{};
+	/* 暂停时，距离下一次尝试压缩该类型的帧数 */
+	std::array<int, std::size(DataTypeName)> compress_probe_{};
+	std::mutex compress_mu_;
+	/* 解压结果使用的缓冲区 */
+	BufferPool recv_pool_;
+
 	/* 每个组的 barrier 计数。即当前有多少属于该组的节点进入了 barrier 阻塞 */
 	std::array<int, 8> barrier_count_ {0, 0, 0, 0, 0, 0, 0, 0};
 
@@ -89,8 +89,9 @@ void ZMQVan::Connect(const Node& node) {
 	if (it != senders_.end()) {
 		zmq_close(it->second);
 	}
-	// worker doesn't need to connect to the other workers. same for server
-	if ((node.role == my_node_.role) && (node.id != my_node_.id)) {
+	// worker doesn't need to connect to the other workers
+	// （server 之间需要迁移参数、同步热点 key 的副本）
+	if ((node.role == my_node_.role) && (node.id != my_node_.id) && node.role != Node::SERVER) {
 		return;
 	}
 	void *sender = zmq_socket(context_, ZMQ_DEALER);
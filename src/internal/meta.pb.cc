@@ -70,8 +70,24 @@ PROTOBUF_CONSTEXPR PBMeta::PBMeta(
   , /*decltype(_impl_.timestamp_)*/0
   , /*decltype(_impl_.customer_id_)*/0
   , /*decltype(_impl_.data_size_)*/0
+  , /*decltype(_impl_.priority_)*/0
+  , /*decltype(_impl_.version_)*/0
   , /*decltype(_impl_.msg_sign_)*/uint64_t{0u}
-  , /*decltype(_impl_.priority_)*/0} {}
+  , /*decltype(_impl_.key_handle_)*/0
+  , /*decltype(_impl_.pull_codec_)*/0
+  , /*decltype(_impl_.compressed_)*/0u
+  , /*decltype(_impl_.chunk_id_)*/0
+  , /*decltype(_impl_.num_chunks_)*/0
+  , /*decltype(_impl_.partition_)*/0
+  , /*decltype(_impl_.range_version_)*/0
+  , /*decltype(_impl_.sparse_)*/false
+  , /*decltype(_impl_.omit_keys_)*/false
+  , /*decltype(_impl_.delta_)*/false
+  , /*decltype(_impl_.tick_)*/false
+  , /*decltype(_impl_.ack_seq_)*/uint64_t{0u}
+  , /*decltype(_impl_.replica_)*/0
+  , /*decltype(_impl_.queue_depth_)*/0
+  , /*decltype(_impl_.since_version_)*/0} {}
 struct PBMetaDefaultTypeInternal {
   PROTOBUF_CONSTEXPR PBMetaDefaultTypeInternal()
       : _instance(::_pbi::ConstantInitialized{}) {}
@@ -778,10 +794,58 @@ class PBMeta::_Internal {
     (*has_bits)[0] |= 1024u;
   }
   static void set_has_priority(HasBits* has_bits) {
-    (*has_bits)[0] |= 4096u;
+    (*has_bits)[0] |= 2048u;
   }
   static void set_has_msg_sign(HasBits* has_bits) {
-    (*has_bits)[0] |= 2048u;
+    (*has_bits)[0] |= 8192u;
+  }
+  static void set_has_version(HasBits* has_bits) {
+    (*has_bits)[0] |= 4096u;
+  }
+  static void set_has_key_handle(HasBits* has_bits) {
+    (*has_bits)[0] |= 16384u;
+  }
+  static void set_has_pull_codec(HasBits* has_bits) {
+    (*has_bits)[0] |= 32768u;
+  }
+  static void set_has_sparse(HasBits* has_bits) {
+    (*has_bits)[0] |= 2097152u;
+  }
+  static void set_has_compressed(HasBits* has_bits) {
+    (*has_bits)[0] |= 65536u;
+  }
+  static void set_has_chunk_id(HasBits* has_bits) {
+    (*has_bits)[0] |= 131072u;
+  }
+  static void set_has_num_chunks(HasBits* has_bits) {
+    (*has_bits)[0] |= 262144u;
+  }
+  static void set_has_omit_keys(HasBits* has_bits) {
+    (*has_bits)[0] |= 4194304u;
+  }
+  static void set_has_partition(HasBits* has_bits) {
+    (*has_bits)[0] |= 524288u;
+  }
+  static void set_has_range_version(HasBits* has_bits) {
+    (*has_bits)[0] |= 1048576u;
+  }
+  static void set_has_replica(HasBits* has_bits) {
+    (*has_bits)[0] |= 67108864u;
+  }
+  static void set_has_ack_seq(HasBits* has_bits) {
+    (*has_bits)[0] |= 33554432u;
+  }
+  static void set_has_queue_depth(HasBits* has_bits) {
+    (*has_bits)[0] |= 134217728u;
+  }
+  static void set_has_since_version(HasBits* has_bits) {
+    (*has_bits)[0] |= 268435456u;
+  }
+  static void set_has_delta(HasBits* has_bits) {
+    (*has_bits)[0] |= 8388608u;
+  }
+  static void set_has_tick(HasBits* has_bits) {
+    (*has_bits)[0] |= 16777216u;
   }
 };
 
@@ -814,8 +878,24 @@ PBMeta::PBMeta(const PBMeta& from)
     , decltype(_impl_.timestamp_){}
     , decltype(_impl_.customer_id_){}
     , decltype(_impl_.data_size_){}
+    , decltype(_impl_.priority_){}
+    , decltype(_impl_.version_){}
     , decltype(_impl_.msg_sign_){}
-    , decltype(_impl_.priority_){}};
+    , decltype(_impl_.key_handle_){}
+    , decltype(_impl_.pull_codec_){}
+    , decltype(_impl_.compressed_){}
+    , decltype(_impl_.chunk_id_){}
+    , decltype(_impl_.num_chunks_){}
+    , decltype(_impl_.partition_){}
+    , decltype(_impl_.range_version_){}
+    , decltype(_impl_.sparse_){}
+    , decltype(_impl_.omit_keys_){}
+    , decltype(_impl_.delta_){}
+    , decltype(_impl_.tick_){}
+    , decltype(_impl_.ack_seq_){}
+    , decltype(_impl_.replica_){}
+    , decltype(_impl_.queue_depth_){}
+    , decltype(_impl_.since_version_){}};
 
   _internal_metadata_.MergeFrom<std::string>(from._internal_metadata_);
   _impl_.body_.InitDefault();
@@ -830,8 +910,8 @@ PBMeta::PBMeta(const PBMeta& from)
     _this->_impl_.control_ = new ::ps::PBControl(*from._impl_.control_);
   }
   ::memcpy(&_impl_.head_, &from._impl_.head_,
-    static_cast<size_t>(reinterpret_cast<char*>(&_impl_.priority_) -
-    reinterpret_cast<char*>(&_impl_.head_)) + sizeof(_impl_.priority_));
+    static_cast<size_t>(reinterpret_cast<char*>(&_impl_.since_version_) -
+    reinterpret_cast<char*>(&_impl_.head_)) + sizeof(_impl_.since_version_));
   // @@protoc_insertion_point(copy_constructor:ps.PBMeta)
 }
 
@@ -855,8 +935,24 @@ inline void PBMeta::SharedCtor(
     , decltype(_impl_.timestamp_){0}
     , decltype(_impl_.customer_id_){0}
     , decltype(_impl_.data_size_){0}
-    , decltype(_impl_.msg_sign_){uint64_t{0u}}
     , decltype(_impl_.priority_){0}
+    , decltype(_impl_.version_){0}
+    , decltype(_impl_.msg_sign_){uint64_t{0u}}
+    , decltype(_impl_.key_handle_){0}
+    , decltype(_impl_.pull_codec_){0}
+    , decltype(_impl_.compressed_){0u}
+    , decltype(_impl_.chunk_id_){0}
+    , decltype(_impl_.num_chunks_){0}
+    , decltype(_impl_.partition_){0}
+    , decltype(_impl_.range_version_){0}
+    , decltype(_impl_.sparse_){false}
+    , decltype(_impl_.omit_keys_){false}
+    , decltype(_impl_.delta_){false}
+    , decltype(_impl_.tick_){false}
+    , decltype(_impl_.ack_seq_){uint64_t{0u}}
+    , decltype(_impl_.replica_){0}
+    , decltype(_impl_.queue_depth_){0}
+    , decltype(_impl_.since_version_){0}
   };
   _impl_.body_.InitDefault();
   #ifdef PROTOBUF_FORCE_COPY_DEFAULT_STRING
@@ -906,10 +1002,20 @@ void PBMeta::Clear() {
         reinterpret_cast<char*>(&_impl_.app_id_) -
         reinterpret_cast<char*>(&_impl_.head_)) + sizeof(_impl_.app_id_));
   }
-  if (cached_has_bits & 0x00001f00u) {
+  if (cached_has_bits & 0x0000ff00u) {
     ::memset(&_impl_.timestamp_, 0, static_cast<size_t>(
-        reinterpret_cast<char*>(&_impl_.priority_) -
-        reinterpret_cast<char*>(&_impl_.timestamp_)) + sizeof(_impl_.priority_));
+        reinterpret_cast<char*>(&_impl_.pull_codec_) -
+        reinterpret_cast<char*>(&_impl_.timestamp_)) + sizeof(_impl_.pull_codec_));
+  }
+  if (cached_has_bits & 0x00ff0000u) {
+    ::memset(&_impl_.compressed_, 0, static_cast<size_t>(
+        reinterpret_cast<char*>(&_impl_.delta_) -
+        reinterpret_cast<char*>(&_impl_.compressed_)) + sizeof(_impl_.delta_));
+  }
+  if (cached_has_bits & 0x1f000000u) {
+    ::memset(&_impl_.tick_, 0, static_cast<size_t>(
+        reinterpret_cast<char*>(&_impl_.since_version_) -
+        reinterpret_cast<char*>(&_impl_.tick_)) + sizeof(_impl_.since_version_));
   }
   _impl_._has_bits_.Clear();
   _internal_metadata_.Clear<std::string>();
@@ -1049,6 +1155,150 @@ const char* PBMeta::_InternalParse(const char* ptr, ::_pbi::ParseContext* ctx) {
         } else
           goto handle_unusual;
         continue;
+      // optional int32 version = 16;
+      case 16:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 128)) {
+          _Internal::set_has_version(&has_bits);
+          _impl_.version_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint32(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      // optional int32 key_handle = 17;
+      case 17:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 136)) {
+          _Internal::set_has_key_handle(&has_bits);
+          _impl_.key_handle_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint32(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      // optional int32 pull_codec = 18;
+      case 18:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 144)) {
+          _Internal::set_has_pull_codec(&has_bits);
+          _impl_.pull_codec_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint32(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      // optional bool sparse = 19;
+      case 19:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 152)) {
+          _Internal::set_has_sparse(&has_bits);
+          _impl_.sparse_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint64(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      // optional uint32 compressed = 20;
+      case 20:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 160)) {
+          _Internal::set_has_compressed(&has_bits);
+          _impl_.compressed_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint32(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      // optional int32 chunk_id = 21;
+      case 21:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 168)) {
+          _Internal::set_has_chunk_id(&has_bits);
+          _impl_.chunk_id_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint32(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      // optional int32 num_chunks = 22;
+      case 22:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 176)) {
+          _Internal::set_has_num_chunks(&has_bits);
+          _impl_.num_chunks_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint32(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      // optional bool omit_keys = 23;
+      case 23:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 184)) {
+          _Internal::set_has_omit_keys(&has_bits);
+          _impl_.omit_keys_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint64(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      // optional int32 partition = 24;
+      case 24:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 192)) {
+          _Internal::set_has_partition(&has_bits);
+          _impl_.partition_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint32(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      // optional int32 range_version = 25;
+      case 25:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 200)) {
+          _Internal::set_has_range_version(&has_bits);
+          _impl_.range_version_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint32(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      // optional int32 replica = 26;
+      case 26:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 208)) {
+          _Internal::set_has_replica(&has_bits);
+          _impl_.replica_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint32(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      // optional uint64 ack_seq = 27;
+      case 27:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 216)) {
+          _Internal::set_has_ack_seq(&has_bits);
+          _impl_.ack_seq_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint64(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      // optional int32 queue_depth = 28;
+      case 28:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 224)) {
+          _Internal::set_has_queue_depth(&has_bits);
+          _impl_.queue_depth_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint32(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      // optional int32 since_version = 29;
+      case 29:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 232)) {
+          _Internal::set_has_since_version(&has_bits);
+          _impl_.since_version_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint32(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      // optional bool delta = 30;
+      case 30:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 240)) {
+          _Internal::set_has_delta(&has_bits);
+          _impl_.delta_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint64(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      // optional bool tick = 31;
+      case 31:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 248)) {
+          _Internal::set_has_tick(&has_bits);
+          _impl_.tick_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint64(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
       default:
         goto handle_unusual;
     }  // switch
@@ -1157,17 +1407,113 @@ uint8_t* PBMeta::_InternalSerialize(
   }
 
   // optional int32 priority = 13 [default = 0];
-  if (cached_has_bits & 0x00001000u) {
+  if (cached_has_bits & 0x00000800u) {
     target = stream->EnsureSpace(target);
     target = ::_pbi::WireFormatLite::WriteInt32ToArray(13, this->_internal_priority(), target);
   }
 
   // optional uint64 msg_sign = 15;
-  if (cached_has_bits & 0x00000800u) {
+  if (cached_has_bits & 0x00002000u) {
     target = stream->EnsureSpace(target);
     target = ::_pbi::WireFormatLite::WriteUInt64ToArray(15, this->_internal_msg_sign(), target);
   }
 
+  // optional int32 version = 16;
+  if (cached_has_bits & 0x00001000u) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteInt32ToArray(16, this->_internal_version(), target);
+  }
+
+  // optional int32 key_handle = 17;
+  if (cached_has_bits & 0x00004000u) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteInt32ToArray(17, this->_internal_key_handle(), target);
+  }
+
+  // optional int32 pull_codec = 18;
+  if (cached_has_bits & 0x00008000u) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteInt32ToArray(18, this->_internal_pull_codec(), target);
+  }
+
+  // optional bool sparse = 19;
+  if (cached_has_bits & 0x00200000u) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteBoolToArray(19, this->_internal_sparse(), target);
+  }
+
+  // optional uint32 compressed = 20;
+  if (cached_has_bits & 0x00010000u) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteUInt32ToArray(20, this->_internal_compressed(), target);
+  }
+
+  // optional int32 chunk_id = 21;
+  if (cached_has_bits & 0x00020000u) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteInt32ToArray(21, this->_internal_chunk_id(), target);
+  }
+
+  // optional int32 num_chunks = 22;
+  if (cached_has_bits & 0x00040000u) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteInt32ToArray(22, this->_internal_num_chunks(), target);
+  }
+
+  // optional bool omit_keys = 23;
+  if (cached_has_bits & 0x00400000u) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteBoolToArray(23, this->_internal_omit_keys(), target);
+  }
+
+  // optional int32 partition = 24;
+  if (cached_has_bits & 0x00080000u) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteInt32ToArray(24, this->_internal_partition(), target);
+  }
+
+  // optional int32 range_version = 25;
+  if (cached_has_bits & 0x00100000u) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteInt32ToArray(25, this->_internal_range_version(), target);
+  }
+
+  // optional int32 replica = 26;
+  if (cached_has_bits & 0x04000000u) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteInt32ToArray(26, this->_internal_replica(), target);
+  }
+
+  // optional uint64 ack_seq = 27;
+  if (cached_has_bits & 0x02000000u) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteUInt64ToArray(27, this->_internal_ack_seq(), target);
+  }
+
+  // optional int32 queue_depth = 28;
+  if (cached_has_bits & 0x08000000u) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteInt32ToArray(28, this->_internal_queue_depth(), target);
+  }
+
+  // optional int32 since_version = 29;
+  if (cached_has_bits & 0x10000000u) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteInt32ToArray(29, this->_internal_since_version(), target);
+  }
+
+  // optional bool delta = 30;
+  if (cached_has_bits & 0x00800000u) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteBoolToArray(30, this->_internal_delta(), target);
+  }
+
+  // optional bool tick = 31;
+  if (cached_has_bits & 0x01000000u) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteBoolToArray(31, this->_internal_tick(), target);
+  }
+
   if (PROTOBUF_PREDICT_FALSE(_internal_metadata_.have_unknown_fields())) {
     target = stream->WriteRaw(_internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString).data(),
         static_cast<int>(_internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString).size()), target);
@@ -1245,7 +1591,7 @@ size_t PBMeta::ByteSizeLong() const {
     }
 
   }
-  if (cached_has_bits & 0x00001f00u) {
+  if (cached_has_bits & 0x0000ff00u) {
     // optional int32 timestamp = 8;
     if (cached_has_bits & 0x00000100u) {
       total_size += ::_pbi::WireFormatLite::Int32SizePlusOne(this->_internal_timestamp());
@@ -1261,14 +1607,122 @@ size_t PBMeta::ByteSizeLong() const {
       total_size += ::_pbi::WireFormatLite::Int32SizePlusOne(this->_internal_data_size());
     }
 
-    // optional uint64 msg_sign = 15;
+    // optional int32 priority = 13 [default = 0];
     if (cached_has_bits & 0x00000800u) {
-      total_size += ::_pbi::WireFormatLite::UInt64SizePlusOne(this->_internal_msg_sign());
+      total_size += ::_pbi::WireFormatLite::Int32SizePlusOne(this->_internal_priority());
     }
 
-    // optional int32 priority = 13 [default = 0];
+    // optional int32 version = 16;
     if (cached_has_bits & 0x00001000u) {
-      total_size += ::_pbi::WireFormatLite::Int32SizePlusOne(this->_internal_priority());
+      total_size += 2 +
+        ::_pbi::WireFormatLite::Int32Size(
+          this->_internal_version());
+    }
+
+    // optional uint64 msg_sign = 15;
+    if (cached_has_bits & 0x00002000u) {
+      total_size += ::_pbi::WireFormatLite::UInt64SizePlusOne(this->_internal_msg_sign());
+    }
+
+    // optional int32 key_handle = 17;
+    if (cached_has_bits & 0x00004000u) {
+      total_size += 2 +
+        ::_pbi::WireFormatLite::Int32Size(
+          this->_internal_key_handle());
+    }
+
+    // optional int32 pull_codec = 18;
+    if (cached_has_bits & 0x00008000u) {
+      total_size += 2 +
+        ::_pbi::WireFormatLite::Int32Size(
+          this->_internal_pull_codec());
+    }
+
+  }
+  if (cached_has_bits & 0x00ff0000u) {
+    // optional uint32 compressed = 20;
+    if (cached_has_bits & 0x00010000u) {
+      total_size += 2 +
+        ::_pbi::WireFormatLite::UInt32Size(
+          this->_internal_compressed());
+    }
+
+    // optional int32 chunk_id = 21;
+    if (cached_has_bits & 0x00020000u) {
+      total_size += 2 +
+        ::_pbi::WireFormatLite::Int32Size(
+          this->_internal_chunk_id());
+    }
+
+    // optional int32 num_chunks = 22;
+    if (cached_has_bits & 0x00040000u) {
+      total_size += 2 +
+        ::_pbi::WireFormatLite::Int32Size(
+          this->_internal_num_chunks());
+    }
+
+    // optional int32 partition = 24;
+    if (cached_has_bits & 0x00080000u) {
+      total_size += 2 +
+        ::_pbi::WireFormatLite::Int32Size(
+          this->_internal_partition());
+    }
+
+    // optional int32 range_version = 25;
+    if (cached_has_bits & 0x00100000u) {
+      total_size += 2 +
+        ::_pbi::WireFormatLite::Int32Size(
+          this->_internal_range_version());
+    }
+
+    // optional bool sparse = 19;
+    if (cached_has_bits & 0x00200000u) {
+      total_size += 2 + 1;
+    }
+
+    // optional bool omit_keys = 23;
+    if (cached_has_bits & 0x00400000u) {
+      total_size += 2 + 1;
+    }
+
+    // optional bool delta = 30;
+    if (cached_has_bits & 0x00800000u) {
+      total_size += 2 + 1;
+    }
+
+  }
+  if (cached_has_bits & 0x1f000000u) {
+    // optional bool tick = 31;
+    if (cached_has_bits & 0x01000000u) {
+      total_size += 2 + 1;
+    }
+
+    // optional uint64 ack_seq = 27;
+    if (cached_has_bits & 0x02000000u) {
+      total_size += 2 +
+        ::_pbi::WireFormatLite::UInt64Size(
+          this->_internal_ack_seq());
+    }
+
+    // optional int32 replica = 26;
+    if (cached_has_bits & 0x04000000u) {
+      total_size += 2 +
+        ::_pbi::WireFormatLite::Int32Size(
+          this->_internal_replica());
+    }
+
+    // optional int32 queue_depth = 28;
+    if (cached_has_bits & 0x08000000u) {
+      total_size += 2 +
+        ::_pbi::WireFormatLite::Int32Size(
+          this->_internal_queue_depth());
+    }
+
+    // optional int32 since_version = 29;
+    if (cached_has_bits & 0x10000000u) {
+      total_size += 2 +
+        ::_pbi::WireFormatLite::Int32Size(
+          this->_internal_since_version());
     }
 
   }
@@ -1323,7 +1777,7 @@ void PBMeta::MergeFrom(const PBMeta& from) {
     }
     _this->_impl_._has_bits_[0] |= cached_has_bits;
   }
-  if (cached_has_bits & 0x00001f00u) {
+  if (cached_has_bits & 0x0000ff00u) {
     if (cached_has_bits & 0x00000100u) {
       _this->_impl_.timestamp_ = from._impl_.timestamp_;
     }
@@ -1334,10 +1788,64 @@ void PBMeta::MergeFrom(const PBMeta& from) {
       _this->_impl_.data_size_ = from._impl_.data_size_;
     }
     if (cached_has_bits & 0x00000800u) {
-      _this->_impl_.msg_sign_ = from._impl_.msg_sign_;
+      _this->_impl_.priority_ = from._impl_.priority_;
     }
     if (cached_has_bits & 0x00001000u) {
-      _this->_impl_.priority_ = from._impl_.priority_;
+      _this->_impl_.version_ = from._impl_.version_;
+    }
+    if (cached_has_bits & 0x00002000u) {
+      _this->_impl_.msg_sign_ = from._impl_.msg_sign_;
+    }
+    if (cached_has_bits & 0x00004000u) {
+      _this->_impl_.key_handle_ = from._impl_.key_handle_;
+    }
+    if (cached_has_bits & 0x00008000u) {
+      _this->_impl_.pull_codec_ = from._impl_.pull_codec_;
+    }
+    _this->_impl_._has_bits_[0] |= cached_has_bits;
+  }
+  if (cached_has_bits & 0x00ff0000u) {
+    if (cached_has_bits & 0x00010000u) {
+      _this->_impl_.compressed_ = from._impl_.compressed_;
+    }
+    if (cached_has_bits & 0x00020000u) {
+      _this->_impl_.chunk_id_ = from._impl_.chunk_id_;
+    }
+    if (cached_has_bits & 0x00040000u) {
+      _this->_impl_.num_chunks_ = from._impl_.num_chunks_;
+    }
+    if (cached_has_bits & 0x00080000u) {
+      _this->_impl_.partition_ = from._impl_.partition_;
+    }
+    if (cached_has_bits & 0x00100000u) {
+      _this->_impl_.range_version_ = from._impl_.range_version_;
+    }
+    if (cached_has_bits & 0x00200000u) {
+      _this->_impl_.sparse_ = from._impl_.sparse_;
+    }
+    if (cached_has_bits & 0x00400000u) {
+      _this->_impl_.omit_keys_ = from._impl_.omit_keys_;
+    }
+    if (cached_has_bits & 0x00800000u) {
+      _this->_impl_.delta_ = from._impl_.delta_;
+    }
+    _this->_impl_._has_bits_[0] |= cached_has_bits;
+  }
+  if (cached_has_bits & 0x1f000000u) {
+    if (cached_has_bits & 0x01000000u) {
+      _this->_impl_.tick_ = from._impl_.tick_;
+    }
+    if (cached_has_bits & 0x02000000u) {
+      _this->_impl_.ack_seq_ = from._impl_.ack_seq_;
+    }
+    if (cached_has_bits & 0x04000000u) {
+      _this->_impl_.replica_ = from._impl_.replica_;
+    }
+    if (cached_has_bits & 0x08000000u) {
+      _this->_impl_.queue_depth_ = from._impl_.queue_depth_;
+    }
+    if (cached_has_bits & 0x10000000u) {
+      _this->_impl_.since_version_ = from._impl_.since_version_;
     }
     _this->_impl_._has_bits_[0] |= cached_has_bits;
   }
@@ -1370,8 +1878,8 @@ void PBMeta::InternalSwap(PBMeta* other) {
       &other->_impl_.body_, rhs_arena
   );
   ::PROTOBUF_NAMESPACE_ID::internal::memswap<
-      PROTOBUF_FIELD_OFFSET(PBMeta, _impl_.priority_)
-      + sizeof(PBMeta::_impl_.priority_)
+      PROTOBUF_FIELD_OFFSET(PBMeta, _impl_.since_version_)
+      + sizeof(PBMeta::_impl_.since_version_)
       - PROTOBUF_FIELD_OFFSET(PBMeta, _impl_.control_)>(
           reinterpret_cast<char*>(&_impl_.control_),
           reinterpret_cast<char*>(&other->_impl_.control_));
@@ -582,8 +582,24 @@ class PBMeta final :
     kTimestampFieldNumber = 8,
     kCustomerIdFieldNumber = 10,
     kDataSizeFieldNumber = 11,
-    kMsgSignFieldNumber = 15,
     kPriorityFieldNumber = 13,
+    kVersionFieldNumber = 16,
+    kMsgSignFieldNumber = 15,
+    kKeyHandleFieldNumber = 17,
+    kPullCodecFieldNumber = 18,
+    kCompressedFieldNumber = 20,
+    kChunkIdFieldNumber = 21,
+    kNumChunksFieldNumber = 22,
+    kPartitionFieldNumber = 24,
+    kRangeVersionFieldNumber = 25,
+    kSparseFieldNumber = 19,
+    kOmitKeysFieldNumber = 23,
+    kDeltaFieldNumber = 30,
+    kTickFieldNumber = 31,
+    kAckSeqFieldNumber = 27,
+    kReplicaFieldNumber = 26,
+    kQueueDepthFieldNumber = 28,
+    kSinceVersionFieldNumber = 29,
   };
   // repeated int32 data_type = 9 [packed = true];
   int data_type_size() const;
@@ -760,6 +776,32 @@ class PBMeta final :
   void _internal_set_data_size(int32_t value);
   public:
 
+  // optional int32 priority = 13 [default = 0];
+  bool has_priority() const;
+  private:
+  bool _internal_has_priority() const;
+  public:
+  void clear_priority();
+  int32_t priority() const;
+  void set_priority(int32_t value);
+  private:
+  int32_t _internal_priority() const;
+  void _internal_set_priority(int32_t value);
+  public:
+
+  // optional int32 version = 16;
+  bool has_version() const;
+  private:
+  bool _internal_has_version() const;
+  public:
+  void clear_version();
+  int32_t version() const;
+  void set_version(int32_t value);
+  private:
+  int32_t _internal_version() const;
+  void _internal_set_version(int32_t value);
+  public:
+
   // optional uint64 msg_sign = 15;
   bool has_msg_sign() const;
   private:
@@ -773,17 +815,199 @@ class PBMeta final :
   void _internal_set_msg_sign(uint64_t value);
   public:
 
-  // optional int32 priority = 13 [default = 0];
-  bool has_priority() const;
+  // optional int32 key_handle = 17;
+  bool has_key_handle() const;
   private:
-  bool _internal_has_priority() const;
+  bool _internal_has_key_handle() const;
   public:
-  void clear_priority();
-  int32_t priority() const;
-  void set_priority(int32_t value);
+  void clear_key_handle();
+  int32_t key_handle() const;
+  void set_key_handle(int32_t value);
   private:
-  int32_t _internal_priority() const;
-  void _internal_set_priority(int32_t value);
+  int32_t _internal_key_handle() const;
+  void _internal_set_key_handle(int32_t value);
+  public:
+
+  // optional int32 pull_codec = 18;
+  bool has_pull_codec() const;
+  private:
+  bool _internal_has_pull_codec() const;
+  public:
+  void clear_pull_codec();
+  int32_t pull_codec() const;
+  void set_pull_codec(int32_t value);
+  private:
+  int32_t _internal_pull_codec() const;
+  void _internal_set_pull_codec(int32_t value);
+  public:
+
+  // optional uint32 compressed = 20;
+  bool has_compressed() const;
+  private:
+  bool _internal_has_compressed() const;
+  public:
+  void clear_compressed();
+  uint32_t compressed() const;
+  void set_compressed(uint32_t value);
+  private:
+  uint32_t _internal_compressed() const;
+  void _internal_set_compressed(uint32_t value);
+  public:
+
+  // optional int32 chunk_id = 21;
+  bool has_chunk_id() const;
+  private:
+  bool _internal_has_chunk_id() const;
+  public:
+  void clear_chunk_id();
+  int32_t chunk_id() const;
+  void set_chunk_id(int32_t value);
+  private:
+  int32_t _internal_chunk_id() const;
+  void _internal_set_chunk_id(int32_t value);
+  public:
+
+  // optional int32 num_chunks = 22;
+  bool has_num_chunks() const;
+  private:
+  bool _internal_has_num_chunks() const;
+  public:
+  void clear_num_chunks();
+  int32_t num_chunks() const;
+  void set_num_chunks(int32_t value);
+  private:
+  int32_t _internal_num_chunks() const;
+  void _internal_set_num_chunks(int32_t value);
+  public:
+
+  // optional int32 partition = 24;
+  bool has_partition() const;
+  private:
+  bool _internal_has_partition() const;
+  public:
+  void clear_partition();
+  int32_t partition() const;
+  void set_partition(int32_t value);
+  private:
+  int32_t _internal_partition() const;
+  void _internal_set_partition(int32_t value);
+  public:
+
+  // optional int32 range_version = 25;
+  bool has_range_version() const;
+  private:
+  bool _internal_has_range_version() const;
+  public:
+  void clear_range_version();
+  int32_t range_version() const;
+  void set_range_version(int32_t value);
+  private:
+  int32_t _internal_range_version() const;
+  void _internal_set_range_version(int32_t value);
+  public:
+
+  // optional bool sparse = 19;
+  bool has_sparse() const;
+  private:
+  bool _internal_has_sparse() const;
+  public:
+  void clear_sparse();
+  bool sparse() const;
+  void set_sparse(bool value);
+  private:
+  bool _internal_sparse() const;
+  void _internal_set_sparse(bool value);
+  public:
+
+  // optional bool omit_keys = 23;
+  bool has_omit_keys() const;
+  private:
+  bool _internal_has_omit_keys() const;
+  public:
+  void clear_omit_keys();
+  bool omit_keys() const;
+  void set_omit_keys(bool value);
+  private:
+  bool _internal_omit_keys() const;
+  void _internal_set_omit_keys(bool value);
+  public:
+
+  // optional bool delta = 30;
+  bool has_delta() const;
+  private:
+  bool _internal_has_delta() const;
+  public:
+  void clear_delta();
+  bool delta() const;
+  void set_delta(bool value);
+  private:
+  bool _internal_delta() const;
+  void _internal_set_delta(bool value);
+  public:
+
+  // optional bool tick = 31;
+  bool has_tick() const;
+  private:
+  bool _internal_has_tick() const;
+  public:
+  void clear_tick();
+  bool tick() const;
+  void set_tick(bool value);
+  private:
+  bool _internal_tick() const;
+  void _internal_set_tick(bool value);
+  public:
+
+  // optional uint64 ack_seq = 27;
+  bool has_ack_seq() const;
+  private:
+  bool _internal_has_ack_seq() const;
+  public:
+  void clear_ack_seq();
+  uint64_t ack_seq() const;
+  void set_ack_seq(uint64_t value);
+  private:
+  uint64_t _internal_ack_seq() const;
+  void _internal_set_ack_seq(uint64_t value);
+  public:
+
+  // optional int32 replica = 26;
+  bool has_replica() const;
+  private:
+  bool _internal_has_replica() const;
+  public:
+  void clear_replica();
+  int32_t replica() const;
+  void set_replica(int32_t value);
+  private:
+  int32_t _internal_replica() const;
+  void _internal_set_replica(int32_t value);
+  public:
+
+  // optional int32 queue_depth = 28;
+  bool has_queue_depth() const;
+  private:
+  bool _internal_has_queue_depth() const;
+  public:
+  void clear_queue_depth();
+  int32_t queue_depth() const;
+  void set_queue_depth(int32_t value);
+  private:
+  int32_t _internal_queue_depth() const;
+  void _internal_set_queue_depth(int32_t value);
+  public:
+
+  // optional int32 since_version = 29;
+  bool has_since_version() const;
+  private:
+  bool _internal_has_since_version() const;
+  public:
+  void clear_since_version();
+  int32_t since_version() const;
+  void set_since_version(int32_t value);
+  private:
+  int32_t _internal_since_version() const;
+  void _internal_set_since_version(int32_t value);
   public:
 
   // @@protoc_insertion_point(class_scope:ps.PBMeta)
@@ -809,8 +1033,24 @@ class PBMeta final :
     int32_t timestamp_;
     int32_t customer_id_;
     int32_t data_size_;
-    uint64_t msg_sign_;
     int32_t priority_;
+    int32_t version_;
+    uint64_t msg_sign_;
+    int32_t key_handle_;
+    int32_t pull_codec_;
+    uint32_t compressed_;
+    int32_t chunk_id_;
+    int32_t num_chunks_;
+    int32_t partition_;
+    int32_t range_version_;
+    bool sparse_;
+    bool omit_keys_;
+    bool delta_;
+    bool tick_;
+    uint64_t ack_seq_;
+    int32_t replica_;
+    int32_t queue_depth_;
+    int32_t since_version_;
   };
   union { Impl_ _impl_; };
   friend struct ::TableStruct_meta_2eproto;
@@ -1597,7 +1837,7 @@ inline void PBMeta::set_data_size(int32_t value) {
 
 // optional int32 priority = 13 [default = 0];
 inline bool PBMeta::_internal_has_priority() const {
-  bool value = (_impl_._has_bits_[0] & 0x00001000u) != 0;
+  bool value = (_impl_._has_bits_[0] & 0x00000800u) != 0;
   return value;
 }
 inline bool PBMeta::has_priority() const {
@@ -1605,7 +1845,7 @@ inline bool PBMeta::has_priority() const {
 }
 inline void PBMeta::clear_priority() {
   _impl_.priority_ = 0;
-  _impl_._has_bits_[0] &= ~0x00001000u;
+  _impl_._has_bits_[0] &= ~0x00000800u;
 }
 inline int32_t PBMeta::_internal_priority() const {
   return _impl_.priority_;
@@ -1615,7 +1855,7 @@ inline int32_t PBMeta::priority() const {
   return _internal_priority();
 }
 inline void PBMeta::_internal_set_priority(int32_t value) {
-  _impl_._has_bits_[0] |= 0x00001000u;
+  _impl_._has_bits_[0] |= 0x00000800u;
   _impl_.priority_ = value;
 }
 inline void PBMeta::set_priority(int32_t value) {
@@ -1625,7 +1865,7 @@ inline void PBMeta::set_priority(int32_t value) {
 
 // optional uint64 msg_sign = 15;
 inline bool PBMeta::_internal_has_msg_sign() const {
-  bool value = (_impl_._has_bits_[0] & 0x00000800u) != 0;
+  bool value = (_impl_._has_bits_[0] & 0x00002000u) != 0;
   return value;
 }
 inline bool PBMeta::has_msg_sign() const {
@@ -1633,7 +1873,7 @@ inline bool PBMeta::has_msg_sign() const {
 }
 inline void PBMeta::clear_msg_sign() {
   _impl_.msg_sign_ = uint64_t{0u};
-  _impl_._has_bits_[0] &= ~0x00000800u;
+  _impl_._has_bits_[0] &= ~0x00002000u;
 }
 inline uint64_t PBMeta::_internal_msg_sign() const {
   return _impl_.msg_sign_;
@@ -1643,7 +1883,7 @@ inline uint64_t PBMeta::msg_sign() const {
   return _internal_msg_sign();
 }
 inline void PBMeta::_internal_set_msg_sign(uint64_t value) {
-  _impl_._has_bits_[0] |= 0x00000800u;
+  _impl_._has_bits_[0] |= 0x00002000u;
   _impl_.msg_sign_ = value;
 }
 inline void PBMeta::set_msg_sign(uint64_t value) {
@@ -1651,6 +1891,454 @@ inline void PBMeta::set_msg_sign(uint64_t value) {
   // @@protoc_insertion_point(field_set:ps.PBMeta.msg_sign)
 }
 
+// optional int32 version = 16;
+inline bool PBMeta::_internal_has_version() const {
+  bool value = (_impl_._has_bits_[0] & 0x00001000u) != 0;
+  return value;
+}
+inline bool PBMeta::has_version() const {
+  return _internal_has_version();
+}
+inline void PBMeta::clear_version() {
+  _impl_.version_ = 0;
+  _impl_._has_bits_[0] &= ~0x00001000u;
+}
+inline int32_t PBMeta::_internal_version() const {
+  return _impl_.version_;
+}
+inline int32_t PBMeta::version() const {
+  // @@protoc_insertion_point(field_get:ps.PBMeta.version)
+  return _internal_version();
+}
+inline void PBMeta::_internal_set_version(int32_t value) {
+  _impl_._has_bits_[0] |= 0x00001000u;
+  _impl_.version_ = value;
+}
+inline void PBMeta::set_version(int32_t value) {
+  _internal_set_version(value);
+  // @@protoc_insertion_point(field_set:ps.PBMeta.version)
+}
+
+// optional int32 key_handle = 17;
+inline bool PBMeta::_internal_has_key_handle() const {
+  bool value = (_impl_._has_bits_[0] & 0x00004000u) != 0;
+  return value;
+}
+inline bool PBMeta::has_key_handle() const {
+  return _internal_has_key_handle();
+}
+inline void PBMeta::clear_key_handle() {
+  _impl_.key_handle_ = 0;
+  _impl_._has_bits_[0] &= ~0x00004000u;
+}
+inline int32_t PBMeta::_internal_key_handle() const {
+  return _impl_.key_handle_;
+}
+inline int32_t PBMeta::key_handle() const {
+  // @@protoc_insertion_point(field_get:ps.PBMeta.key_handle)
+  return _internal_key_handle();
+}
+inline void PBMeta::_internal_set_key_handle(int32_t value) {
+  _impl_._has_bits_[0] |= 0x00004000u;
+  _impl_.key_handle_ = value;
+}
+inline void PBMeta::set_key_handle(int32_t value) {
+  _internal_set_key_handle(value);
+  // @@protoc_insertion_point(field_set:ps.PBMeta.key_handle)
+}
+
+// optional int32 pull_codec = 18;
+inline bool PBMeta::_internal_has_pull_codec() const {
+  bool value = (_impl_._has_bits_[0] & 0x00008000u) != 0;
+  return value;
+}
+inline bool PBMeta::has_pull_codec() const {
+  return _internal_has_pull_codec();
+}
+inline void PBMeta::clear_pull_codec() {
+  _impl_.pull_codec_ = 0;
+  _impl_._has_bits_[0] &= ~0x00008000u;
+}
+inline int32_t PBMeta::_internal_pull_codec() const {
+  return _impl_.pull_codec_;
+}
+inline int32_t PBMeta::pull_codec() const {
+  // @@protoc_insertion_point(field_get:ps.PBMeta.pull_codec)
+  return _internal_pull_codec();
+}
+inline void PBMeta::_internal_set_pull_codec(int32_t value) {
+  _impl_._has_bits_[0] |= 0x00008000u;
+  _impl_.pull_codec_ = value;
+}
+inline void PBMeta::set_pull_codec(int32_t value) {
+  _internal_set_pull_codec(value);
+  // @@protoc_insertion_point(field_set:ps.PBMeta.pull_codec)
+}
+
+// optional bool sparse = 19;
+inline bool PBMeta::_internal_has_sparse() const {
+  bool value = (_impl_._has_bits_[0] & 0x00200000u) != 0;
+  return value;
+}
+inline bool PBMeta::has_sparse() const {
+  return _internal_has_sparse();
+}
+inline void PBMeta::clear_sparse() {
+  _impl_.sparse_ = false;
+  _impl_._has_bits_[0] &= ~0x00200000u;
+}
+inline bool PBMeta::_internal_sparse() const {
+  return _impl_.sparse_;
+}
+inline bool PBMeta::sparse() const {
+  // @@protoc_insertion_point(field_get:ps.PBMeta.sparse)
+  return _internal_sparse();
+}
+inline void PBMeta::_internal_set_sparse(bool value) {
+  _impl_._has_bits_[0] |= 0x00200000u;
+  _impl_.sparse_ = value;
+}
+inline void PBMeta::set_sparse(bool value) {
+  _internal_set_sparse(value);
+  // @@protoc_insertion_point(field_set:ps.PBMeta.sparse)
+}
+
+// optional uint32 compressed = 20;
+inline bool PBMeta::_internal_has_compressed() const {
+  bool value = (_impl_._has_bits_[0] & 0x00010000u) != 0;
+  return value;
+}
+inline bool PBMeta::has_compressed() const {
+  return _internal_has_compressed();
+}
+inline void PBMeta::clear_compressed() {
+  _impl_.compressed_ = 0u;
+  _impl_._has_bits_[0] &= ~0x00010000u;
+}
+inline uint32_t PBMeta::_internal_compressed() const {
+  return _impl_.compressed_;
+}
+inline uint32_t PBMeta::compressed() const {
+  // @@protoc_insertion_point(field_get:ps.PBMeta.compressed)
+  return _internal_compressed();
+}
+inline void PBMeta::_internal_set_compressed(uint32_t value) {
+  _impl_._has_bits_[0] |= 0x00010000u;
+  _impl_.compressed_ = value;
+}
+inline void PBMeta::set_compressed(uint32_t value) {
+  _internal_set_compressed(value);
+  // @@protoc_insertion_point(field_set:ps.PBMeta.compressed)
+}
+
+// optional int32 chunk_id = 21;
+inline bool PBMeta::_internal_has_chunk_id() const {
+  bool value = (_impl_._has_bits_[0] & 0x00020000u) != 0;
+  return value;
+}
+inline bool PBMeta::has_chunk_id() const {
+  return _internal_has_chunk_id();
+}
+inline void PBMeta::clear_chunk_id() {
+  _impl_.chunk_id_ = 0;
+  _impl_._has_bits_[0] &= ~0x00020000u;
+}
+inline int32_t PBMeta::_internal_chunk_id() const {
+  return _impl_.chunk_id_;
+}
+inline int32_t PBMeta::chunk_id() const {
+  // @@protoc_insertion_point(field_get:ps.PBMeta.chunk_id)
+  return _internal_chunk_id();
+}
+inline void PBMeta::_internal_set_chunk_id(int32_t value) {
+  _impl_._has_bits_[0] |= 0x00020000u;
+  _impl_.chunk_id_ = value;
+}
+inline void PBMeta::set_chunk_id(int32_t value) {
+  _internal_set_chunk_id(value);
+  // @@protoc_insertion_point(field_set:ps.PBMeta.chunk_id)
+}
+
+// optional int32 num_chunks = 22;
+inline bool PBMeta::_internal_has_num_chunks() const {
+  bool value = (_impl_._has_bits_[0] & 0x00040000u) != 0;
+  return value;
+}
+inline bool PBMeta::has_num_chunks() const {
+  return _internal_has_num_chunks();
+}
+inline void PBMeta::clear_num_chunks() {
+  _impl_.num_chunks_ = 0;
+  _impl_._has_bits_[0] &= ~0x00040000u;
+}
+inline int32_t PBMeta::_internal_num_chunks() const {
+  return _impl_.num_chunks_;
+}
+inline int32_t PBMeta::num_chunks() const {
+  // @@protoc_insertion_point(field_get:ps.PBMeta.num_chunks)
+  return _internal_num_chunks();
+}
+inline void PBMeta::_internal_set_num_chunks(int32_t value) {
+  _impl_._has_bits_[0] |= 0x00040000u;
+  _impl_.num_chunks_ = value;
+}
+inline void PBMeta::set_num_chunks(int32_t value) {
+  _internal_set_num_chunks(value);
+  // @@protoc_insertion_point(field_set:ps.PBMeta.num_chunks)
+}
+
+// optional bool omit_keys = 23;
+inline bool PBMeta::_internal_has_omit_keys() const {
+  bool value = (_impl_._has_bits_[0] & 0x00400000u) != 0;
+  return value;
+}
+inline bool PBMeta::has_omit_keys() const {
+  return _internal_has_omit_keys();
+}
+inline void PBMeta::clear_omit_keys() {
+  _impl_.omit_keys_ = false;
+  _impl_._has_bits_[0] &= ~0x00400000u;
+}
+inline bool PBMeta::_internal_omit_keys() const {
+  return _impl_.omit_keys_;
+}
+inline bool PBMeta::omit_keys() const {
+  // @@protoc_insertion_point(field_get:ps.PBMeta.omit_keys)
+  return _internal_omit_keys();
+}
+inline void PBMeta::_internal_set_omit_keys(bool value) {
+  _impl_._has_bits_[0] |= 0x00400000u;
+  _impl_.omit_keys_ = value;
+}
+inline void PBMeta::set_omit_keys(bool value) {
+  _internal_set_omit_keys(value);
+  // @@protoc_insertion_point(field_set:ps.PBMeta.omit_keys)
+}
+
+// optional int32 partition = 24;
+inline bool PBMeta::_internal_has_partition() const {
+  bool value = (_impl_._has_bits_[0] & 0x00080000u) != 0;
+  return value;
+}
+inline bool PBMeta::has_partition() const {
+  return _internal_has_partition();
+}
+inline void PBMeta::clear_partition() {
+  _impl_.partition_ = 0;
+  _impl_._has_bits_[0] &= ~0x00080000u;
+}
+inline int32_t PBMeta::_internal_partition() const {
+  return _impl_.partition_;
+}
+inline int32_t PBMeta::partition() const {
+  // @@protoc_insertion_point(field_get:ps.PBMeta.partition)
+  return _internal_partition();
+}
+inline void PBMeta::_internal_set_partition(int32_t value) {
+  _impl_._has_bits_[0] |= 0x00080000u;
+  _impl_.partition_ = value;
+}
+inline void PBMeta::set_partition(int32_t value) {
+  _internal_set_partition(value);
+  // @@protoc_insertion_point(field_set:ps.PBMeta.partition)
+}
+
+// optional int32 range_version = 25;
+inline bool PBMeta::_internal_has_range_version() const {
+  bool value = (_impl_._has_bits_[0] & 0x00100000u) != 0;
+  return value;
+}
+inline bool PBMeta::has_range_version() const {
+  return _internal_has_range_version();
+}
+inline void PBMeta::clear_range_version() {
+  _impl_.range_version_ = 0;
+  _impl_._has_bits_[0] &= ~0x00100000u;
+}
+inline int32_t PBMeta::_internal_range_version() const {
+  return _impl_.range_version_;
+}
+inline int32_t PBMeta::range_version() const {
+  // @@protoc_insertion_point(field_get:ps.PBMeta.range_version)
+  return _internal_range_version();
+}
+inline void PBMeta::_internal_set_range_version(int32_t value) {
+  _impl_._has_bits_[0] |= 0x00100000u;
+  _impl_.range_version_ = value;
+}
+inline void PBMeta::set_range_version(int32_t value) {
+  _internal_set_range_version(value);
+  // @@protoc_insertion_point(field_set:ps.PBMeta.range_version)
+}
+
+// optional int32 replica = 26;
+inline bool PBMeta::_internal_has_replica() const {
+  bool value = (_impl_._has_bits_[0] & 0x04000000u) != 0;
+  return value;
+}
+inline bool PBMeta::has_replica() const {
+  return _internal_has_replica();
+}
+inline void PBMeta::clear_replica() {
+  _impl_.replica_ = 0;
+  _impl_._has_bits_[0] &= ~0x04000000u;
+}
+inline int32_t PBMeta::_internal_replica() const {
+  return _impl_.replica_;
+}
+inline int32_t PBMeta::replica() const {
+  // @@protoc_insertion_point(field_get:ps.PBMeta.replica)
+  return _internal_replica();
+}
+inline void PBMeta::_internal_set_replica(int32_t value) {
+  _impl_._has_bits_[0] |= 0x04000000u;
+  _impl_.replica_ = value;
+}
+inline void PBMeta::set_replica(int32_t value) {
+  _internal_set_replica(value);
+  // @@protoc_insertion_point(field_set:ps.PBMeta.replica)
+}
+
+// optional uint64 ack_seq = 27;
+inline bool PBMeta::_internal_has_ack_seq() const {
+  bool value = (_impl_._has_bits_[0] & 0x02000000u) != 0;
+  return value;
+}
+inline bool PBMeta::has_ack_seq() const {
+  return _internal_has_ack_seq();
+}
+inline void PBMeta::clear_ack_seq() {
+  _impl_.ack_seq_ = uint64_t{0u};
+  _impl_._has_bits_[0] &= ~0x02000000u;
+}
+inline uint64_t PBMeta::_internal_ack_seq() const {
+  return _impl_.ack_seq_;
+}
+inline uint64_t PBMeta::ack_seq() const {
+  // @@protoc_insertion_point(field_get:ps.PBMeta.ack_seq)
+  return _internal_ack_seq();
+}
+inline void PBMeta::_internal_set_ack_seq(uint64_t value) {
+  _impl_._has_bits_[0] |= 0x02000000u;
+  _impl_.ack_seq_ = value;
+}
+inline void PBMeta::set_ack_seq(uint64_t value) {
+  _internal_set_ack_seq(value);
+  // @@protoc_insertion_point(field_set:ps.PBMeta.ack_seq)
+}
+
+// optional int32 queue_depth = 28;
+inline bool PBMeta::_internal_has_queue_depth() const {
+  bool value = (_impl_._has_bits_[0] & 0x08000000u) != 0;
+  return value;
+}
+inline bool PBMeta::has_queue_depth() const {
+  return _internal_has_queue_depth();
+}
+inline void PBMeta::clear_queue_depth() {
+  _impl_.queue_depth_ = 0;
+  _impl_._has_bits_[0] &= ~0x08000000u;
+}
+inline int32_t PBMeta::_internal_queue_depth() const {
+  return _impl_.queue_depth_;
+}
+inline int32_t PBMeta::queue_depth() const {
+  // @@protoc_insertion_point(field_get:ps.PBMeta.queue_depth)
+  return _internal_queue_depth();
+}
+inline void PBMeta::_internal_set_queue_depth(int32_t value) {
+  _impl_._has_bits_[0] |= 0x08000000u;
+  _impl_.queue_depth_ = value;
+}
+inline void PBMeta::set_queue_depth(int32_t value) {
+  _internal_set_queue_depth(value);
+  // @@protoc_insertion_point(field_set:ps.PBMeta.queue_depth)
+}
+
+// optional int32 since_version = 29;
+inline bool PBMeta::_internal_has_since_version() const {
+  bool value = (_impl_._has_bits_[0] & 0x10000000u) != 0;
+  return value;
+}
+inline bool PBMeta::has_since_version() const {
+  return _internal_has_since_version();
+}
+inline void PBMeta::clear_since_version() {
+  _impl_.since_version_ = 0;
+  _impl_._has_bits_[0] &= ~0x10000000u;
+}
+inline int32_t PBMeta::_internal_since_version() const {
+  return _impl_.since_version_;
+}
+inline int32_t PBMeta::since_version() const {
+  // @@protoc_insertion_point(field_get:ps.PBMeta.since_version)
+  return _internal_since_version();
+}
+inline void PBMeta::_internal_set_since_version(int32_t value) {
+  _impl_._has_bits_[0] |= 0x10000000u;
+  _impl_.since_version_ = value;
+}
+inline void PBMeta::set_since_version(int32_t value) {
+  _internal_set_since_version(value);
+  // @@protoc_insertion_point(field_set:ps.PBMeta.since_version)
+}
+
+// optional bool delta = 30;
+inline bool PBMeta::_internal_has_delta() const {
+  bool value = (_impl_._has_bits_[0] & 0x00800000u) != 0;
+  return value;
+}
+inline bool PBMeta::has_delta() const {
+  return _internal_has_delta();
+}
+inline void PBMeta::clear_delta() {
+  _impl_.delta_ = false;
+  _impl_._has_bits_[0] &= ~0x00800000u;
+}
+inline bool PBMeta::_internal_delta() const {
+  return _impl_.delta_;
+}
+inline bool PBMeta::delta() const {
+  // @@protoc_insertion_point(field_get:ps.PBMeta.delta)
+  return _internal_delta();
+}
+inline void PBMeta::_internal_set_delta(bool value) {
+  _impl_._has_bits_[0] |= 0x00800000u;
+  _impl_.delta_ = value;
+}
+inline void PBMeta::set_delta(bool value) {
+  _internal_set_delta(value);
+  // @@protoc_insertion_point(field_set:ps.PBMeta.delta)
+}
+
+// optional bool tick = 31;
+inline bool PBMeta::_internal_has_tick() const {
+  bool value = (_impl_._has_bits_[0] & 0x01000000u) != 0;
+  return value;
+}
+inline bool PBMeta::has_tick() const {
+  return _internal_has_tick();
+}
+inline void PBMeta::clear_tick() {
+  _impl_.tick_ = false;
+  _impl_._has_bits_[0] &= ~0x01000000u;
+}
+inline bool PBMeta::_internal_tick() const {
+  return _impl_.tick_;
+}
+inline bool PBMeta::tick() const {
+  // @@protoc_insertion_point(field_get:ps.PBMeta.tick)
+  return _internal_tick();
+}
+inline void PBMeta::_internal_set_tick(bool value) {
+  _impl_._has_bits_[0] |= 0x01000000u;
+  _impl_.tick_ = value;
+}
+inline void PBMeta::set_tick(bool value) {
+  _internal_set_tick(value);
+  // @@protoc_insertion_point(field_set:ps.PBMeta.tick)
+}
+
 #ifdef __GNUC__
   #pragma GCC diagnostic pop
 #endif  // __GNUC__
@@ -0,0 +1,130 @@
+/**
+ * @file Customer_test.cpp
+ */
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "ps/Base.h"
+#include "../Customer.h"
+#include "../PostOffice.h"
+
+using std::vector;
+using namespace std::chrono_literals;
+
+namespace ps {
+
+/**
+ * @brief 不启动系统，只设置 Customer::NewRequest 需要的节点：2 个 server 与 scheduler
+ */
+class CustomerTest : public ::testing::Test {
+ protected:
+	static void SetUpTestSuite() {
+		auto& ids = PostOffice::Get()->node_ids_;
+		ids[kServerGroup] = {PostOffice::ServerRankToID(0), PostOffice::ServerRankToID(1)};
+		ids[kScheduler] = {kScheduler};
+	}
+
+	CustomerTest() : customer(0, 0, [](const Message&) {}) {}
+
+	Customer customer;
+};
+
+TEST_F(CustomerTest, IsDone) {
+	int ts = customer.NewRequest(kServerGroup);
+	EXPECT_EQ(customer.GetExpectedResponse(ts), 2);
+	EXPECT_FALSE(customer.IsDone(ts));
+	customer.AddResponse(ts);
+	EXPECT_FALSE(customer.IsDone(ts));
+	customer.AddResponse(ts);
+	EXPECT_TRUE(customer.IsDone(ts));
+	EXPECT_EQ(customer.GetResponse(ts), 2);
+
+	// 分块发送的请求
+	ts = customer.NewRequest(kScheduler);
+	customer.AddExpectedResponse(ts, 2);
+	customer.AddResponse(ts, 2);
+	EXPECT_FALSE(customer.IsDone(ts));
+	customer.AddResponse(ts);
+	EXPECT_TRUE(customer.IsDone(ts));
+}
+
+TEST_F(CustomerTest, Timeouts) {
+	int a = customer.NewRequest(kScheduler), b = customer.NewRequest(kScheduler);
+	EXPECT_FALSE(customer.WaitRequest(a, 10ms));
+	EXPECT_FALSE(customer.WaitAll({a, b}, 10ms));
+	EXPECT_EQ(customer.WaitAny({a, b}, 10ms), -1);
+
+	customer.AddResponse(b);
+	EXPECT_TRUE(customer.WaitRequest(b, 0ms));
+	EXPECT_FALSE(customer.WaitAll({a, b}, 10ms));
+	EXPECT_EQ(customer.WaitAny({a, b}, 0ms), 1);
+
+	customer.AddResponse(a);
+	EXPECT_TRUE(customer.WaitAll({a, b}, 0ms));
+	// 有多个已完成时返回最小的下标
+	EXPECT_EQ(customer.WaitAny({a, b}), 0);
+	EXPECT_TRUE(customer.WaitAll({a, b}));
+}
+
+TEST_F(CustomerTest, ConcurrentComplete) {
+	// 另一个线程在等待开始前后完成请求，等待者不能错过通知。通知丢失时等待会超时
+	for (int i = 0; i < 200; ++i) {
+		int a = customer.NewRequest(kServerGroup), b = customer.NewRequest(kScheduler);
+		std::thread t([&]() {
+			if (i % 2) std::this_thread::sleep_for(std::chrono::microseconds(i));
+			customer.AddResponse(a);
+			customer.AddResponse(b);
+			customer.AddResponse(a);
+		});
+		switch (i % 4) {
+			case 0: EXPECT_TRUE(customer.WaitAll({a, b}, 5s)) << i; break;
+			case 1: EXPECT_NE(customer.WaitAny({a, b}, 5s), -1) << i; break;
+			case 2: EXPECT_TRUE(customer.WaitRequest(a, 5s)) << i; break;
+			case 3: customer.WaitRequest(a); break;
+		}
+		t.join();
+		EXPECT_TRUE(customer.IsDone(a) && customer.IsDone(b));
+	}
+}
+
+TEST_F(CustomerTest, ChunkGrowth) {
+	// 超过第一块（1024 个）与第二块，Tracker 分配到新的块中
+	vector<int> ids;
+	for (int i = 0; i < 4000; ++i) {
+		ids.push_back(customer.NewRequest(kScheduler));
+		EXPECT_EQ(ids.back(), i);
+	}
+	for (int id: ids) {
+		if (id % 3 == 0) customer.AddResponse(id);
+	}
+	for (int id: ids) {
+		EXPECT_EQ(customer.IsDone(id), id % 3 == 0) << id;
+		EXPECT_EQ(customer.GetExpectedResponse(id), 1) << id;
+	}
+	// 1024 为第二块的第一个，3072 为第三块的第一个
+	EXPECT_EQ(customer.WaitAny({1024, 1025, 3072}, 0ms), 2);
+	customer.AddResponse(1025);
+	EXPECT_EQ(customer.WaitAny({1024, 1025}, 0ms), 1);
+
+	// 其它线程同时创建请求，新块只分配一次
+	vector<std::thread> threads;
+	vector<vector<int>> created(4);
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([&, t]() {
+			for (int i = 0; i < 2000; ++i) created[t].push_back(customer.NewRequest(kScheduler));
+		});
+	}
+	for (auto& t: threads) t.join();
+	for (auto& c: created) {
+		for (int id: c) {
+			EXPECT_FALSE(customer.IsDone(id));
+			customer.AddResponse(id);
+			EXPECT_TRUE(customer.IsDone(id));
+		}
+	}
+}
+
+} // namespace ps
@@ -0,0 +1,146 @@
+/**
+ * @file FlowController_test.cpp
+ */
+#include <gtest/gtest.h>
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "ps/Base.h"
+#include "../FlowController.h"
+#include "../Van.h"
+
+using std::vector;
+
+namespace ps {
+
+namespace {
+
+constexpr int kServer = 8;
+
+/**
+ * @brief 只记录发出的消息的 Van
+ */
+class StubVan: public Van {
+ public:
+	/**
+	 * @brief 已发出的消息的时间戳
+	 */
+	vector<int> sent() {
+		std::lock_guard<std::mutex> lk(mu_);
+		return sent_;
+	}
+
+ protected:
+	int Bind(const Node&, int) override { return 0; }
+	void Connect(const Node&) override {}
+	int SendMsg(const Message& msg) override {
+		std::lock_guard<std::mutex> lk(mu_);
+		sent_.push_back(msg.meta.timestamp);
+		return 0;
+	}
+	int ReceiveMsg(Message*) override { return -1; }
+
+ private:
+	std::mutex mu_;
+	vector<int> sent_;
+};
+
+/**
+ * @brief 发给 kServer 的第 timestamp 个请求（或其中一块），key 为空，value 为 bytes 字节
+ */
+Message Request(int timestamp, size_t bytes) {
+	Message msg;
+	msg.meta.request = true;
+	msg.meta.receiver = kServer;
+	msg.meta.timestamp = timestamp;
+	msg.AddData(SVector<Key>());
+	msg.AddData(SVector<char>(bytes));
+	return msg;
+}
+
+/**
+ * @brief kServer 对第 timestamp 个请求（或其中一块）的回复
+ */
+Message Response(int timestamp) {
+	Message msg;
+	msg.meta.sender = kServer;
+	msg.meta.timestamp = timestamp;
+	return msg;
+}
+
+} // namespace
+
+TEST(FlowControllerTest, MaxRequests) {
+	StubVan van;
+	FlowController fc(0, 2, FLOW_QUEUE, &van);
+	for (int ts = 0; ts < 4; ++ts) fc.Send(Request(ts, 10));
+	EXPECT_EQ(van.sent(), (vector<int>{0, 1}));
+	EXPECT_EQ(fc.stalls(), 2u);
+	// 按发送的顺序放行
+	fc.OnResponse(Response(1));
+	EXPECT_EQ(van.sent(), (vector<int>{0, 1, 2}));
+	fc.OnResponse(Response(0));
+	EXPECT_EQ(van.sent(), (vector<int>{0, 1, 2, 3}));
+	// 没有记录的回复（如未经流量控制发送的请求）不归还额度
+	fc.OnResponse(Response(100));
+	fc.Send(Request(4, 10));
+	EXPECT_EQ(van.sent().size(), 4u);
+}
+
+TEST(FlowControllerTest, OutOfOrderChunks) {
+	StubVan van;
+	FlowController fc(600, 0, FLOW_QUEUE, &van);
+	// 一个请求的三块，共 600 字节
+	fc.Send(Request(0, 100));
+	fc.Send(Request(0, 200));
+	fc.Send(Request(0, 300));
+	fc.Send(Request(1, 300));
+	EXPECT_EQ(van.sent(), (vector<int>{0, 0, 0}));
+	// 每块归还平均的 200 字节，不论回复的是哪一块
+	fc.OnResponse(Response(0));
+	EXPECT_EQ(van.sent().size(), 3u);
+	fc.OnResponse(Response(0));
+	EXPECT_EQ(van.sent(), (vector<int>{0, 0, 0, 1}));
+	// 最后一块归还剩余的 200 字节：进行中的只有请求 1 的 300 字节
+	fc.OnResponse(Response(0));
+	fc.Send(Request(2, 300));
+	EXPECT_EQ(van.sent().size(), 5u);
+	fc.Send(Request(3, 1));
+	EXPECT_EQ(van.sent().size(), 5u);
+}
+
+TEST(FlowControllerTest, OversizedRequest) {
+	StubVan van;
+	FlowController fc(100, 0, FLOW_QUEUE, &van);
+	// 没有进行中的请求时，超过额度的请求也会发送
+	fc.Send(Request(0, 1000));
+	EXPECT_EQ(van.sent().size(), 1u);
+	EXPECT_EQ(fc.stalls(), 0u);
+	fc.Send(Request(1, 1));
+	EXPECT_EQ(van.sent().size(), 1u);
+	fc.OnResponse(Response(0));
+	EXPECT_EQ(van.sent(), (vector<int>{0, 1}));
+}
+
+TEST(FlowControllerTest, Block) {
+	StubVan van;
+	FlowController fc(0, 1, FLOW_BLOCK, &van);
+	fc.Send(Request(0, 10));
+	std::atomic<bool> sent{false};
+	std::thread t([&]() {
+		fc.Send(Request(1, 10));
+		sent = true;
+	});
+	while (fc.stalls() == 0) std::this_thread::yield();
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	EXPECT_FALSE(sent);
+	fc.OnResponse(Response(0));
+	t.join();
+	EXPECT_EQ(van.sent(), (vector<int>{0, 1}));
+	EXPECT_EQ(fc.stalls(), 1u);
+}
+
+} // namespace ps
@@ -0,0 +1,110 @@
+/**
+ * @file Rebalancer_test.cpp
+ */
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <utility>
+
+#include "../Rebalancer.h"
+
+using std::vector;
+using Samples = vector<std::pair<ps::Key, double>>;
+
+namespace ps {
+
+/**
+ * @brief 测试 Rebalancer 的静态函数，不需要启动系统
+ */
+class RebalancerTest : public ::testing::Test {
+ protected:
+	static void Compact(Samples* samples, size_t max_samples) {
+		Rebalancer::Compact(samples, max_samples);
+	}
+
+	/**
+	 * @brief 区间首尾相接，覆盖所有 key，且都不为空
+	 */
+	static void ExpectCover(const vector<Range>& ranges, int num_servers) {
+		ASSERT_EQ(ranges.size(), static_cast<size_t>(num_servers));
+		EXPECT_EQ(ranges.front().begin, 0u);
+		EXPECT_EQ(ranges.back().end, kMaxKey);
+		for (size_t i = 0; i < ranges.size(); ++i) {
+			EXPECT_LT(ranges[i].begin, ranges[i].end) << i;
+			if (i) {
+				EXPECT_EQ(ranges[i].begin, ranges[i - 1].end) << i;
+			}
+		}
+	}
+
+	/**
+	 * @brief 各区间的负载
+	 */
+	static vector<double> Loads(const Samples& samples, const vector<Range>& ranges) {
+		vector<double> loads(ranges.size(), 0);
+		for (const auto& [key, w]: samples) {
+			for (size_t i = 0; i < ranges.size(); ++i) {
+				if (key >= ranges[i].begin && key < ranges[i].end) loads[i] += w;
+			}
+		}
+		return loads;
+	}
+};
+
+TEST_F(RebalancerTest, CompactMergesKeys) {
+	Samples s = {{5, 1}, {1, 2}, {5, 3}, {3, 1}, {1, 1}};
+	Compact(&s, 10);
+	EXPECT_EQ(s, (Samples{{1, 3}, {3, 1}, {5, 4}}));
+}
+
+TEST_F(RebalancerTest, CompactToMaxSamples) {
+	Samples s;
+	for (Key k = 0; k < 1000; ++k) s.push_back({999 - k, 1});
+	Compact(&s, 10);
+	ASSERT_LE(s.size(), 10u);
+	double total = 0;
+	for (size_t i = 0; i < s.size(); ++i) {
+		total += s[i].second;
+		if (i) {
+			EXPECT_LT(s[i - 1].first, s[i].first);
+		}
+	}
+	EXPECT_DOUBLE_EQ(total, 1000);
+	// 每段用最后一个 key 代表，最后一段包含最大的 key
+	EXPECT_EQ(s.back().first, 999u);
+}
+
+TEST_F(RebalancerTest, BalanceUniform) {
+	Samples s;
+	for (Key k = 0; k < 1000; ++k) s.push_back({k * 1000, 1});
+	vector<Range> ranges = Rebalancer::BalanceRanges(s, 4);
+	ExpectCover(ranges, 4);
+	for (double load: Loads(s, ranges)) EXPECT_NEAR(load, 250, 1);
+}
+
+TEST_F(RebalancerTest, BalanceSkewed) {
+	// 三分之一的负载在 key 10 上，它单独成为一个区间，其余 key 分给另外两个
+	Samples s = {{10, 200}};
+	for (Key k = 0; k < 400; ++k) s.push_back({100 + k, 1});
+	vector<Range> ranges = Rebalancer::BalanceRanges(s, 3);
+	ExpectCover(ranges, 3);
+	vector<double> loads = Loads(s, ranges);
+	EXPECT_DOUBLE_EQ(loads[0], 200);
+	EXPECT_NEAR(loads[1], 200, 1);
+	EXPECT_NEAR(loads[2], 200, 1);
+}
+
+TEST_F(RebalancerTest, NonEmptyNearMaxKey) {
+	// 负载都在最大的 key 附近，区间仍然不为空，且给之后的区间留出位置
+	Samples s = {{kMaxKey - 1, 10}, {kMaxKey - 2, 10}};
+	ExpectCover(Rebalancer::BalanceRanges(s, 4), 4);
+	ExpectCover(Rebalancer::BalanceRanges({{kMaxKey - 1, 1}}, 8), 8);
+	// 都在 0 上时，之后的区间从 1 开始
+	vector<Range> ranges = Rebalancer::BalanceRanges({{0, 5}}, 3);
+	ExpectCover(ranges, 3);
+	EXPECT_EQ(ranges[0].end, 1u);
+	// 没有样本
+	ExpectCover(Rebalancer::BalanceRanges({}, 3), 3);
+}
+
+} // namespace ps
@@ -0,0 +1,426 @@
+/**
+ * @file Consistency.h
+ * @brief KVServer 的一致性控制：BSP、SSP 与异步。
+ * 使用 KVServer::SetConsistency 启用，应用的 request handle 不需要自己实现同步逻辑。
+ */
+#pragma once
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+
+#include "../ps/KVApp.h"
+#include "../utility/SIMD.h"
+
+namespace ps {
+
+/**
+ * @brief 一致性控制器。由 KVServer 持有，位于接收请求与 request handle、handle 回复与发送之间。
+ * OnRequest 仅由 KVServer 的接收线程调用；OnResponse 可能由任意线程调用（handle 可以异步回复）。
+ */
+template <typename Value>
+class ConsistencyController {
+ public:
+	/* 调用应用的 request handle */
+	using Handle = std::function<void(const KVMeta& req_meta, const KVPairs<Value>& req_data)>;
+	/* 实际发送回复 */
+	using Sender = std::function<void(const KVMeta& req_meta, const KVPairs<Value>& res)>;
+
+	/**
+	 * @param staleness SSP 中允许领先最慢 worker 的时钟数
+	 * @param num_workers worker 数量
+	 */
+	ConsistencyController(ConsistencyModel model, int staleness, int num_workers,
+			const Handle& handle, const Sender& sender)
+		: model_(model), staleness_(staleness), clocks_(num_workers, 0), handle_(handle), sender_(sender) {
+		CHECK_GT(num_workers, 0);
+		CHECK_GE(staleness_, 0);
+	}
+
+	/**
+	 * @brief 设置 BSP 的备份 worker 数量 k：每轮只需收到 N-k 个 worker 的推送就进行更新并回复，
+	 * 不再等待最慢的 k 个 worker。
+	 * 迟到的推送（所属轮次已经完成）会被立即回复，其数据根据 drop_late 被丢弃，或合并到当前正在进行的一轮中。
+	 */
+	void SetBackupWorkers(int num_backup, bool drop_late) {
+		CHECK_EQ(model_, BSP) << "Backup workers can only be used with BSP";
+		CHECK(num_backup >= 0 && static_cast<size_t>(num_backup) < clocks_.size())
+			<< "Invalid number of backup workers: " << num_backup;
+		std::lock_guard<std::mutex> lk(mu_);
+		num_backup_ = num_backup;
+		drop_late_ = drop_late;
+	}
+
+	/**
+	 * @brief 处理 worker 的请求。
+	 */
+	void OnRequest(KVMeta& meta, const KVPairs<Value>& data) {
+		if (model_ == ASYNC) {
+			handle_(meta, data);
+			return;
+		}
+		if (!meta.push) {
+			handle_(meta, data);
+			return;
+		}
+		if (model_ == SSP) {
+			{
+				std::lock_guard<std::mutex> lk(mu_);
+				bool complete;
+				meta.clock = ChunkClock(meta, &complete);
+			}
+			handle_(meta, data);
+			ReleaseDeferred();
+			return;
+		}
+		OnBSPPush(meta, data);
+	}
+
+	/**
+	 * @brief 处理 worker 的时钟：它的一次推送没有发给本节点的 key（见 Meta::tick）。
+	 * 时钟与推送一样推进，使只访问部分 server 的 worker 不会让其它 server 的 BSP 轮次或 SSP 的最小时钟停止推进。
+	 */
+	void OnTick(int sender) {
+		std::vector<std::pair<KVMeta, KVPairs<Value>>> ready;
+		{
+			std::lock_guard<std::mutex> lk(mu_);
+			int clock = Tick(sender);
+			if (model_ == BSP) {
+				if (clock > closed_rounds_) {
+					++rounds_[clock].arrived;
+				}
+				CloseRounds(&ready);
+			}
+		}
+		if (model_ == SSP) {
+			ReleaseDeferred();
+		}
+		for (const auto& [merged_meta, merged_data]: ready) {
+			handle_(merged_meta, merged_data);
+		}
+	}
+
+	/**
+	 * @brief 迟到（被丢弃或合并到之后的轮次）的推送数量。
+	 */
+	int late_pushes() {
+		std::lock_guard<std::mutex> lk(mu_);
+		return late_pushes_;
+	}
+
+	/**
+	 * @brief 处理 handle 的回复：立即发送、推迟发送，或者对 BSP 合并得到的请求，回复所有被合并的请求。
+	 */
+	void OnResponse(const KVMeta& req, const KVPairs<Value>& res) {
+		if (req.merged) {
+			Round round;
+			{
+				std::lock_guard<std::mutex> lk(mu_);
+				auto it = rounds_.find(req.clock);
+				CHECK(it != rounds_.end()) << "Response to an unknown merged request, clock: " << req.clock;
+				round = std::move(it->second);
+				rounds_.erase(it);
+			}
+			for (const auto& [meta, keys]: round.requests) {
+				sender_(meta, meta.pull ? SelectKeys(res, keys) : KVPairs<Value>());
+			}
+			return;
+		}
+		if (model_ == SSP && req.push && req.clock >= 0) {
+			std::lock_guard<std::mutex> lk(mu_);
+			if (req.clock - min_clock_ > staleness_) {
+				deferred_.push_back({req, res});
+				return;
+			}
+		}
+		sender_(req, res);
+	}
+
+	ConsistencyModel model() const {
+		return model_;
+	}
+
+ private:
+	/**
+	 * @brief 一个被合并的请求。pull 时保存其 key，以从合并请求的回复中选出它需要的部分。
+	 */
+	struct Request {
+		KVMeta meta;
+		SVector<Key> keys;
+	};
+	/**
+	 * @brief BSP 中一轮的请求。
+	 */
+	struct Round {
+		std::vector<Request> requests;
+		/* 计入该轮的推送数量（不含合并进来的迟到推送） */
+		int arrived{0};
+		/* 该轮 push 的合并结果 */
+		KVPairs<Value> data;
+	};
+	/**
+	 * @brief 一个还没有收到所有块的推送。
+	 */
+	struct ChunkedPush {
+		int clock;
+		/* 还没有收到的块数 */
+		int remaining;
+	};
+
+	int Rank(int sender) const {
+		int rank = PostOffice::IDToRank(sender);
+		CHECK_LT(static_cast<size_t>(rank), clocks_.size()) << "Invalid sender: " << sender;
+		return rank;
+	}
+
+	/**
+	 * @brief 增加 worker 的时钟并更新最小时钟，返回其新时钟。需持有 mu_。
+	 */
+	int Tick(int sender) {
+		int clock = ++clocks_[Rank(sender)];
+		min_clock_ = *std::min_element(clocks_.begin(), clocks_.end());
+		return clock;
+	}
+
+	/**
+	 * @brief 返回推送的时钟。分块的推送（见 KVWorker::SetChunkSize）只在收到第一块时增加时钟，其余块使用相同的时钟；
+	 * 块可能被乱序处理，因此按 (发送者, 时间戳) 记录。complete 表示这是该推送最后到达的一块。需持有 mu_。
+	 */
+	int ChunkClock(const KVMeta& meta, bool* complete) {
+		if (meta.num_chunks <= 1) {
+			*complete = true;
+			return Tick(meta.sender);
+		}
+		uint64_t id = (static_cast<uint64_t>(meta.sender) << 32) | static_cast<uint32_t>(meta.timestamp);
+		auto it = chunks_.find(id);
+		if (it == chunks_.end()) {
+			it = chunks_.emplace(id, ChunkedPush{Tick(meta.sender), meta.num_chunks}).first;
+		}
+		int clock = it->second.clock;
+		*complete = --it->second.remaining == 0;
+		if (*complete) {
+			chunks_.erase(it);
+		}
+		return clock;
+	}
+
+	/**
+	 * @brief BSP 下处理一次推送。推送所属的轮次为发送者的时钟。
+	 */
+	void OnBSPPush(KVMeta& meta, const KVPairs<Value>& data) {
+		std::vector<std::pair<KVMeta, KVPairs<Value>>> ready;
+		bool late = false;
+		{
+			std::lock_guard<std::mutex> lk(mu_);
+			bool complete;
+			meta.clock = ChunkClock(meta, &complete);
+			if (meta.clock > closed_rounds_) {
+				Round& r = rounds_[meta.clock];
+				Merge(r.data, data);
+				r.requests.push_back({meta, meta.pull ? data.keys : SVector<Key>()});
+				// 分块的推送在所有块都到达后才计入
+				if (complete) ++r.arrived;
+			} else {
+				// 该轮已经完成，推送基于过时的参数
+				late = true;
+				if (complete) ++late_pushes_;
+				if (!drop_late_) {
+					// 合并到正在进行的一轮中，但不计入该轮的推送数量
+					Merge(rounds_[closed_rounds_ + 1].data, data);
+				}
+			}
+			CloseRounds(&ready);
+		}
+		if (late) {
+			// 立即回复迟到的推送，使其尽快赶上（不能等待下一轮完成：其它 worker 可能已经结束推送）
+			if (meta.pull) {
+				KVMeta pull_meta = meta;
+				pull_meta.push = false;
+				KVPairs<Value> pull_data;
+				pull_data.keys = data.keys;
+				handle_(pull_meta, pull_data);
+			} else {
+				sender_(meta, KVPairs<Value>());
+			}
+		}
+		for (const auto& [merged_meta, merged_data]: ready) {
+			handle_(merged_meta, merged_data);
+		}
+	}
+
+	/**
+	 * @brief 依次完成已收到足够推送的轮次，将要交给 handle 的合并请求放入 ready。需持有 mu_。
+	 */
+	void CloseRounds(std::vector<std::pair<KVMeta, KVPairs<Value>>>* ready) {
+		const int quorum = static_cast<int>(clocks_.size()) - num_backup_;
+		for (auto it = rounds_.find(closed_rounds_ + 1);
+				it != rounds_.end() && it->second.arrived >= quorum;
+				it = rounds_.find(closed_rounds_ + 1)) {
+			++closed_rounds_;
+			if (it->second.requests.empty()) {
+				// 该轮只收到了时钟，不需要调用 handle；合并进来的迟到推送留给下一轮
+				KVPairs<Value> late = std::move(it->second.data);
+				rounds_.erase(it);
+				if (!late.keys.empty()) {
+					Merge(rounds_[closed_rounds_ + 1].data, late);
+				}
+				continue;
+			}
+			ready->emplace_back(MergedMeta(it->second, closed_rounds_), std::move(it->second.data));
+			it->second.data = KVPairs<Value>();
+		}
+	}
+
+	/**
+	 * @brief 发送已满足延迟条件的回复。
+	 */
+	void ReleaseDeferred() {
+		std::vector<std::pair<KVMeta, KVPairs<Value>>> ready;
+		{
+			std::lock_guard<std::mutex> lk(mu_);
+			auto it = std::partition(deferred_.begin(), deferred_.end(), [this](const auto& d) {
+				return d.first.clock - min_clock_ > staleness_;
+			});
+			ready.assign(std::make_move_iterator(it), std::make_move_iterator(deferred_.end()));
+			deferred_.erase(it, deferred_.end());
+		}
+		for (const auto& [meta, res]: ready) {
+			sender_(meta, res);
+		}
+	}
+
+	/**
+	 * @brief 生成代表一轮请求的元信息。cmd、sender 等使用 rank 最小的 worker 的请求，clock 为轮次。
+	 */
+	static KVMeta MergedMeta(const Round& round, int index) {
+		const KVMeta* first = &round.requests.front().meta;
+		bool pull = false;
+		for (const auto& r: round.requests) {
+			pull |= r.meta.pull;
+			if (r.meta.sender < first->sender) {
+				first = &r.meta;
+			}
+		}
+		KVMeta meta = *first;
+		meta.pull = pull;
+		meta.clock = index;
+		meta.merged = true;
+		// 合并的请求包含所有块与所有被合并的 key
+		meta.chunk_id = 0;
+		meta.num_chunks = 1;
+		meta.keys = round.data.keys;
+		return meta;
+	}
+
+	/**
+	 * @brief dst += src
+	 */
+	static void AddTo(Value* dst, const Value* src, size_t n) {
+		if constexpr (std::is_same_v<Value, float> || std::is_same_v<Value, double>) {
+			simd::Add(dst, src, n);
+		} else {
+			for (size_t i = 0; i < n; ++i) dst[i] += src[i];
+		}
+	}
+
+	/**
+	 * @brief 将 data 合并到 merged。key 相同时直接累加 value，否则按 key 归并。
+	 */
+	static void Merge(KVPairs<Value>& merged, const KVPairs<Value>& data) {
+		CHECK(data.lens.empty()) << "BSP doesn't support lens";
+		if (data.keys.empty()) return;
+		if (merged.keys.empty()) {
+			merged.keys = data.keys;
+			merged.vals.CopyFrom(data.vals.data(), data.vals.size());
+			return;
+		}
+		size_t k = merged.vals.size() / merged.keys.size();
+		CHECK_EQ(k * data.keys.size(), data.vals.size()) << "Unmatched value length";
+		if (merged.keys.size() == data.keys.size() &&
+				memcmp(merged.keys.data(), data.keys.data(), data.keys.size() * sizeof(Key)) == 0) {
+			AddTo(merged.vals.data(), data.vals.data(), merged.vals.size());
+			return;
+		}
+		// 两个有序 key 列表的并集
+		size_t n = merged.keys.size(), m = data.keys.size();
+		SVector<Key> keys;
+		SVector<Value> vals;
+		keys.resize(n + m);
+		vals.resize((n + m) * k);
+		size_t i = 0, j = 0, t = 0;
+		for (; i < n || j < m; ++t) {
+			Value* dst = vals.data() + t * k;
+			if (j == m || (i < n && merged.keys[i] < data.keys[j])) {
+				keys[t] = merged.keys[i];
+				memcpy(dst, merged.vals.data() + i++ * k, k * sizeof(Value));
+			} else if (i == n || data.keys[j] < merged.keys[i]) {
+				keys[t] = data.keys[j];
+				memcpy(dst, data.vals.data() + j++ * k, k * sizeof(Value));
+			} else {
+				keys[t] = merged.keys[i];
+				memcpy(dst, merged.vals.data() + i++ * k, k * sizeof(Value));
+				AddTo(dst, data.vals.data() + j++ * k, k);
+			}
+		}
+		keys.resize(t);
+		vals.resize(t * k);
+		merged.keys = keys;
+		merged.vals = vals;
+	}
+
+	/**
+	 * @brief 从合并请求的回复中选出 keys 对应的部分。keys 与回复相同时不拷贝。
+	 */
+	static KVPairs<Value> SelectKeys(const KVPairs<Value>& res, const SVector<Key>& keys) {
+		if (res.keys.size() == keys.size() &&
+				memcmp(res.keys.data(), keys.data(), keys.size() * sizeof(Key)) == 0) {
+			return res;
+		}
+		CHECK(res.lens.empty()) << "BSP doesn't support lens";
+		CHECK(!res.keys.empty());
+		size_t k = res.vals.size() / res.keys.size();
+		KVPairs<Value> out;
+		out.keys = keys;
+		out.vals.resize(keys.size() * k);
+		size_t j = 0;
+		for (size_t i = 0; i < keys.size(); ++i) {
+			while (j < res.keys.size() && res.keys[j] < keys[i]) ++j;
+			CHECK(j < res.keys.size() && res.keys[j] == keys[i]) << "Key " << keys[i] << " is missing in response";
+			memcpy(out.vals.data() + i * k, res.vals.data() + j * k, k * sizeof(Value));
+		}
+		return out;
+	}
+
+	ConsistencyModel model_;
+	int staleness_;
+
+	/* 各 worker 的时钟，按 rank 索引 */
+	std::vector<int> clocks_;
+	/* 所有 worker 中最小的时钟 */
+	int min_clock_{0};
+
+	/* BSP：轮次 -> 该轮收到的请求。轮次从 1 开始 */
+	std::map<int, Round> rounds_;
+	/* BSP：已完成的轮数 */
+	int closed_rounds_{0};
+	/* BSP：备份 worker 数量，即每轮可以不等待的 worker 数量 */
+	int num_backup_{0};
+	/* BSP：是否丢弃迟到的推送。否则合并到下一轮 */
+	bool drop_late_{true};
+	/* 迟到的推送数量 */
+	int late_pushes_{0};
+	/* 分块的推送：(发送者, 时间戳) -> 该推送的时钟与剩余块数 */
+	std::unordered_map<uint64_t, ChunkedPush> chunks_;
+	/* SSP：被推迟的回复 */
+	std::vector<std::pair<KVMeta, KVPairs<Value>>> deferred_;
+	std::mutex mu_;
+
+	Handle handle_;
+	Sender sender_;
+};
+
+} // namespace ps
@@ -0,0 +1,241 @@
+/**
+ * @file Coroutine.h
+ * @brief KVWorker 的协程接口：在协程（Task）中 co_await 请求，请求进行时不占用线程，也不需要回调。
+ * 一个线程中的 Executor 可以运行很多个 Task，使它们的请求重叠：
+ * \code
+ *	 Task Train(KVWorker<float>* kv, SVector<Key> keys, int iters) {
+ *		 SVector<float> weights, grads;
+ *		 for (int i = 0; i < iters; ++i) {
+ *			 co_await AsyncZPull(kv, keys, &weights);
+ *			 // 计算 grads ...
+ *			 co_await AsyncZPush(kv, keys, grads);
+ *		 }
+ *	 }
+ *
+ *	 Executor executor;
+ *	 for (auto& part: parts) executor.Spawn(Train(&kv, part, 100));
+ *	 executor.Run(); // 所有 Task 结束后返回
+ * \endcode
+ */
+#pragma once
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <coroutine>
+#include <exception>
+#include <condition_variable>
+
+#include "../ps/KVApp.h"
+
+namespace ps {
+
+class Executor;
+
+/**
+ * @brief 由 Executor 运行的协程，返回类型为 Task 的函数即为协程。
+ * 创建后不会立即执行，需要用 Executor::Spawn 交给执行器。不支持 co_await 另一个 Task（可以分别 Spawn）。
+ */
+class Task {
+ public:
+	struct promise_type {
+		/* 运行该协程的执行器，Spawn 时设置 */
+		Executor* executor{nullptr};
+		std::exception_ptr exception;
+
+		Task get_return_object() {
+			return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+		std::suspend_always initial_suspend() noexcept {
+			return {};
+		}
+		/* 结束后保持挂起，由 Executor 销毁 */
+		std::suspend_always final_suspend() noexcept {
+			return {};
+		}
+		void return_void() {}
+		void unhandled_exception() {
+			exception = std::current_exception();
+		}
+	};
+	using Handle = std::coroutine_handle<promise_type>;
+
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+	Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+	~Task() {
+		// 没有交给 Executor 的协程还未开始执行，可以直接销毁
+		if (handle_) handle_.destroy();
+	}
+
+ private:
+	friend class Executor;
+
+	explicit Task(Handle handle) : handle_(handle) {}
+
+	Handle handle_;
+};
+
+/**
+ * @brief 在一个线程中运行 Task 的执行器。
+ * Run 在调用线程中依次恢复就绪的协程，直到所有 Task 结束。请求完成时，Customer 的接收线程只将等待它的协程放入就绪队列，
+ * 协程的其余部分仍在 Run 的线程中执行，因此 Task 之间不需要加锁。
+ * Task 中不能调用 KVWorker::Wait 等阻塞的接口，否则其它 Task 也无法继续。
+ */
+class Executor {
+ public:
+	Executor() = default;
+	Executor(const Executor&) = delete;
+	Executor& operator=(const Executor&) = delete;
+	~Executor() {
+		CHECK_EQ(active_, 0) << "executor destroyed with unfinished tasks";
+	}
+
+	/**
+	 * @brief 将 Task 交给执行器，在 Run 中开始执行。可以在 Task 中调用
+	 */
+	void Spawn(Task task) {
+		Task::Handle handle = std::exchange(task.handle_, {});
+		handle.promise().executor = this;
+		{
+			std::lock_guard<std::mutex> lk(mu_);
+			++active_;
+			ready_.push_back(handle);
+		}
+		cond_.notify_one();
+	}
+
+	/**
+	 * @brief 将挂起的协程放入就绪队列。可以在任意线程中调用
+	 */
+	void Post(Task::Handle handle) {
+		{
+			std::lock_guard<std::mutex> lk(mu_);
+			ready_.push_back(handle);
+		}
+		cond_.notify_one();
+	}
+
+	/**
+	 * @brief 运行所有 Task，直到它们都结束。Task 中未捕获的异常会在所在 Task 结束后从这里抛出
+	 */
+	void Run() {
+		std::unique_lock<std::mutex> lk(mu_);
+		while (active_ > 0) {
+			cond_.wait(lk, [this] { return !ready_.empty(); });
+			Task::Handle handle = ready_.front();
+			ready_.pop_front();
+			lk.unlock();
+			handle.resume();
+			bool done = handle.done();
+			std::exception_ptr exception;
+			if (done) {
+				exception = handle.promise().exception;
+				handle.destroy();
+			}
+			lk.lock();
+			if (done) {
+				--active_;
+			}
+			if (exception) {
+				std::rethrow_exception(exception);
+			}
+		}
+	}
+
+ private:
+	std::deque<Task::Handle> ready_;
+	/* 已 Spawn、还未结束的 Task 数 */
+	int active_{0};
+	std::mutex mu_;
+	std::condition_variable cond_;
+};
+
+/**
+ * @brief 发送一个请求、在请求完成时恢复协程的 awaitable，只能在 Task 中 co_await。
+ * @tparam Send 以完成时的回调为参数发送请求，保存在协程帧中
+ */
+template <typename Send>
+class RequestAwaiter {
+ public:
+	explicit RequestAwaiter(Send send) : send_(std::move(send)) {}
+
+	bool await_ready() const noexcept {
+		return false;
+	}
+	void await_suspend(Task::Handle handle) {
+		// 回调可能在 send_ 返回前运行（如请求没有发给任何 server），此时协程只是放入就绪队列，
+		// 要等本次 resume 返回后才会由 Run 恢复。回调只捕获两个指针，std::function 不需要分配内存
+		Executor* executor = handle.promise().executor;
+		send_([executor, handle]() { executor->Post(handle); });
+	}
+	void await_resume() const noexcept {}
+
+ private:
+	Send send_;
+};
+
+/**
+ * @brief 见 KVWorker::ZPush。co_await 在 push 完成后返回
+ */
+template <typename Value>
+auto AsyncZPush(KVWorker<Value>* kv, const SVector<Key>& keys, const SVector<Value>& vals,
+		const SVector<int>& lens = {}, int cmd = 0, int priority = 0) {
+	return RequestAwaiter([=](const typename KVWorker<Value>::Callback& cb) {
+		kv->ZPush(keys, vals, lens, cmd, cb, priority);
+	});
+}
+
+/**
+ * @brief 见 KVWorker::ZPull。co_await 在 vals 填好后返回
+ */
+template <typename Value>
+auto AsyncZPull(KVWorker<Value>* kv, const SVector<Key>& keys, SVector<Value>* vals,
+		SVector<int>* lens = nullptr, int cmd = 0, int priority = 0) {
+	return RequestAwaiter([=](const typename KVWorker<Value>::Callback& cb) {
+		kv->ZPull(keys, vals, lens, cmd, cb, priority);
+	});
+}
+
+/**
+ * @brief 见 KVWorker::ZPushPull。co_await 在 outs 填好后返回
+ */
+template <typename Value>
+auto AsyncZPushPull(KVWorker<Value>* kv, const SVector<Key>& keys, const SVector<Value>& vals,
+		SVector<Value>* outs, SVector<int>* lens = nullptr, int cmd = 0, int priority = 0) {
+	return RequestAwaiter([=](const typename KVWorker<Value>::Callback& cb) {
+		kv->ZPushPull(keys, vals, outs, lens, cmd, cb, priority);
+	});
+}
+
+/**
+ * @brief 使用已注册的一组 key（见 KVWorker::RegisterKeys）的 AsyncZPush
+ */
+template <typename Value>
+auto AsyncZPush(KVWorker<Value>* kv, KeyHandle handle, const SVector<Value>& vals, int cmd = 0, int priority = 0) {
+	return RequestAwaiter([=](const typename KVWorker<Value>::Callback& cb) {
+		kv->ZPush(handle, vals, cmd, cb, priority);
+	});
+}
+
+/**
+ * @brief 使用已注册的一组 key 的 AsyncZPull
+ */
+template <typename Value>
+auto AsyncZPull(KVWorker<Value>* kv, KeyHandle handle, SVector<Value>* vals, int cmd = 0, int priority = 0) {
+	return RequestAwaiter([=](const typename KVWorker<Value>::Callback& cb) {
+		kv->ZPull(handle, vals, cmd, cb, priority);
+	});
+}
+
+/**
+ * @brief 使用已注册的一组 key 的 AsyncZPushPull
+ */
+template <typename Value>
+auto AsyncZPushPull(KVWorker<Value>* kv, KeyHandle handle, const SVector<Value>& vals, SVector<Value>* outs,
+		int cmd = 0, int priority = 0) {
+	return RequestAwaiter([=](const typename KVWorker<Value>::Callback& cb) {
+		kv->ZPushPull(handle, vals, outs, cmd, cb, priority);
+	});
+}
+
+} // namespace ps
@@ -3,19 +3,140 @@
  * @brief 一个自定义的 App 示例，可用于简单的机器学习。
  */
 #pragma once
+#include <map>
+#include <memory>
+#include <set>
+#include <list>
+#include <cctype>
+#include <string>
+#include <cmath>
+#include <limits>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <tuple>
 #include <vector>
 #include <algorithm>
+#include <functional>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "../ps/Base.h"
 #include "../ps/Range.h"
 #include "../ps/SimpleApp.h"
+#include "../internal/Env.h"
 #include "../internal/Customer.h"
 #include "../internal/PostOffice.h"
+#include "../internal/Rebalancer.h"
+#include "../internal/FlowController.h"
 #include "../utility/SVector.h"
+#include "../utility/KeyCodec.h"
+#include "../utility/BufferPool.h"
+#include "../utility/Quantize.h"
 
 namespace ps {
 
+/**
+ * @brief 一致性模型。
+ * 每个 worker 在每个 server 上有一个时钟，即它向该 server 发送 push 的次数。
+ */
+enum ConsistencyModel: int {
+	/* 异步：请求直接交给 handle，handle 的回复立即发送 */
+	ASYNC,
+	/* 整体同步 (Bulk Synchronous Parallel)：同一时钟（轮）的所有 push 先合并（value 累加），
+	* 所有 worker 都推送后，用合并结果调用一次 handle，然后回复该轮所有 push */
+	BSP,
+	/* 延迟同步 (Stale Synchronous Parallel)：push 立即交给 handle，
+	* 但如果发送者的时钟比最慢的 worker 领先超过 staleness，则推迟对它的回复，直到最慢的 worker 跟上 */
+	SSP
+};
+inline const char* const ConsistencyModelName[] = {
+	"ASYNC", "BSP", "SSP"
+};
+
+/**
+ * @brief worker 将 key 划分到 server 的方式。所有 worker 需要使用相同的划分。
+ */
+enum Partition: int {
+	/* 按 key 区间划分：server i 负责 PostOffice::GetServerRanges()[i]。切片是请求的连续区间，不需要拷贝 */
+	RANGE_PARTITION,
+	/* 按 key 的哈希划分（见 HashPartition）：任意分布的 key 都能均匀地分到各 server，但切片需要拷贝 */
+	HASH_PARTITION,
+	/* 根据第一次切分的 key 选择：按区间划分时最多的 server 分到的 key 超过平均的 kAutoPartitionSkew 倍则使用哈希，否则使用区间。
+	* key 集中在小范围内（如从 0 开始的连续编号）时会选择哈希。各 worker 将自己的选择发给 server 0，
+	* 由它最先收到的选择（或最先收到的请求使用的划分）对所有 worker 生效 */
+	AUTO_PARTITION
+};
+inline const char* const PartitionName[] = {
+	"RANGE", "HASH", "AUTO"
+};
+
+/* AUTO_PARTITION 选择哈希划分的不均衡程度 */
+constexpr double kAutoPartitionSkew = 1.5;
+
+/**
+ * @brief worker 将一个请求的各部分发给 server 的顺序。所有 worker 同时发送请求时，按 rank 顺序发送会使它们都先发给 server 0，
+ * 造成 incast（多个发送者同时发往一个接收者）
+ */
+enum SendOrder: int {
+	/* 按 server 的 rank 顺序（默认） */
+	RANK_ORDER,
+	/* 从第 (worker rank % server 数) 个 server 开始循环，不同 worker 先发给不同的 server */
+	STAGGERED_ORDER,
+	/* 每个请求随机打乱 */
+	RANDOM_ORDER,
+	/* 按各 server 最近的回复中报告的接收队列长度（Meta::queue_depth）从小到大，相同时按 STAGGERED_ORDER */
+	ADAPTIVE_ORDER
+};
+inline const char* const SendOrderName[] = {
+	"RANK", "STAGGERED", "RANDOM", "ADAPTIVE"
+};
+
+/* 发送间隔按最多这么多个排队的消息计算 */
+constexpr int kMaxPacingDepth = 8;
+
+/**
+ * @brief key 的哈希值（splitmix64 的混合函数）
+ */
+inline uint64_t HashKey(Key key) {
+	uint64_t h = key + 0x9e3779b97f4a7c15ull;
+	h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+	h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+	return h ^ (h >> 31);
+}
+
+/**
+ * @brief 哈希划分中 key 所属的 server
+ */
+inline int HashPartition(Key key, int num_servers) {
+	return static_cast<int>(HashKey(key) % num_servers);
+}
+
+/**
+ * @brief 热点 key 副本相关的消息（Meta::replica），见 KVServer::SetHotKeyReplication
+ */
+enum ReplicaOp: int {
+	/* worker 对副本的访问：push 累加到副本的增量中，pull 返回副本的 value */
+	REPLICA_ACCESS,
+	/* 负责者将新的热点 key 及其 value 发给其它 server 保存为副本 */
+	REPLICA_INSTALL,
+	/* 副本所在的 server 向负责者合并增量、拉取最新的 value，由负责者的 handle 正常处理 */
+	REPLICA_SYNC
+};
+
+/* 复制热点 key 时，每个请求最多抽样的 key 数 */
+constexpr size_t kHotKeySamples = 32;
+/* 每抽样这么多次 key 判断一次热点 */
+constexpr size_t kHotKeyWindow = 1 << 14;
+/* server 在参数的一个版本内最多保存的共享 pull 回复数 */
+constexpr size_t kMaxSharedPulls = 64;
+/* 增量 pull 中 server 按哈希将 key 分为这么多块，记录每块最后改变时的参数版本 */
+constexpr size_t kDeltaBlocks = 1 << 18;
+
+template <typename Value>
+class ConsistencyController;
+
 // 均为默认实现
 
 /**
@@ -36,6 +157,24 @@ struct KVPairs {
 	int priority{0};
 };
 
+/**
+ * @brief 可以重复使用的请求，用于每轮的 key 与 value 形状不变的循环（见 KVWorker::Push(KVRequest*)）。
+ * 请求进行中不能修改其中的数据；完成后可以直接改写 vals、读取 outs，再次发送时不重新分配内存。
+ * @tparam Value 值类型
+ */
+template <typename Value>
+struct KVRequest {
+	/* key，必须唯一且升序排序 */
+	SVector<Key> keys;
+	/* push 的 value */
+	SVector<Value> vals;
+	/* pull 得到的 value。为空时在第一次 pull 时分配，之后复用 */
+	SVector<Value> outs;
+	/* 可选的 cmd */
+	int cmd{0};
+	int priority{0};
+};
+
 /**
  * @brief 一次请求 (push, pull, push_pull) 的元信息
  */
@@ -54,6 +193,212 @@ struct KVMeta {
 	int timestamp;
 	/* 相关 worker 的 customer_id */
 	int customer_id;
+	/* push 请求：发送者在当前 server 上的时钟（即包括本次在内，它推送的次数）。
+	* 仅在设置了一致性模型时有效，否则为 -1 */
+	int clock{-1};
+	/* 是否为 BSP 下合并一轮中所有 push 得到的请求。
+	* 此时 cmd、sender 等来自 rank 最小的 worker，对其调用 Response 会回复该轮所有被合并的请求 */
+	bool merged{false};
+	/* 请求使用的已注册 key 列表编号（见 KVWorker::RegisterKeys），未使用时为 -1。
+	* 无论是否使用，handle 收到的都是完整的 key */
+	int key_handle{-1};
+	/* pull 回复中 value 的传输编码，由 KVServer 在发送回复时处理（见 KVWorker::SetQuantization） */
+	quantize::Codec pull_codec{quantize::NONE};
+	/* worker 将较大的请求按 key 分为 num_chunks 块发送（见 KVWorker::SetChunkSize），这是第 chunk_id 块。
+	* 每块是一个独立的请求，包含 key 的一个连续区间，需要分别回复 */
+	int chunk_id{0};
+	int num_chunks{1};
+	/* 请求中的 key，即 handle 收到的 req_data.keys。
+	* pull 回复的 key 与其相同时（如 handle 的惯例 res.keys = req_data.keys），KVServer 不发送 key，
+	* worker 按发送时保存的切分放置 value */
+	SVector<Key> keys;
+	/* worker 是否接受省略 key 的回复 */
+	bool omit_keys{false};
+	/* worker 将 key 划分到 server 的方式，使用自定义 slicer 时为 -1 */
+	int partition{-1};
+	/* 热点 key 副本相关的请求（ReplicaOp），否则为 -1。
+	* REPLICA_SYNC 来自保存副本的 server，其 push 为多个 worker 推送的累加 */
+	int replica{-1};
+	/* 不为 0 时 push 不单独回复，完成后在之后的批量确认中回复（见 KVWorker::SetPushAck）。由 KVServer 处理，handle 照常调用 Response */
+	uint64_t ack_seq{0};
+	/* 回复可以被之后相同的 pull 共享（见 KVServer::SetPullSharing）时，为收到请求时参数的版本，否则为 -1 */
+	int shared_version{-1};
+	/* 开启增量 pull（见 KVServer::SetDeltaPull）时，pull 请求为收到请求时参数的版本，回复报告这个版本；否则为 -1 */
+	int pull_version{-1};
+	/* 增量 pull：keys 只包含 worker 缓存的版本之后可能改变的 key，回复总是带有 key */
+	bool delta{false};
+};
+
+/**
+ * @brief 将之后会被完整写入的缓冲区的大小设为 n。SVector 新增的元素不初始化（见 SVector::resize_uninitialized），
+ * 其它类型（如 std::vector）照常 resize
+ */
+template <typename C>
+void ResizeOutput(C* out, size_t n) {
+	if constexpr (requires { out->resize_uninitialized(n); }) {
+		out->resize_uninitialized(n);
+	} else {
+		out->resize(n);
+	}
+}
+
+/**
+ * @brief 内容未初始化的 size 字节的缓冲区。pool 不为 nullptr 时从中获取
+ */
+inline SVector<char> NewBuffer(size_t size, BufferPool* pool) {
+	if (pool) return pool->Get(size);
+	SVector<char> buf;
+	buf.resize_uninitialized(size);
+	return buf;
+}
+
+/**
+ * @brief 将 key 加入消息。encode 为 true 且编码后更小时，使用 KeyCodec 的差分编码。
+ * @param pool 编码缓冲区的内存池，可选
+ */
+inline void AddKeyData(Message* msg, const SVector<Key>& keys, bool encode, BufferPool* pool = nullptr) {
+	if (encode && keys.size() > 1) {
+		SVector<char> buf = NewBuffer(keycodec::MaxEncodedSize(keys.size()), pool);
+		size_t size = keycodec::Encode(keys.data(), keys.size(), buf.data());
+		if (size < keys.size() * sizeof(Key)) {
+			buf.resize_uninitialized(size);
+			msg->AddData(buf, ENCODED_KEY);
+			return;
+		}
+	}
+	msg->AddData(keys);
+}
+
+/**
+ * @brief 取出消息中的 key（data[0]），如果经过编码则解码。
+ */
+inline SVector<Key> GetKeyData(const Message& msg) {
+	if (msg.meta.data_type.empty() || msg.meta.data_type[0] != ENCODED_KEY) {
+		return SVector<Key>(msg.data[0]);
+	}
+	const SVector<char>& data = msg.data[0];
+	size_t n = 0;
+	CHECK(keycodec::DecodedSize(data.data(), data.size(), &n)) << "invalid encoded keys";
+	SVector<Key> keys;
+	keys.resize_uninitialized(n);
+	CHECK(keycodec::Decode(data.data(), data.size(), keys.data())) << "invalid encoded keys";
+	return keys;
+}
+
+/**
+ * @brief 消息中 key（data[0]）的数量，不需要解码
+ */
+inline size_t KeyDataCount(const Message& msg) {
+	const SVector<char>& data = msg.data[0];
+	if (msg.meta.data_type.empty() || msg.meta.data_type[0] != ENCODED_KEY) {
+		return data.size() / sizeof(Key);
+	}
+	size_t n = 0;
+	CHECK(keycodec::DecodedSize(data.data(), data.size(), &n)) << "invalid encoded keys";
+	return n;
+}
+
+/**
+ * @brief value 编码对应的消息数据类型
+ */
+inline DataType CodecDataType(quantize::Codec codec) {
+	static constexpr DataType kTypes[] = {OTHER, FLOAT16, BFLOAT16, QINT8};
+	return kTypes[codec];
+}
+
+/**
+ * @brief 将 value 加入消息。codec 不为 NONE 时先编码为低精度，只支持 float 与 double。
+ * @param seed INT8 随机舍入的种子
+ * @param pool 编码缓冲区的内存池，可选
+ */
+template <typename Value>
+void AddValData(Message* msg, const SVector<Value>& vals, quantize::Codec codec, uint32_t seed,
+		BufferPool* pool = nullptr) {
+	if constexpr (std::is_same_v<Value, float> || std::is_same_v<Value, double>) {
+		if (codec != quantize::NONE && !vals.empty()) {
+			SVector<char> buf = NewBuffer(quantize::EncodedSize(codec, vals.size()), pool);
+			quantize::Encode(codec, vals.data(), vals.size(), buf.data(), seed);
+			msg->AddData(buf, CodecDataType(codec));
+			return;
+		}
+	} else {
+		CHECK_EQ(codec, quantize::NONE) << "quantization only supports float and double values";
+	}
+	msg->AddData(vals);
+}
+
+/**
+ * @brief 消息中 value（data[1]）的编码
+ */
+inline quantize::Codec ValDataCodec(const Message& msg) {
+	DataType type = msg.meta.data_type.size() > 1 ? msg.meta.data_type[1] : OTHER;
+	return type == FLOAT16 ? quantize::FP16 : type == BFLOAT16 ? quantize::BF16 :
+			type == QINT8 ? quantize::INT8 : quantize::NONE;
+}
+
+/**
+ * @brief 消息中 value（data[1]）的数量
+ */
+template <typename Value>
+size_t ValDataCount(const Message& msg) {
+	quantize::Codec codec = ValDataCodec(msg);
+	const SVector<char>& data = msg.data[1];
+	if (codec == quantize::NONE) {
+		CHECK_EQ(data.size() % sizeof(Value), 0u) << "invalid values";
+		return data.size() / sizeof(Value);
+	}
+	size_t n = 0;
+	CHECK(quantize::DecodedCount(codec, data.data(), data.size(), &n)) << "invalid quantized values";
+	return n;
+}
+
+/**
+ * @brief 将消息中的 value（data[1]）解码或拷贝到 dst，dst 需要有 ValDataCount 个元素的空间。
+ */
+template <typename Value>
+void CopyValData(const Message& msg, Value* dst) {
+	quantize::Codec codec = ValDataCodec(msg);
+	const SVector<char>& data = msg.data[1];
+	if (codec == quantize::NONE) {
+		memcpy(dst, data.data(), data.size());
+		return;
+	}
+	if constexpr (std::is_same_v<Value, float> || std::is_same_v<Value, double>) {
+		quantize::Decode(codec, data.data(), ValDataCount<Value>(msg), dst);
+	} else {
+		LOG(FATAL) << "quantized values require float or double Value";
+	}
+}
+
+/**
+ * @brief 取出消息中的 value（data[1]），如果经过编码则解码。
+ */
+template <typename Value>
+SVector<Value> GetValData(const Message& msg) {
+	quantize::Codec codec = ValDataCodec(msg);
+	if (codec == quantize::NONE) {
+		return SVector<Value>(msg.data[1]);
+	}
+	if constexpr (std::is_same_v<Value, float> || std::is_same_v<Value, double>) {
+		SVector<Value> vals;
+		vals.resize_uninitialized(ValDataCount<Value>(msg));
+		CopyValData(msg, vals.data());
+		return vals;
+	} else {
+		LOG(FATAL) << "quantized values require float or double Value";
+		return SVector<Value>();
+	}
+}
+
+/**
+ * @brief KVWorker::RegisterKeys 返回的 key 列表编号。
+ * 构造函数是 explicit 的，以免 Pull({1}, &vals) 之类的调用被当作编号。
+ */
+struct KeyHandle {
+	KeyHandle() = default;
+	explicit KeyHandle(int id): id(id) {}
+	bool valid() const { return id >= 0; }
+	int id{-1};
 };
 
 /**
@@ -80,8 +425,35 @@ class KVWorker: public SimpleApp {
 	 */
 	explicit KVWorker(int app_id, int customer_id) : SimpleApp() {
 		using namespace std::placeholders;
-		slicer_ = std::bind(&KVWorker::DefaultSlicer, this, _1, _2, _3);
+		slicer_ = std::bind(&KVWorker::PartitionSlicer, this, _1, _2, _3);
 		customer_ = new Customer(app_id, customer_id, std::bind(&KVWorker::OnReceive, this, _1));
+		encode_keys_ = Environment::GetIntOrDefault("PS_KEY_ENCODING", 0) != 0;
+		if (const char* partition = Environment::Get("PS_KEY_PARTITION")) {
+			std::string name(partition);
+			std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+			auto it = std::find(std::begin(PartitionName), std::end(PartitionName), name);
+			CHECK(it != std::end(PartitionName)) << "unknown PS_KEY_PARTITION: " << partition;
+			partition_ = static_cast<Partition>(it - std::begin(PartitionName));
+		}
+		chunk_size_ = Environment::GetIntOrDefault("PS_CHUNK_SIZE", 0);
+		delta_pull_ = Environment::GetIntOrDefault("PS_DELTA_PULL", 0) != 0;
+		// 各节点使用不同的随机数，避免随机舍入的误差在 server 合并时相关
+		quantize_seed_ = std::random_device{}();
+		SetPushAck(Environment::GetIntOrDefault("PS_PUSH_ACK_INTERVAL", 0));
+		queue_depths_ = std::vector<std::atomic<int>>(PostOffice::Get()->num_servers());
+		clock_ticks_ = std::vector<std::atomic<bool>>(PostOffice::Get()->num_servers());
+		for (auto& tick: clock_ticks_) {
+			tick = true;
+		}
+		SendOrder order = RANK_ORDER;
+		if (const char* name = Environment::Get("PS_SEND_ORDER")) {
+			std::string upper(name);
+			std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+			auto it = std::find(std::begin(SendOrderName), std::end(SendOrderName), upper);
+			CHECK(it != std::end(SendOrderName)) << "unknown PS_SEND_ORDER: " << name;
+			order = static_cast<SendOrder>(it - std::begin(SendOrderName));
+		}
+		SetSendOrder(order, Environment::GetIntOrDefault("PS_SEND_PACING_US", 0));
 	}
 
 	virtual ~KVWorker() { delete customer_; customer_ = nullptr; }
@@ -115,11 +487,24 @@ class KVWorker: public SimpleApp {
 				int cmd = 0,
 				const Callback& cb = nullptr,
 				int priority = 0) {
-		// 此处通过 vector 构造 SVector 需要拷贝。如果想要零拷贝，用 SVector 做参数调用 ZPush
+		// 此处通过 vector 构造 SVector 需要拷贝。如果想要零拷贝，用 SVector 做参数调用 ZPush，或传入右值
 		return ZPush(
 				SVector<Key>(keys), SVector<Value>(vals), SVector<int>(lens), cmd, cb,
 				priority);
 	}
+	/**
+	 * @brief 同上，但接管 keys 与 vals 的数组，不拷贝。调用后它们为空
+	 */
+	int Push(std::vector<Key>&& keys,
+				std::vector<Value>&& vals,
+				std::vector<int> lens = {},
+				int cmd = 0,
+				const Callback& cb = nullptr,
+				int priority = 0) {
+		return ZPush(
+				SVector<Key>(std::move(keys)), SVector<Value>(std::move(vals)), SVector<int>(std::move(lens)), cmd, cb,
+				priority);
+	}
 
 	/**
 	 * @brief 从 server 拉取指定 key 的 value。
@@ -151,14 +536,19 @@ class KVWorker: public SimpleApp {
 				int cmd = 0,
 				const Callback& cb = nullptr,
 				int priority = 0) {
-		// 此处通过 vector 构造 SVector 需要拷贝。如果想要零拷贝，在外部构造 SVector，然后用 SVector 做参数调用 ZPush
-		SVector<Key> skeys(keys);
-		int ts = AddPullCB(skeys, vals, lens, cmd, cb);
-		Data kvs;
-		kvs.keys = skeys;
-		kvs.priority = priority;
-		Send(ts, false, true, cmd, kvs);
-		return ts;
+		// 此处通过 vector 构造 SVector 需要拷贝。如果想要零拷贝，在外部构造 SVector，然后用 SVector 做参数调用 ZPush，或传入右值
+		return PullTo(SVector<Key>(keys), vals, lens, cmd, cb, priority);
+	}
+	/**
+	 * @brief 同上，但接管 keys 的数组，不拷贝。调用后 keys 为空
+	 */
+	int Pull(std::vector<Key>&& keys,
+				std::vector<Value>* vals,
+				std::vector<int>* lens = nullptr,
+				int cmd = 0,
+				const Callback& cb = nullptr,
+				int priority = 0) {
+		return PullTo(SVector<Key>(std::move(keys)), vals, lens, cmd, cb, priority);
 	}
 
 	/**
@@ -192,24 +582,38 @@ class KVWorker: public SimpleApp {
 					int cmd = 0,
 					const Callback& cb = nullptr,
 					int priority = 0) {
-		CHECK_NOTNULL(outs);
-		if (outs->empty())
-			outs->resize(vals.size());
-		else
-			CHECK_EQ(vals.size(), outs->size());
+		return PushPullTo(SVector<Key>(keys), SVector<Value>(vals), outs, lens, cmd, cb, priority);
+	}
+	/**
+	 * @brief 同上，但接管 keys 与 vals 的数组，不拷贝。调用后它们为空
+	 */
+	int PushPull(std::vector<Key>&& keys,
+					std::vector<Value>&& vals,
+					std::vector<Value>* outs,
+					std::vector<int>* lens = nullptr,
+					int cmd = 0,
+					const Callback& cb = nullptr,
+					int priority = 0) {
+		return PushPullTo(SVector<Key>(std::move(keys)), SVector<Value>(std::move(vals)), outs, lens, cmd, cb, priority);
+	}
 
-		SVector<Key> skeys(keys);
-		SVector<Value> svals(vals);
-		auto souts = new SVector<Value>(outs->data(), outs->size());
-		SVector<int>* slens = lens ?
-				new SVector<int>(lens->data(), lens->size()) : nullptr;
-		int ts = ZPushPull(skeys, svals, souts, slens, cmd,
-				[this, cb, souts, slens]() {
-					delete souts;
-					delete slens;
-					if (cb) cb();
-				}, priority);
-		return ts;
+	/**
+	 * @brief 发送可重复使用的请求 req 中的 push，见 KVRequest
+	 */
+	int Push(KVRequest<Value>* req, const Callback& cb = nullptr) {
+		return ZPush(req->keys, req->vals, {}, req->cmd, cb, req->priority);
+	}
+	/**
+	 * @brief 拉取 req 中 key 的值到 req->outs，见 KVRequest
+	 */
+	int Pull(KVRequest<Value>* req, const Callback& cb = nullptr) {
+		return ZPull(req->keys, &req->outs, nullptr, req->cmd, cb, req->priority);
+	}
+	/**
+	 * @brief 推送 req->vals，然后拉取到 req->outs，见 KVRequest
+	 */
+	int PushPull(KVRequest<Value>* req, const Callback& cb = nullptr) {
+		return ZPushPull(req->keys, req->vals, &req->outs, nullptr, req->cmd, cb, req->priority);
 	}
 
 	/**
@@ -224,7 +628,53 @@ class KVWorker: public SimpleApp {
 	 *
 	 * @param timestamp 标识操作请求的时间戳（即 request_id）
 	 */
-	void Wait(int timestamp) { customer_->WaitRequest(timestamp); }
+	void Wait(int timestamp) {
+		FlushAcks(&timestamp, 1);
+		customer_->WaitRequest(timestamp);
+	}
+	/**
+	 * @brief 最多等待 timeout，返回操作是否已完成。timeout 为负数时不限制
+	 */
+	bool Wait(int timestamp, std::chrono::milliseconds timeout) {
+		FlushAcks(&timestamp, 1);
+		return customer_->WaitRequest(timestamp, timeout);
+	}
+
+	/**
+	 * @brief 操作是否已完成，不阻塞。可用于轮询
+	 */
+	bool IsDone(int timestamp) {
+		FlushAcks(&timestamp, 1);
+		return customer_->IsDone(timestamp);
+	}
+
+	/**
+	 * @brief 等待所有操作完成，最多等待 timeout（负数时不限制）。返回是否都已完成
+	 */
+	bool WaitAll(const std::vector<int>& timestamps, std::chrono::milliseconds timeout = std::chrono::milliseconds(-1)) {
+		FlushAcks(timestamps.data(), timestamps.size());
+		return customer_->WaitAll(timestamps, timeout);
+	}
+
+	/**
+	 * @brief 等待任意一个操作完成，最多等待 timeout（负数时不限制）。用于保持 N 个请求进行中，哪个先完成就处理哪个：
+	 * \code
+	 *	 std::vector<int> inflight;
+	 *	 for (...) {
+	 *		 if (inflight.size() == N) {
+	 *			 int i = w.WaitAny(inflight);
+	 *			 // 处理 inflight[i] 的结果 ...
+	 *			 inflight.erase(inflight.begin() + i);
+	 *		 }
+	 *		 inflight.push_back(w.Pull(keys, &vals));
+	 *	 }
+	 * \endcode
+	 * @return 已完成的操作在 timestamps 中的下标（有多个时为最小的），超时为 -1
+	 */
+	int WaitAny(const std::vector<int>& timestamps, std::chrono::milliseconds timeout = std::chrono::milliseconds(-1)) {
+		FlushAcks(timestamps.data(), timestamps.size());
+		return customer_->WaitAny(timestamps, timeout);
+	}
 
 	/**
 	 * @brief 向 server 推送数据，零拷贝。
@@ -259,12 +709,7 @@ class KVWorker: public SimpleApp {
 				int cmd = 0,
 				const Callback& cb = nullptr,
 				int priority = 0) {
-		int ts = AddPullCB(keys, vals, lens, cmd, cb);
-		Data kvs;
-		kvs.keys = keys;
-		kvs.priority = priority;
-		Send(ts, false, true, cmd, kvs);
-		return ts;
+		return PullTo(keys, vals, lens, cmd, cb, priority);
 	}
 
 	/**
@@ -290,6 +735,52 @@ class KVWorker: public SimpleApp {
 		return ts;
 	}
 
+	/**
+	 * @brief 注册一组 key，之后可以用返回的编号代替这组 key 调用 Push、Pull 等。
+	 * 切分只在注册时进行一次；每个 server 回复过一次使用该编号的请求后，会按 (worker, 编号) 保存自己负责的那部分 key，
+	 * 之后发给它的请求和它的回复都不再携带 key。server 的 handle 收到的仍是完整的 key。
+	 * 使用编号的请求不支持 lens。要求 slicer 切分出的每个切片是 keys 的有序子序列（默认 slicer 与哈希划分均满足）。
+	 * @param keys 键，必须唯一且升序排序
+	 */
+	KeyHandle RegisterKeys(const SVector<Key>& keys);
+	KeyHandle RegisterKeys(const std::vector<Key>& keys) {
+		return RegisterKeys(SVector<Key>(keys));
+	}
+
+	/**
+	 * @brief 推送已注册的一组 key 的值。见 Push。
+	 */
+	int Push(KeyHandle handle, const std::vector<Value>& vals,
+				int cmd = 0, const Callback& cb = nullptr, int priority = 0) {
+		return ZPush(handle, SVector<Value>(vals), cmd, cb, priority);
+	}
+	/**
+	 * @brief 拉取已注册的一组 key 的值。见 Pull。
+	 */
+	int Pull(KeyHandle handle, std::vector<Value>* vals,
+				int cmd = 0, const Callback& cb = nullptr, int priority = 0) {
+		return SendWithHandle(handle, false, true, SVector<Value>(), vals, cmd, cb, priority);
+	}
+	/**
+	 * @brief 推送然后拉取已注册的一组 key 的值。见 PushPull。
+	 */
+	int PushPull(KeyHandle handle, const std::vector<Value>& vals, std::vector<Value>* outs,
+					int cmd = 0, const Callback& cb = nullptr, int priority = 0) {
+		return SendWithHandle(handle, true, true, SVector<Value>(vals), outs, cmd, cb, priority);
+	}
+	int ZPush(KeyHandle handle, const SVector<Value>& vals,
+				int cmd = 0, const Callback& cb = nullptr, int priority = 0) {
+		return SendWithHandle(handle, true, false, vals, (SVector<Value>*)nullptr, cmd, cb, priority);
+	}
+	int ZPull(KeyHandle handle, SVector<Value>* vals,
+				int cmd = 0, const Callback& cb = nullptr, int priority = 0) {
+		return SendWithHandle(handle, false, true, SVector<Value>(), vals, cmd, cb, priority);
+	}
+	int ZPushPull(KeyHandle handle, const SVector<Value>& vals, SVector<Value>* outs,
+					int cmd = 0, const Callback& cb = nullptr, int priority = 0) {
+		return SendWithHandle(handle, true, true, vals, outs, cmd, cb, priority);
+	}
+
 	/* 切分结果。SlicedKVs[i] 的值为：(切分数据是否有属于 server[i] 的部分, 属于 server[i] 部分的数据) */
 	using SlicedKVs = std::vector<std::pair<bool, Data>>;
 	/**
@@ -304,74 +795,588 @@ class KVWorker: public SimpleApp {
 							SlicedKVs* sliced)>;
 
 	/**
-	 * @brief 设置一个自定义 slicer
+	 * @brief 设置一个自定义 slicer，代替 SetPartition 选择的划分
 	 */
 	void set_slicer(const Slicer& slicer) {
 		CHECK(static_cast<bool>(slicer));
 		slicer_ = slicer;
+		custom_slicer_ = true;
 	}
 
- private:
 	/**
-	 * @brief Pull 的内部实现。C/D 是模板以能同时接收 SVector 和 std::vector。
-	 * Pull 的 cb 相比 Push 还有其它逻辑：需要将切分后从不同 Server 收到的数据汇总、按 key 排序，
-	 * 然后才能依次放入 vals、lens
+	 * @brief 设置将 key 划分到 server 的方式（见 Partition），默认由环境变量 PS_KEY_PARTITION 决定（range、hash 或 auto），未设置时为 RANGE_PARTITION。
+	 * 需要在第一次请求前调用，且所有 worker 需要使用相同的划分：请求中带有划分方式，server 收到不一致的划分时报错。
+	 * AUTO_PARTITION 的第一次请求（或 RegisterKeys）会等待 server 0 确定划分，不能在回调中发送。
 	 */
-	template <typename C, typename D>
-	int AddPullCB(const SVector<Key>& keys, C* vals, D* lens,
-						int cmd, const Callback& cb);
+	void SetPartition(Partition partition) {
+		std::lock_guard<std::mutex> lk(partition_mu_);
+		partition_ = partition;
+	}
+
 	/**
-	 * @brief 为指定请求添加回调。
-	 * @param cb callback
-	 * @param timestamp 标识请求的时间戳
+	 * @brief 当前使用的划分。AUTO_PARTITION 在第一次请求前不确定，返回 AUTO_PARTITION
 	 */
-	void AddCallback(int timestamp, const Callback& cb) {
-		if (!cb) return;
-		std::lock_guard<std::mutex> lk(mu_);
-		callbacks_[timestamp] = cb;
+	Partition partition() {
+		std::lock_guard<std::mutex> lk(partition_mu_);
+		return partition_;
 	}
 
 	/**
-	 * @brief 运行并移除指定请求的回调。
-	 * @param timestamp 标识请求的时间戳
+	 * @brief 开启 pull 缓存：Pull/ZPull 的 key 列表与之前某次相同，且缓存的值足够新时，直接用本地缓存完成请求，不访问 server。
+	 * 新旧程度用两个界限衡量，都满足时才使用缓存，负数表示不限制：
+	 * - 版本：server 的版本为它已处理的 push 次数，随每个回复返回。缓存落后的版本数为
+	 *   相关 server 已知的最新版本减去缓存拉取时的版本，取最大值。
+	 *   本 worker 发送 push 时会立即将相关 server 的已知版本加一。
+	 * - 时间：缓存从发起拉取起经过的毫秒数。
+	 * 命中但缓存已经落后（版本落后，或时间超过 max_age_ms 的一半）时，在后台发起一次 pull 刷新缓存，不阻塞本次调用。
+	 * 不论上面的界限如何，本 worker push 的 key 所在的缓存都会失效，自己 push 后的 pull 一定访问 server。
+	 * 只缓存不带 lens、cmd 为 0 的 pull。
+	 * 命中时请求在 Pull/ZPull 返回前完成，回调在调用者的线程上同步执行（而不是在接收线程上），回调中不能获取调用者持有的锁。
+	 * @param max_versions 缓存最多落后的版本数
+	 * @param max_age_ms 缓存最多存在的毫秒数
+	 * @param capacity 最多缓存的 key 列表数量，超出时淘汰最久未使用的。为 0 时关闭缓存
 	 */
-	void RunCallback(int timestamp);
+	void SetCache(int max_versions, int max_age_ms = -1, size_t capacity = 16) {
+		std::lock_guard<std::mutex> lk(cache_mu_);
+		cache_max_versions_ = max_versions;
+		cache_max_age_ = std::chrono::milliseconds(max_age_ms);
+		known_versions_.resize(PostOffice::Get()->num_servers(), 0);
+		// 请求与接收的路径不加锁读取，最后设置，使它们看到非 0 时 known_versions_ 已经分配
+		cache_capacity_ = capacity;
+	}
+
 	/**
-	 * @brief 向所有 server 发送数据。
-	 * 数据会根据 slicer 进行切分，被发送到对应负责的 server 上。
-	 * @param timestamp 标识请求的时间戳
-	 * @param push 是否是 push 请求
-	 * @param pull 是否是 pull 请求
-	 * @param cmd command
+	 * @brief 刷新缓存（见 SetCache）时是否使用增量 pull：请求带上缓存的 value 对应的各 server 版本，
+	 * 开启了增量 pull 的 server（见 KVServer::SetDeltaPull）只回复此后改变过的 key，都没有改变时只回复未改变，
+	 * worker 将回复的 value 写入缓存的副本中。适合每次只更新少量参数的训练，pull 的流量与改变的 key 数成正比。
+	 * 区间表更新后的第一次刷新仍然拉取全部 value。默认由环境变量 PS_DELTA_PULL 决定
 	 */
-	void Send(int timestamp, bool push, bool pull, int cmd, const Data& kvs);
+	void SetDeltaPull(bool delta) {
+		std::lock_guard<std::mutex> lk(cache_mu_);
+		delta_pull_ = delta;
+	}
 
 	/**
-	 * @brief 接收到消息时执行的逻辑
+	 * @brief 是否对请求中的 key 做差分编码（见 utility/KeyCodec.h），只在编码后更小时生效。
+	 * 默认由环境变量 PS_KEY_ENCODING 决定。server 总能识别编码后的 key。
 	 */
-	void OnReceive(const Message& msg);
+	void SetKeyEncoding(bool encode) {
+		encode_keys_ = encode;
+	}
 
 	/**
-	 * @brief 默认的 slicer
+	 * @brief 将发给每个 server 的部分超过 bytes 字节的请求，按 key 均分为若干块，每块作为一个独立的请求依次发送。
+	 * server 对每块分别调用 handle 并回复，因此传输、server 的计算与 worker 接收回复可以重叠；所有块都回复后请求才完成。
+	 * 大小按 key 与 value 的字节数估计，pull 按每个 key 一个 value 估计回复的大小。使用已注册 key（RegisterKeys）的请求不分块。
+	 * 默认由环境变量 PS_CHUNK_SIZE 决定，为 0 时不分块。
 	 */
-	void DefaultSlicer(KVPairs<Value>& send,
-						const std::vector<Range>& ranges,
-						SlicedKVs* sliced);
+	void SetChunkSize(size_t bytes) {
+		chunk_size_ = bytes;
+	}
 
-	/* timestamp -> 对应 pull 请求已接收到的数据.
-	* 收到 pull 请求的回应时，将数据暂存到这里。
-	* 只有在收到的回复数量等于 num_servers 时，才可调用 callback，调用前的回复需先缓存 */
-	std::unordered_map<int, std::vector<KVPairs<Value>>> recv_kvs_;
-	/* timestamp -> 对应请求的回调.
-	* 每次请求的回调 */
-	std::unordered_map<int, Callback> callbacks_;
-	/* 其实可分为两个：callback mu 与 recv mu */
-	std::mutex mu_;
-	/* 数据使用的 slicer */
-	Slicer slicer_;
-};
+	/**
+	 * @brief 设置之后的请求中 value 的传输编码（见 utility/Quantize.h），只支持 float 与 double。
+	 * push 的 value 按 push_codec 编码后发送，server 解码后再交给 handle；
+	 * pull 的回复由 server 按 pull_codec 编码，收到后解码写入 vals。
+	 * 对每个请求在发送时生效，因此可以在两次请求之间切换，比如只量化梯度、pull 使用全精度。
+	 */
+	void SetQuantization(quantize::Codec push_codec, quantize::Codec pull_codec = quantize::NONE) {
+		if constexpr (!std::is_same_v<Value, float> && !std::is_same_v<Value, double>) {
+			CHECK(push_codec == quantize::NONE && pull_codec == quantize::NONE)
+					<< "quantization only supports float and double values";
+		}
+		push_codec_ = push_codec;
+		pull_codec_ = pull_codec;
+	}
 
-/**
+	/**
+	 * @brief 开启稀疏 push：每个 server 的切片只发送其中绝对值最大的一部分 key（一个 key 有多个 value 时按绝对值之和），
+	 * 即 key 的一个有序子集。未发送的 value 作为残差保存在本地，累加到之后对同一 key 的 push 上（error feedback），梯度不会丢失，只会推迟。
+	 * 一个 key 满足任一条件即发送：在切片中排在前 ceil(ratio * n) 个；threshold > 0 且绝对值不小于 threshold。
+	 * 每个非空切片至少发送一个 key，因此收到请求的 server 与不稀疏时相同，一致性模型的计数不受影响。
+	 * 只作用于不带 lens 的 Push/ZPush（PushPull 需要拉取完整的 key，不稀疏）。handle 收到的是 key 的子集；
+	 * 使用已注册的 key（RegisterKeys）时，KVServer 会将未发送的 value 补为 0，handle 仍收到完整的 key。
+	 * @param ratio 每个切片发送的 key 的比例，不小于 1 时全部发送
+	 * @param threshold 绝对值阈值，为 0 时不使用。ratio 与 threshold 都为 0 时关闭稀疏 push
+	 */
+	void SetSparsification(double ratio, double threshold = 0) {
+		CHECK_GE(ratio, 0);
+		CHECK_GE(threshold, 0);
+		std::lock_guard<std::mutex> lk(sparse_mu_);
+		sparse_ratio_ = ratio;
+		sparse_threshold_ = threshold;
+	}
+
+	/**
+	 * @brief 开启批量确认的 push：只 push 的请求（Push/ZPush）不需要 server 单独回复，server 处理后记下它的时间戳，
+	 * 在 worker 请求确认时一起回复，高频的异步 push 的消息数约减半。每发出 interval 个这样的 push，
+	 * 或 Wait 一个还未请求确认的 push 时，worker 向收到过它们的 server 各发送一个确认请求；
+	 * 这些 push 带有序号，server 在确认请求之前的 push 都已回复（handle 调用了 Response）后发送确认，一致性模型推迟的回复也会等待。
+	 * push 的完成（Wait 与回调）因此推迟到确认时，适合不等待每个 push 的异步训练。
+	 * 使用已注册 key 的 push 在 server 保存这组 key 之前仍需要回复。不能与区间负载均衡（PS_REBALANCE_INTERVAL）、
+	 * 流量控制（PS_MAX_INFLIGHT_BYTES、PS_MAX_INFLIGHT_REQUESTS）同时使用，同时开启时报错。
+	 * 默认由环境变量 PS_PUSH_ACK_INTERVAL 决定。
+	 * @param interval 为 0 时关闭，每个 push 都单独回复
+	 */
+	void SetPushAck(int interval) {
+		CHECK_GE(interval, 0);
+		CHECK(!interval || PostOffice::Get()->van()->rebalancer() == nullptr)
+				<< "batched push acknowledgement cannot be used with key range rebalancing";
+		// 未确认的 push 占用的额度只能由确认归还，而确认可能在等待因额度不足还未发出的 push
+		CHECK(!interval || PostOffice::Get()->van()->flow_controller() == nullptr)
+				<< "batched push acknowledgement cannot be used with flow control";
+		std::lock_guard<std::mutex> lk(ack_mu_);
+		if (!interval) {
+			RequestAcks();
+		}
+		push_ack_interval_ = interval;
+		unacked_servers_.resize(PostOffice::Get()->num_servers(), false);
+		ack_seqs_.resize(PostOffice::Get()->num_servers(), 0);
+	}
+
+	/**
+	 * @brief 设置请求的各部分发给 server 的顺序（见 SendOrder），默认由环境变量 PS_SEND_ORDER 决定，未设置时为 RANK_ORDER，其它顺序需要显式开启。
+	 * 分块发送时，发给同一个 server 的块仍然连续发送。
+	 * @param pacing_us 不为 0 时，发给下一个 server 之前等待 pacing_us 乘以它报告的接收队列长度（最多 kMaxPacingDepth）微秒，
+	 * 使忙碌的 server 晚一些收到请求。默认由环境变量 PS_SEND_PACING_US 决定
+	 */
+	void SetSendOrder(SendOrder order, int pacing_us = 0) {
+		CHECK_GE(pacing_us, 0);
+		send_order_ = order;
+		send_pacing_us_ = pacing_us;
+	}
+
+	/**
+	 * @brief 由缓存完成的 pull 数量。
+	 */
+	size_t cache_hits() {
+		std::lock_guard<std::mutex> lk(cache_mu_);
+		return cache_hits_;
+	}
+
+ private:
+	/**
+	 * @brief 发给一个 server 的切片（或其中一块）在请求的 key 中的位置
+	 */
+	struct PartPosition {
+		/* 第一个 key 在请求中的下标 */
+		size_t offset{0};
+		/* key 的数量 */
+		size_t size{0};
+		/* 切片不是请求的连续区间时（如哈希划分），每个 key 在请求中的下标；否则为空 */
+		std::vector<size_t> index;
+	};
+
+	/**
+	 * @brief 一组已注册的 key
+	 */
+	struct RegisteredKeys {
+		SVector<Key> keys;
+		/* server i 负责的 key 在 keys 中的位置 */
+		std::vector<PartPosition> parts;
+		/* server i 是否已经保存了它负责的 key（收到过它对使用该编号的请求的回复） */
+		std::vector<bool> acked;
+		/* 切分时区间表的版本 */
+		int range_version{0};
+	};
+
+	/**
+	 * @brief 按区间表切分注册的 key。区间表更新后（见 Rebalancer）需要重新切分，server 也需要重新保存 key。
+	 * 需要在持有 keys_mu_ 时调用。
+	 */
+	void SliceRegisteredKeys(RegisteredKeys* r, const std::vector<Range>& ranges, int range_version);
+
+	/**
+	 * @brief 使用已注册的 key 发送请求。
+	 * @param outs pull 时拉取的值保存到的位置，否则为 nullptr
+	 */
+	template <typename C>
+	int SendWithHandle(KeyHandle handle, bool push, bool pull, const SVector<Value>& vals, C* outs,
+						int cmd, const Callback& cb, int priority);
+
+	/**
+	 * @brief 按注册时的切分结果切分 kvs（kvs.keys 即注册的 key）
+	 */
+	void SliceWithHandle(const Data& kvs, int key_handle, SlicedKVs* sliced);
+
+	/**
+	 * @brief 将切片中已复制的热点 key（见 KVServer::SetHotKeyReplication）移出，按本节点的 rank 分散发给各 server 的副本：
+	 * server i 负责的热点 key 发给 server (i + rank) % n，使各 worker 对热点 key 的访问分散到所有 server
+	 * @param replicas replicas[i] 为发给 server i 的副本访问，没有时 keys 为空
+	 */
+	void SliceHotKeys(SlicedKVs* sliced, std::vector<Data>* replicas);
+
+	/**
+	 * @brief 保存 server 回复中告知的新复制的热点 key
+	 */
+	void AddHotKeys(const Message& msg);
+
+	/**
+	 * @brief 将发给一个 server 的切片按 chunk_size_ 分块（见 SetChunkSize）。不需要分块时返回只含 kvs 的列表
+	 */
+	std::vector<Data> SplitChunks(const Data& kvs) const;
+
+	/**
+	 * @brief 将残差累加到 push 的 value 上，返回新的 KVPairs（key 与 kvs 共享）。需要持有 sparse_mu_
+	 */
+	Data AddResidual(const Data& kvs);
+
+	/**
+	 * @brief 选出一个切片中要发送的 key（见 SetSparsification），在 sent 中标记（下标为 key 在 acc 中的位置）
+	 * @param slice acc 的一个切片
+	 * @return 要发送的部分
+	 */
+	static Data SelectTopK(const Data& acc, const Data& slice, double ratio, double threshold,
+							std::vector<bool>* sent);
+
+	/**
+	 * @brief 用 acc 中未发送的部分与其它 key 原有的残差更新残差。需要持有 sparse_mu_
+	 */
+	void UpdateResidual(const Data& acc, const std::vector<bool>& sent);
+
+	/**
+	 * @brief 一组 key 的缓存
+	 */
+	struct CacheEntry {
+		SVector<Key> keys;
+		/* keys 对应的注册编号，未注册时为 -1 */
+		int key_handle{-1};
+		std::vector<Value> vals;
+		/* 拉取时各 server 的版本。不负责这组 key 的 server 为 -1 */
+		std::vector<int> versions;
+		/* 拉取时区间表的版本。区间表更新后 versions 对应的 server 不再准确，需要重新拉取 */
+		int range_version{0};
+		/* 发起拉取的时间 */
+		std::chrono::steady_clock::time_point time;
+		/* vals 是否有效（第一次拉取完成前，或本 worker push 了其中的 key 之后无效） */
+		bool valid{false};
+		/* 正在进行的拉取发出后，本 worker push 了其中的 key，拉取的结果可能不包含这次 push，完成后仍然无效 */
+		bool stale{false};
+		/* 是否正在拉取。拉取的结果先保存在 fetching_* 中，完成时再与上面的交换 */
+		bool refreshing{false};
+		int fetching_ts{-1};
+		std::vector<Value> fetching_vals;
+		std::vector<int> fetching_versions;
+	};
+
+	/**
+	 * @brief Pull 与 ZPull 的实现，C/D 为 SVector 或 std::vector
+	 */
+	template <typename C, typename D>
+	int PullTo(const SVector<Key>& keys, C* vals, D* lens, int cmd, const Callback& cb, int priority) {
+		if (!lens && cmd == 0 && cache_capacity_) {
+			int ts = CachedPull(keys, vals, cb, priority);
+			if (ts != -1) return ts;
+		}
+		int ts = AddPullCB(keys, vals, lens, cmd, cb);
+		Data kvs;
+		kvs.keys = keys;
+		kvs.priority = priority;
+		Send(ts, false, true, cmd, kvs);
+		return ts;
+	}
+
+	/**
+	 * @brief PushPull 的实现。outs 与 lens 包装为不拥有数组的 SVector，完成后释放
+	 */
+	int PushPullTo(const SVector<Key>& keys, const SVector<Value>& vals, std::vector<Value>* outs,
+					std::vector<int>* lens, int cmd, const Callback& cb, int priority) {
+		CHECK_NOTNULL(outs);
+		if (outs->empty())
+			outs->resize(vals.size());
+		else
+			CHECK_EQ(vals.size(), outs->size());
+
+		auto souts = new SVector<Value>(outs->data(), outs->size());
+		SVector<int>* slens = lens ?
+				new SVector<int>(lens->data(), lens->size()) : nullptr;
+		int ts = ZPushPull(keys, vals, souts, slens, cmd,
+				[this, cb, souts, slens]() {
+					delete souts;
+					delete slens;
+					if (cb) cb();
+				}, priority);
+		return ts;
+	}
+
+	/**
+	 * @brief 尝试用缓存完成 pull。
+	 * 命中时直接完成请求；未命中时发起一次 pull 并用结果更新缓存。
+	 * @return 请求的时间戳。无法使用缓存（该组 key 正在刷新，或缓存已满且都在刷新）时返回 -1，由调用者正常 pull
+	 */
+	template <typename C>
+	int CachedPull(const SVector<Key>& keys, C* vals, const Callback& cb, int priority, int key_handle = -1);
+
+	/**
+	 * @brief 为缓存发起一次 pull，完成后更新缓存。需要在持有 cache_mu_ 时调用，且 entry 未在刷新。
+	 * 该函数会释放 lk 再发送请求（请求可能在发送时就完成，回调中需要加锁）。
+	 * @param out 非空时，完成后将值拷贝到这里，然后调用 cb
+	 */
+	template <typename C>
+	int RefreshCache(CacheEntry* entry, int priority, C* out, const Callback& cb,
+						std::unique_lock<std::mutex>& lk);
+
+	/**
+	 * @brief 本 worker push 了 keys，使包含其中任一 key 的缓存失效。需要在持有 cache_mu_ 时调用
+	 */
+	void InvalidateCache(const SVector<Key>& keys);
+
+	/**
+	 * @brief 缓存落后的版本数
+	 */
+	int CacheLag(const CacheEntry& entry) const {
+		int lag = 0;
+		for (size_t i = 0; i < entry.versions.size(); ++i) {
+			if (entry.versions[i] >= 0) {
+				lag = std::max(lag, known_versions_[i] - entry.versions[i]);
+			}
+		}
+		return lag;
+	}
+
+	/**
+	 * @brief 将缓存的值拷贝到 vals
+	 */
+	template <typename C>
+	static void CopyCachedVals(const std::vector<Value>& src, C* vals) {
+		CHECK_NOTNULL(vals);
+		if (vals->empty()) {
+			ResizeOutput(vals, src.size());
+		} else {
+			CHECK_EQ(vals->size(), src.size());
+		}
+		memcpy(vals->data(), src.data(), src.size() * sizeof(Value));
+	}
+
+	/**
+	 * @brief 求 part 在 keys 中的位置。part 需要是 keys 的有序子序列
+	 */
+	static PartPosition FindPart(const SVector<Key>& keys, const SVector<Key>& part);
+
+	/**
+	 * @brief 一个不带 lens 的 pull 的输出位置。每个 key 的 value 数量相同，因此每个回复在 vals 中的位置
+	 * 可以由它的 key 在请求中的下标得到，回复到达时直接写入，不需要暂存、排序与最后的合并。
+	 */
+	struct PullTarget {
+		/* 请求的 key */
+		SVector<Key> keys;
+		/* 返回输出缓冲区，参数为 value 的总数。调用者的 vals 为空时分配 */
+		std::function<Value*(size_t)> buffer;
+		/* 输出缓冲区，收到第一个回复后确定（增量 pull 在发送前确定为缓存的副本） */
+		Value* out{nullptr};
+		/* 每个 key 的 value 数量，与 out 同时确定 */
+		size_t k{0};
+		/* 已写入的 key 数量 */
+		size_t received{0};
+		/* parts[server rank][chunk] 为发给该 server 的各块在 keys 中的位置，在 Send 时确定 */
+		std::vector<std::vector<PartPosition>> parts;
+	};
+
+	/**
+	 * @brief 记录 pull 请求各部分在 keys 中的位置。chunks[i] 为发给 server i 的各块
+	 * @return 请求是否有 PullTarget（带 lens 的 pull 没有）
+	 */
+	bool SetPullOffsets(int timestamp, const SVector<Key>& keys, const std::vector<std::vector<Data>>& chunks);
+
+	/**
+	 * @brief 将 pull 的一个回复写入输出缓冲区中对应的位置。回复可以不带 key。只由接收线程调用
+	 */
+	void WritePullResponse(PullTarget* target, const Message& msg);
+
+	/**
+	 * @brief Pull 的内部实现。C/D 是模板以能同时接收 SVector 和 std::vector。
+	 * 不带 lens 时，回复到达后直接写入 vals（见 PullTarget）；
+	 * 带 lens 时 value 的位置取决于所有回复的 lens，需要将从不同 server 收到的数据汇总，
+	 * 先放入 lens，然后才能将 value 放入 vals
+	 */
+	template <typename C, typename D>
+	int AddPullCB(const SVector<Key>& keys, C* vals, D* lens,
+						int cmd, const Callback& cb);
+	/**
+	 * @brief 为指定请求添加回调。
+	 * @param cb callback
+	 * @param timestamp 标识请求的时间戳
+	 */
+	void AddCallback(int timestamp, const Callback& cb) {
+		if (!cb) return;
+		std::lock_guard<std::mutex> lk(mu_);
+		callbacks_[timestamp] = cb;
+	}
+
+	/**
+	 * @brief 运行并移除指定请求的回调。请求完成时调用，不带 lens 的 pull 同时移除它的 PullTarget。
+	 * @param timestamp 标识请求的时间戳
+	 */
+	void RunCallback(int timestamp);
+	/**
+	 * @brief 记录将要发出的不需要回复的 push，累计达到 push_ack_interval_ 个时请求确认
+	 * @param counts counts[i] 为发给 server i 的消息数
+	 * @return 发给各 server 的第一个消息的序号，不发送时为 0
+	 */
+	std::vector<uint64_t> AddUnackedPush(int timestamp, const std::vector<size_t>& counts);
+	/**
+	 * @brief 向收到过还未请求确认的 push 的 server 发送确认请求。需要持有 ack_mu_
+	 */
+	void RequestAcks();
+	/**
+	 * @brief 等待操作前调用：其中有还未请求确认的 push 时立即请求，否则要等到之后的 push 达到间隔
+	 */
+	void FlushAcks(const int* timestamps, size_t n) {
+		if (!push_ack_interval_) return;
+		std::lock_guard<std::mutex> lk(ack_mu_);
+		for (size_t i = 0; i < n; ++i) {
+			if (unacked_pushes_.count(timestamps[i])) {
+				RequestAcks(); return;
+			}
+		}
+	}
+	/**
+	 * @brief 收到 server 的批量确认，完成其中的 push
+	 */
+	void OnAcks(const Message& msg);
+	/**
+	 * @brief 向所有 server 发送数据。
+	 * 数据会根据 slicer 进行切分，被发送到对应负责的 server 上。
+	 * @param timestamp 标识请求的时间戳
+	 * @param push 是否是 push 请求
+	 * @param pull 是否是 pull 请求
+	 * @param cmd command
+	 * @param key_handle kvs.keys 的注册编号，未注册时为 -1
+	 * @param since 增量 pull（见 SetDeltaPull）：worker 已有的 value 对应的各 server 的版本，-1 表示没有。
+	 * 只在切分时的区间表版本为 since_range_version 时使用
+	 */
+	void Send(int timestamp, bool push, bool pull, int cmd, const Data& kvs, int key_handle = -1,
+			const std::vector<int>* since = nullptr, int since_range_version = 0);
+
+	/**
+	 * @brief 接收到消息时执行的逻辑
+	 */
+	void OnReceive(const Message& msg);
+
+	/**
+	 * @brief 默认的 slicer：按区间划分
+	 */
+	void DefaultSlicer(KVPairs<Value>& send,
+						const std::vector<Range>& ranges,
+						SlicedKVs* sliced);
+
+	/**
+	 * @brief 按哈希划分的 slicer。每个切片是 send 的一个有序子序列（拷贝）
+	 */
+	static void HashSlicer(KVPairs<Value>& send,
+							const std::vector<Range>& ranges,
+							SlicedKVs* sliced);
+
+	/**
+	 * @brief 按 send_order_ 计算请求发给 n 个 server 的顺序
+	 */
+	std::vector<size_t> ServerOrder(size_t n, int timestamp);
+
+	/**
+	 * @brief 按 partition_ 选择 DefaultSlicer 或 HashSlicer。划分仍为 AUTO_PARTITION 时按区间切分（见 ResolvePartition）
+	 */
+	void PartitionSlicer(KVPairs<Value>& send,
+							const std::vector<Range>& ranges,
+							SlicedKVs* sliced);
+
+	/**
+	 * @brief AUTO_PARTITION 的选择：按区间划分是否严重不均衡
+	 */
+	static Partition ChoosePartition(const SVector<Key>& keys, const std::vector<Range>& ranges);
+	/**
+	 * @brief 将本 worker 选择的划分发给 server 0，等待并返回所有 worker 使用的划分
+	 */
+	Partition AgreePartition(Partition proposal);
+	/**
+	 * @brief partition_ 为 AUTO_PARTITION 时根据 keys 确定划分。
+	 * 会等待 server 0 的回复，需要在不持有任何锁（包括 BeginRequest 的区间表读锁）时调用：
+	 * 区间表切换在接收线程上获取写锁，持锁等待回复会死锁
+	 */
+	void ResolvePartition(const SVector<Key>& keys);
+
+	/* timestamp -> 对应带 lens 的 pull 请求已接收到的数据.
+	* 收到 pull 请求的回应时，将数据暂存到这里。
+	* 只有在收到的回复数量等于 num_servers 时，才可调用 callback，调用前的回复需先缓存 */
+	std::unordered_map<int, std::vector<KVPairs<Value>>> recv_kvs_;
+	/* timestamp -> 对应不带 lens 的 pull 请求的输出位置。元素的地址在插入其它元素后不变 */
+	std::unordered_map<int, PullTarget> pull_targets_;
+	/* timestamp -> 对应请求的回调.
+	* 每次请求的回调 */
+	std::unordered_map<int, Callback> callbacks_;
+	/* 其实可分为两个：callback mu 与 recv mu */
+	std::mutex mu_;
+	/* 数据使用的 slicer */
+	Slicer slicer_;
+	/* 是否使用 set_slicer 设置的 slicer。此时请求中不带有划分方式 */
+	bool custom_slicer_{false};
+	/* 将 key 划分到 server 的方式，AUTO_PARTITION 在第一次切分时确定 */
+	Partition partition_{RANGE_PARTITION};
+	std::mutex partition_mu_;
+	/* server 0 回复的所有 worker 使用的划分，见 AgreePartition */
+	std::atomic<int> agreed_partition_{Meta::kEmpty};
+	/* 是否编码请求中的 key */
+	bool encode_keys_{false};
+	/* 发给每个 server 的部分超过该字节数时分块发送，为 0 时不分块 */
+	size_t chunk_size_{0};
+	/* push 的 value 与 pull 回复的 value 的编码 */
+	std::atomic<quantize::Codec> push_codec_{quantize::NONE};
+	std::atomic<quantize::Codec> pull_codec_{quantize::NONE};
+	/* INT8 随机舍入的种子，每条消息不同 */
+	std::atomic<uint32_t> quantize_seed_{0};
+
+	/* 稀疏 push 的参数，见 SetSparsification */
+	double sparse_ratio_{0};
+	double sparse_threshold_{0};
+	/* 稀疏 push 未发送的残差：升序的 key 与对应的 value，每个 key residual_k_ 个 value */
+	std::vector<Key> residual_keys_;
+	std::vector<Value> residual_vals_;
+	size_t residual_k_{0};
+	std::mutex sparse_mu_;
+
+	/* pull 缓存，越靠前越近使用过 */
+	std::list<CacheEntry> cache_;
+	/* 为缓存发起的 pull：timestamp -> 对应的缓存 */
+	std::unordered_map<int, CacheEntry*> cache_pulls_;
+	/* 已知的各 server 的最新版本 */
+	std::vector<int> known_versions_;
+	int cache_max_versions_{-1};
+	std::chrono::milliseconds cache_max_age_{-1};
+	/* 为 0 时不使用缓存。请求与接收的路径中不持有 cache_mu_ 先检查它 */
+	std::atomic<size_t> cache_capacity_{0};
+	size_t cache_hits_{0};
+	/* 刷新缓存时是否使用增量 pull，见 SetDeltaPull */
+	bool delta_pull_{false};
+	/* 保护以上缓存相关的状态 */
+	std::mutex cache_mu_;
+
+	/* 已注册的 key 列表，下标为编号 */
+	std::vector<RegisteredKeys> registered_keys_;
+	std::mutex keys_mu_;
+
+	/* 已复制到所有 server 的热点 key，升序 */
+	std::vector<Key> hot_keys_;
+	std::mutex hot_mu_;
+
+	/* 每发出多少个不需要回复的 push 请求一次确认，为 0 时不使用，见 SetPushAck */
+	std::atomic<int> push_ack_interval_{0};
+	/* 还未请求确认的 push 的时间戳，unacked_servers_[i] 表示 server i 收到过其中的 push */
+	std::unordered_set<int> unacked_pushes_;
+	std::vector<bool> unacked_servers_;
+	/* 发给各 server 的不需要回复的消息数，即最后一个的序号 */
+	std::vector<uint64_t> ack_seqs_;
+	std::mutex ack_mu_;
+
+	/* 发给 server 的顺序与间隔，见 SetSendOrder */
+	std::atomic<SendOrder> send_order_{RANK_ORDER};
+	std::atomic<int> send_pacing_us_{0};
+	/* 各 server 最近的回复中报告的接收队列长度 */
+	std::vector<std::atomic<int>> queue_depths_;
+	/* 各 server 是否需要时钟（见 Meta::tick）：push 没有发给它的 key 时仍然发送一个不带数据的 push。
+	* 在收到它对 push 的回复前不知道它的一致性模型，因此初始为 true */
+	std::vector<std::atomic<bool>> clock_ticks_;
+};
+
+/**
  * @brief 维护键值对的一个 server 节点。
  */
 template <typename Value>
@@ -384,9 +1389,33 @@ class KVServer : public SimpleApp {
 	explicit KVServer(int app_id) : SimpleApp() {
 		using namespace std::placeholders;
 		customer_ = new Customer(app_id, app_id, std::bind(&KVServer<Value>::OnReceive, this, _1));
+		encode_keys_ = Environment::GetIntOrDefault("PS_KEY_ENCODING", 0) != 0;
+		share_pulls_ = Environment::GetIntOrDefault("PS_SHARE_PULL", 0) != 0;
+		if (Environment::GetIntOrDefault("PS_DELTA_PULL", 0)) {
+			SetDeltaPull(true);
+		}
+		// 各节点使用不同的随机数，避免随机舍入的误差在 server 合并时相关
+		quantize_seed_ = std::random_device{}();
+		hot_rng_.seed(quantize_seed_);
+		hot_sync_interval_ = Environment::GetIntOrDefault("PS_HOT_KEY_SYNC_INTERVAL", 100);
+		if (int max_keys = Environment::GetInt("PS_HOT_KEYS"); max_keys > 0) {
+			SetHotKeyReplication(max_keys, Environment::GetIntOrDefault("PS_HOT_KEY_SHARE", 10) / 10000.,
+					hot_sync_interval_);
+		}
 	}
 
-	virtual ~KVServer() { delete customer_; customer_ = nullptr; }
+	virtual ~KVServer() {
+		if (sync_thread_) {
+			{
+				std::lock_guard<std::mutex> lk(hot_mu_);
+				sync_exit_ = true;
+			}
+			sync_cond_.notify_all();
+			sync_thread_->join();
+		}
+		delete customer_; customer_ = nullptr;
+		delete consistency_; consistency_ = nullptr;
+	}
 
 	/**
 	 * @brief 处理 worker 请求 (push, pull, push_pull) 的 handle
@@ -408,20 +1437,391 @@ class KVServer : public SimpleApp {
 	}
 
 	/**
-	 * @brief 回复 worker 请求
-	 * @param req_meta 本次请求的元信息
-	 * @param res 要发给 worker 的数据
+	 * @brief 回复 worker 请求
+	 * @param req_meta 本次请求的元信息
+	 * @param res 要发给 worker 的数据
+	 */
+	void Response(const KVMeta& req, const KVPairs<Value>& res = KVPairs<Value>());
+
+	/**
+	 * @brief 取得 n 个 value 的回复缓冲区（用作 Response 的 res.vals），内容未初始化。
+	 * 缓冲区来自本节点的内存池，回复发送完、传输层释放最后一个引用（如 ZMQ 的释放回调）后才归还，供之后的回复复用。
+	 * 因此 handle 不需要为每个 pull 分配内存，也不需要自己保存并复用回复的数据（那样可能改写仍在发送的回复）。
+	 * Value 不是平凡类型时直接分配
+	 */
+	SVector<Value> ResponseBuffer(size_t n) {
+		if constexpr (std::is_trivial_v<Value>) {
+			return response_pool_.Get<Value>(n);
+		} else {
+			return SVector<Value>(n);
+		}
+	}
+	/**
+	 * @brief 由内存池中缓存的内存满足的 ResponseBuffer 次数
+	 */
+	size_t response_pool_hits() const {
+		return response_pool_.hits();
+	}
+
+	/**
+	 * @brief 设置一致性模型（见 Consistency.h），默认为 ASYNC。
+	 * 需要在 worker 开始发送请求前调用。push 没有本节点的 key 时，worker 发送时钟（见 Meta::tick）代替它。
+	 * @param staleness SSP 中 worker 最多可以领先最慢的 worker 多少个时钟
+	 */
+	void SetConsistency(ConsistencyModel model, int staleness = 0);
+
+	/**
+	 * @brief BSP 下使用 num_backup 个备份 worker：每轮收到 NumWorkers() - num_backup 个推送后即更新并回复。
+	 * 需要先调用 SetConsistency(BSP)。
+	 * @param drop_late 丢弃迟到的推送；为 false 时将其合并到下一轮
+	 */
+	void SetBackupWorkers(int num_backup, bool drop_late = true);
+
+	/**
+	 * @brief 是否对回复中的 key 做差分编码，见 KVWorker::SetKeyEncoding。
+	 */
+	void SetKeyEncoding(bool encode) {
+		encode_keys_ = encode;
+	}
+
+	/**
+	 * @brief 是否共享相同的 pull 的回复。同步训练中每轮更新后所有 worker 拉取同样的参数，
+	 * 共享时参数的同一版本（两次 push 回复之间）内 key、cmd 与编码都相同的 pull 只调用一次 handle，
+	 * 回复的数据帧（包括编码后的 key 与 value）只生成一次，之后的请求直接发送同一份不可变的数据，只有 Meta 单独打包。
+	 * 要求 handle 对 pull 的回复只取决于 key、cmd 与参数，且参数只在回复 push 前改变（如 KVServerDefaultHandle），
+	 * 回复的 value 之后不能再被改写（如使用 ResponseBuffer）。不共享带 lens 的回复。也可以通过环境变量 PS_SHARE_PULL 设置
+	 */
+	void SetPullSharing(bool share) {
+		share_pulls_ = share;
+	}
+	/**
+	 * @brief 使用共享的回复、没有调用 handle 的 pull 数
+	 */
+	size_t shared_pulls() const {
+		return shared_pull_hits_;
+	}
+
+	/**
+	 * @brief 是否支持增量 pull（见 KVWorker::SetDeltaPull）。开启后 server 将 key 按哈希分为 kDeltaBlocks 块，
+	 * 回复 push 时记录其 key 所在块的新版本；带有 worker 缓存版本的 pull 只交给 handle 此后改变过的块中的 key，
+	 * 都没有改变时不调用 handle，直接回复未改变。块的版本只增不减，哈希冲突只会多回复一些没有改变的 key。
+	 * 要求参数只在回复 push 前改变（如 KVServerDefaultHandle），且 handle 对 pull 的回复不带 lens。
+	 * 需要在 worker 发送请求前调用，开启后一直记录块的版本。也可以通过环境变量 PS_DELTA_PULL 设置
+	 */
+	void SetDeltaPull(bool delta) {
+		if (delta && !block_versions_) {
+			// std::atomic 默认初始化为 0
+			block_versions_.reset(new std::atomic<int>[kDeltaBlocks]);
+		}
+		delta_pull_ = delta;
+	}
+	/**
+	 * @brief 增量 pull 中因没有改变而没有回复的 key 数
+	 */
+	size_t unchanged_keys() const {
+		return unchanged_keys_;
+	}
+
+	/**
+	 * @brief 导出参数：从存储中移除 range 内的所有 key，并将它们（升序）及其 value 保存到 out
+	 */
+	using ExportHandle = std::function<void(const Range& range, KVPairs<Value>* out)>;
+	/**
+	 * @brief 导入其它 server 导出的参数
+	 */
+	using ImportHandle = std::function<void(const KVPairs<Value>& kvs)>;
+
+	/**
+	 * @brief 设置迁移参数的 handle，使本节点参与区间负载均衡（见 Rebalancer，需要各节点设置 PS_REBALANCE_INTERVAL）。
+	 * 区间表更新时，不再属于本节点的参数经 export_handle 导出后发给新的负责者，由它的 import_handle 导入。
+	 * 两个 handle 与 request handle 在同一线程中调用，且调用时没有进行中的请求。只支持 ASYNC 一致性模型。
+	 */
+	void SetMigrationHandle(const ExportHandle& export_handle, const ImportHandle& import_handle);
+
+	/**
+	 * @brief 复制本节点负责的热点 key。统计 worker 请求中各 key 的访问（抽样），访问次数占本节点所有 key 访问
+	 * 不低于 min_share 的 key（最多共 max_keys 个）被复制到其它所有 server，之后 worker 按自己的 rank 将它们分散发给各个 server：
+	 * 副本直接回复 pull；push 的 value 累加起来，每 sync_interval_ms 毫秒作为一次 push 合并到本节点（交给 handle），
+	 * 同时拉取最新的 value。因此副本的 value 最多落后约 sync_interval_ms，push 的 value 需要可以累加（如梯度）。
+	 * 热点 key 复制后不再取消。只支持 ASYNC 一致性模型，不能与区间负载均衡（PS_REBALANCE_INTERVAL）同时使用；
+	 * 使用已注册 key、带 lens 的请求不经过副本。需要在 worker 开始发送请求前调用，也可以通过 PS_HOT_KEYS 等环境变量设置。
+	 * @param sync_interval_ms 本节点作为副本时合并的间隔
+	 */
+	void SetHotKeyReplication(size_t max_keys, double min_share = 0.001, int sync_interval_ms = 100);
+
+ private:
+	/**
+	 * @brief 接收到消息时执行的逻辑
+	 */
+	void OnReceive(const Message& msg);
+
+	/**
+	 * @brief 将回复发送给 worker。
+	 */
+	void SendResponse(const KVMeta& req, const KVPairs<Value>& res);
+
+	/**
+	 * @brief 记录一个 push 的块已回复，返回该 push 的所有块是否都已回复。未分块的 push 总是返回 true
+	 */
+	bool PushResponded(const KVMeta& req) {
+		if (req.num_chunks <= 1) return true;
+		std::lock_guard<std::mutex> lk(chunks_mu_);
+		auto id = std::make_tuple(req.sender, req.customer_id, req.timestamp);
+		auto it = pending_chunks_.try_emplace(id, req.num_chunks).first;
+		if (--it->second) return false;
+		pending_chunks_.erase(it);
+		return true;
+	}
+
+	/**
+	 * @brief 参数的一个版本内可以共享的 pull 回复，见 SetPullSharing
+	 */
+	struct SharedPull {
+		/* 请求的 key、cmd 与 value 的编码 */
+		SVector<Key> keys;
+		int cmd;
+		quantize::Codec codec;
+		/* handle 回复的 key，及其是否与请求的 key 相同（相同时 worker 可以省略） */
+		SVector<Key> res_keys;
+		bool same_keys{false};
+		/* 不省略 key 时的 key 帧，第一次需要时生成 */
+		SVector<char> key_frame;
+		DataType key_type{OTHER};
+		bool has_key_frame{false};
+		/* value 帧 */
+		SVector<char> val_frame;
+		DataType val_type{OTHER};
+	};
+	/**
+	 * @brief 当前版本下与 req 相同的请求的共享回复，没有时为 nullptr。版本改变时清空之前的回复。需要持有 shared_mu_
+	 */
+	SharedPull* FindSharedPull(const KVMeta& req, const SVector<Key>& keys);
+	/**
+	 * @brief 将共享回复的数据帧加入 msg，需要时生成 key 帧。需要持有 shared_mu_
+	 */
+	void AddSharedData(SharedPull* shared, bool omit_keys, Message* msg);
+	/**
+	 * @brief 用共享的回复回复 pull，不调用 handle。没有可以共享的回复时返回 false
+	 */
+	bool RespondShared(const KVMeta& req);
+	/**
+	 * @brief 增量 pull 中 key 所在的块
+	 */
+	static size_t DeltaBlock(Key key) {
+		return HashKey(key) % kDeltaBlocks;
+	}
+	/**
+	 * @brief 记录 keys 所在的块在下一个版本中改变。在参数改变后、版本增加前调用，
+	 * 使在此之前收到的 pull（报告的版本较小）之后的增量 pull 都会重新拉取它们
+	 */
+	void MarkChanged(const SVector<Key>& keys);
+	/**
+	 * @brief 增量 pull：只保留 data 中在版本 since 之后改变过的 key。都没有改变时直接回复未改变并返回 false
+	 */
+	bool SelectChanged(int since, KVMeta* meta, KVPairs<Value>* data);
+	/**
+	 * @brief 生成回复 msg 的元信息
+	 */
+	void InitResponse(const KVMeta& req, Message* msg);
+
+	/**
+	 * @brief 一个 worker（customer）的批量确认的状态，见 KVWorker::SetPushAck
+	 */
+	struct PushAcks {
+		/* 序号不超过该值的不需要回复的 push 消息（分块时每块一个）都已回复 */
+		uint64_t responded{0};
+		/* 已回复、序号在 responded + 1 之后的消息 */
+		std::set<uint64_t> out_of_order;
+		/* 已回复、还未确认的 push 的时间戳 */
+		std::vector<int> done;
+		/* 等待发送的确认：(时间戳, 需要已回复的序号) */
+		std::vector<std::pair<int, uint64_t>> requests;
+	};
+	/**
+	 * @brief 发送已满足的确认，第一个确认带有 done 中的时间戳。需要持有 ack_mu_
+	 */
+	void SendAcks(int worker, int customer_id, PushAcks* acks);
+
+	/**
+	 * @brief 将 keys 的一个有序子集 sub 及其 value 展开为 keys 的 value，其余补 0
+	 */
+	static SVector<Value> Densify(const SVector<Key>& keys, const SVector<Key>& sub, const SVector<Value>& vals) {
+		size_t k = sub.empty() ? 0 : vals.size() / sub.size();
+		SVector<Value> out(keys.size() * k, Value());
+		size_t pos = 0;
+		for (size_t i = 0; i < sub.size(); ++i) {
+			pos = std::lower_bound(keys.begin() + pos, keys.end(), sub[i]) - keys.begin();
+			CHECK(pos < keys.size() && keys[pos] == sub[i]) << "sparse push key " << sub[i] << " is not registered";
+			memcpy(out.data() + pos * k, vals.data() + i * k, k * sizeof(Value));
+		}
+		return out;
+	}
+
+	/**
+	 * @brief 处理区间表更新：导出不再属于本节点的参数发给新的负责者，导入其它 server 发来的参数
+	 */
+	void Migrate(const Message& msg);
+
+	/**
+	 * @brief 抽样统计一个请求中的 key。每 kHotKeyWindow 次抽样选出新的热点 key 并开始复制
+	 */
+	void SampleHotKeys(const SVector<Key>& keys);
+	/**
+	 * @brief 复制本节点负责的 keys：通过 handle 拉取它们的 value（见 Response），再发给其它 server
+	 */
+	void ReplicateHotKeys(const SVector<Key>& keys);
+	/**
+	 * @brief 将复制时拉取到的 value 发给其它 server（REPLICA_INSTALL）
+	 */
+	void InstallReplicas(const KVPairs<Value>& res);
+	/**
+	 * @brief 处理 REPLICA_ACCESS 与 REPLICA_INSTALL 请求，不经过 handle
+	 */
+	void OnReplicaRequest(const KVMeta& meta, const KVPairs<Value>& data);
+	/**
+	 * @brief 处理本节点发出的 REPLICA_INSTALL 与 REPLICA_SYNC 的回复
+	 */
+	void OnReplicaResponse(const Message& msg);
+	/**
+	 * @brief 每 hot_sync_interval_ 毫秒将副本的增量合并到负责者，并拉取最新的 value
+	 */
+	void SyncThread();
+
+	/**
+	 * @brief 检查各 worker 使用相同的划分，且请求的 key 属于本节点（只检查第一个 key）
+	 * @param range_version 请求切分时区间表的版本，按区间划分时需要与本节点的相同
+	 */
+	void CheckPartition(int partition, int range_version, const SVector<Key>& keys) {
+		int expected = Meta::kEmpty;
+		if (!partition_.compare_exchange_strong(expected, partition)) {
+			CHECK_EQ(expected, partition) << "workers use different key partitions ("
+					<< PartitionName[expected] << " and " << PartitionName[partition] << "), set PS_KEY_PARTITION";
+		}
+		if (keys.empty()) return;
+		int rank = PostOffice::Get()->my_rank();
+		Key key = keys.front();
+		bool mine;
+		if (partition == HASH_PARTITION) {
+			mine = HashPartition(key, PostOffice::Get()->num_servers()) == rank;
+		} else {
+			int version;
+			Range range = PostOffice::Get()->GetServerRanges(&version)[rank];
+			CHECK_EQ(range_version, version) << "request is sliced with key ranges version " << range_version;
+			mine = range.begin <= key && key < range.end;
+		}
+		CHECK(mine) << "key " << key << " does not belong to server " << rank
+				<< " under " << PartitionName[partition] << " partition";
+	}
+
+	/**
+	 * @brief server 0：以最先收到的选择（或最先收到的请求使用的划分）作为所有 worker 的划分，回复给发送者
+	 */
+	void AgreePartition(const Message& req) {
+		int expected = Meta::kEmpty;
+		partition_.compare_exchange_strong(expected, req.meta.partition);
+		Message msg;
+		msg.meta.app_id = customer_->app_id();
+		msg.meta.customer_id = req.meta.customer_id;
+		msg.meta.request	 = false;
+		msg.meta.timestamp	 = req.meta.timestamp;
+		msg.meta.receiver	 = req.meta.sender;
+		msg.meta.partition	 = partition_;
+		msg.meta.queue_depth = customer_->queue_depth();
+		PostOffice::Get()->van()->Send(msg);
+	}
+
+	/**
+	 * @brief worker 节点中的一个 customer（节点 ID, customer_id）。同一进程中的多个 KVWorker 节点 ID 相同
 	 */
-	void Response(const KVMeta& req, const KVPairs<Value>& res = KVPairs<Value>());
+	static uint64_t CustomerID(int sender, int customer_id) {
+		return (static_cast<uint64_t>(sender) << 32) | static_cast<uint32_t>(customer_id);
+	}
+	/* (worker 节点 ID, customer_id, 编号)。KVServer 只收到与自己 app_id 相同的请求，不需要区分 app_id */
+	using RegisteredKeyID = std::tuple<int, int, int>;
+
+	/* 处理请求的 handle */
+	ReqHandle request_handle_;
+	/* 一致性控制。ASYNC 时为 nullptr */
+	ConsistencyController<Value>* consistency_{nullptr};
+	/* 参数的版本，即已处理的 push 次数（BSP 下一轮合并的 push 只算一次）。随每个回复发给 worker */
+	std::atomic<int> version_{0};
+	/* 分块的 push 还未回复的块数，所有块都回复后版本才加一。块可能被乱序回复，因此按
+	 * (worker 节点 ID, customer_id, 时间戳) 记录，见 PushResponded */
+	std::map<std::tuple<int, int, int>, int> pending_chunks_;
+	std::mutex chunks_mu_;
+	/* 各 worker 注册的 key 列表中由本节点负责的部分。每个 KVWorker 的编号都从 0 开始，需要区分同一节点中的 customer */
+	std::map<RegisteredKeyID, SVector<Key>> registered_keys_;
+	std::mutex keys_mu_;
+	/* 是否编码回复中的 key */
+	bool encode_keys_{false};
+	/* INT8 随机舍入的种子，每条消息不同 */
+	std::atomic<uint32_t> quantize_seed_{0};
+	/* 回复缓冲区的内存池，见 ResponseBuffer */
+	BufferPool response_pool_;
+	/* 是否共享 pull 的回复，见 SetPullSharing */
+	std::atomic<bool> share_pulls_{false};
+	/* 参数版本 shared_version_ 下的共享回复 */
+	std::vector<SharedPull> shared_pulls_;
+	int shared_version_{0};
+	std::mutex shared_mu_;
+	std::atomic<size_t> shared_pull_hits_{0};
+	/* 是否回复增量 pull，见 SetDeltaPull */
+	std::atomic<bool> delta_pull_{false};
+	/* 每块 key 最后改变时的参数版本（改变所在的 push 回复后的版本），第一次开启增量 pull 时分配 */
+	std::unique_ptr<std::atomic<int>[]> block_versions_;
+	std::atomic<size_t> unchanged_keys_{0};
+	/* worker 使用的划分，收到第一个带有划分的请求时确定 */
+	std::atomic<int> partition_{Meta::kEmpty};
+	/* 迁移参数的 handle */
+	ExportHandle export_handle_;
+	ImportHandle import_handle_;
+	/* 已导出参数的区间表版本 */
+	int migrated_version_{0};
+	/* 区间表版本 -> 已收到其它 server 发来的参数的次数 */
+	std::unordered_map<int, int> imports_;
 
- private:
 	/**
-	 * @brief 接收到消息时执行的逻辑
+	 * @brief 本节点保存的其它 server 的热点 key 的副本
 	 */
-	void OnReceive(const Message& msg);
+	struct Replica {
+		/* 负责者的 rank */
+		int owner;
+		/* 上次从负责者拉取的 value */
+		std::vector<Value> vals;
+		/* 还未合并到负责者的 push 的累加 */
+		std::vector<Value> delta;
+		bool dirty{false};
+	};
 
-	/* 处理请求的 handle */
-	ReqHandle request_handle_;
+	/* 热点 key 的复制，见 SetHotKeyReplication。为 0 时不统计 */
+	size_t hot_max_keys_{0};
+	double hot_min_share_{0};
+	int hot_sync_interval_{100};
+	/* 以下由 hot_mu_ 保护 */
+	/* 当前窗口中各 key 的访问次数（按抽样估计）、所有 key 的访问次数与抽样次数 */
+	std::unordered_map<Key, double> hot_counts_;
+	double hot_total_{0};
+	size_t hot_samples_{0};
+	std::mt19937 hot_rng_;
+	/* 已选出的热点 key（包括正在复制的） */
+	std::unordered_set<Key> hot_set_;
+	/* 已复制（其它 server 都已保存）的热点 key，按复制的顺序，随回复告知 worker */
+	std::vector<Key> hot_keys_;
+	/* 正在复制：REPLICA_INSTALL 的时间戳 -> (key, 还需要的确认数) */
+	std::unordered_map<int, std::pair<SVector<Key>, int>> installing_;
+	/* (worker, customer) -> 已告知它的热点 key 数量，即 hot_keys_ 的前缀长度 */
+	std::unordered_map<uint64_t, size_t> hot_told_;
+	/* 其它 server 的热点 key 的副本 */
+	std::unordered_map<Key, Replica> replicas_;
+	std::mutex hot_mu_;
+	/* 合并副本的线程，收到第一个副本时启动 */
+	std::unique_ptr<std::thread> sync_thread_;
+	bool sync_exit_{false};
+	std::condition_variable sync_cond_;
+
+	/* (worker, customer) -> 批量确认的状态 */
+	std::unordered_map<uint64_t, PushAcks> push_acks_;
+	std::mutex ack_mu_;
 };
 
 
@@ -441,7 +1841,7 @@ struct KVServerDefaultHandle {
 			CHECK_EQ(n, req_data.vals.size());
 		} else {
 			res.keys = req_data.keys;
-			res.vals.resize(n);
+			res.vals = server->ResponseBuffer(n);
 		}
 		for (size_t i = 0; i < n; ++i) {
 			Key key = req_data.keys[i];
@@ -454,6 +1854,38 @@ struct KVServerDefaultHandle {
 		}
 		server->Response(req_meta, res);
 	}
+
+	/**
+	 * @brief 导出 range 内的参数并从 store 中移除，见 KVServer::SetMigrationHandle
+	 */
+	void Export(const Range& range, KVPairs<Value>* out) {
+		std::vector<std::pair<Key, Value>> kvs;
+		for (auto it = store.begin(); it != store.end();) {
+			if (range.begin <= it->first && it->first < range.end) {
+				kvs.emplace_back(*it);
+				it = store.erase(it);
+			} else {
+				++it;
+			}
+		}
+		std::sort(kvs.begin(), kvs.end());
+		out->keys.resize(kvs.size());
+		out->vals.resize(kvs.size());
+		for (size_t i = 0; i < kvs.size(); ++i) {
+			out->keys[i] = kvs[i].first;
+			out->vals[i] = kvs[i].second;
+		}
+	}
+	/**
+	 * @brief 导入其它 server 导出的参数
+	 */
+	void Import(const KVPairs<Value>& kvs) {
+		CHECK_EQ(kvs.keys.size(), kvs.vals.size());
+		for (size_t i = 0; i < kvs.keys.size(); ++i) {
+			store[kvs.keys[i]] = kvs.vals[i];
+		}
+	}
+
 	std::unordered_map<Key, Value> store;
 };
 
@@ -464,6 +1896,41 @@ void KVServer<Value>::OnReceive(const Message& msg) {
 	if (msg.meta.simple_app) {
 		SimpleApp::OnReceive(msg); return;
 	}
+	if (!msg.meta.control.IsEmpty()) {
+		// Rebalancer 转发的区间表更新
+		Migrate(msg); return;
+	}
+	if (!msg.meta.request) {
+		// 本节点复制、同步热点 key 时发出的请求的回复
+		OnReplicaResponse(msg); return;
+	}
+	if (msg.meta.ack_seq && !msg.meta.push) {
+		// worker 请求确认之前的 push，等它们都回复后发送
+		std::lock_guard<std::mutex> lk(ack_mu_);
+		auto& acks = push_acks_[CustomerID(msg.meta.sender, msg.meta.customer_id)];
+		acks.requests.emplace_back(msg.meta.timestamp, msg.meta.ack_seq);
+		SendAcks(msg.meta.sender, msg.meta.customer_id, &acks);
+		return;
+	}
+	if (!msg.meta.push && !msg.meta.pull && msg.meta.partition != Meta::kEmpty) {
+		// worker 使用 AUTO_PARTITION 时的选择（见 KVWorker::AgreePartition），只发给 server 0
+		AgreePartition(msg); return;
+	}
+	if (msg.meta.tick) {
+		// worker 的这次 push 没有发给本节点的 key，只推进它的时钟
+		if (consistency_) {
+			consistency_->OnTick(msg.meta.sender);
+		}
+		KVMeta meta;
+		meta.cmd	= msg.meta.head;
+		meta.push	= true;
+		meta.pull	= false;
+		meta.sender	= msg.meta.sender;
+		meta.timestamp = msg.meta.timestamp;
+		meta.customer_id = msg.meta.customer_id;
+		SendResponse(meta, KVPairs<Value>());
+		return;
+	}
 	// 提取 Message 里的内容转成本地处理的 KVMeta 和 KVPairs
 	KVMeta meta;
 	meta.cmd	= msg.meta.head;
@@ -472,26 +1939,493 @@ void KVServer<Value>::OnReceive(const Message& msg) {
 	meta.sender	= msg.meta.sender;
 	meta.timestamp = msg.meta.timestamp;
 	meta.customer_id = msg.meta.customer_id;
+	meta.key_handle = msg.meta.key_handle;
+	meta.pull_codec = static_cast<quantize::Codec>(msg.meta.pull_codec);
+	meta.chunk_id = msg.meta.chunk_id;
+	meta.num_chunks = msg.meta.num_chunks;
+	meta.replica = msg.meta.replica;
+	meta.ack_seq = msg.meta.ack_seq;
 	KVPairs<Value> data;
 	int n = msg.data.size();
 	if (n) {
 		CHECK_GE(n, 2);
-		data.keys = msg.data[0];
-		data.vals = msg.data[1];
+		data.keys = GetKeyData(msg);
+		data.vals = GetValData<Value>(msg);
+		if (msg.meta.partition != Meta::kEmpty && meta.replica != REPLICA_ACCESS) {
+			CheckPartition(msg.meta.partition, msg.meta.range_version, data.keys);
+		}
+		if (meta.key_handle != Meta::kEmpty) {
+			// 第一次使用某个编号的请求带有 key，保存下来；之后的请求只有编号
+			std::lock_guard<std::mutex> lk(keys_mu_);
+			RegisteredKeyID id{meta.sender, meta.customer_id, meta.key_handle};
+			if (data.keys.empty() || msg.meta.sparse) {
+				auto it = registered_keys_.find(id);
+				CHECK(it != registered_keys_.end())
+						<< "unknown key handle " << meta.key_handle << " from node " << meta.sender
+						<< ", customer " << meta.customer_id;
+				if (msg.meta.sparse) {
+					// 稀疏 push 只带有部分 key，将其余 value 补为 0，使 handle 收到完整的 key
+					data.vals = Densify(it->second, data.keys, data.vals);
+				}
+				data.keys = it->second;
+			} else {
+				registered_keys_[id] = data.keys;
+			}
+		}
 		if (n > 2) {
 			CHECK_EQ(n, 3);
 			data.lens = msg.data[2];
 			CHECK_EQ(data.lens.size(), data.keys.size());
 		}
+		Rebalancer* rebalancer = PostOffice::Get()->van()->rebalancer();
+		if (rebalancer && export_handle_ && !consistency_ && msg.meta.partition == RANGE_PARTITION) {
+			rebalancer->RecordLoad(data.keys.data(), data.keys.size());
+		}
+	}
+	meta.keys = data.keys;
+	meta.omit_keys = msg.meta.omit_keys;
+	if (meta.replica == REPLICA_ACCESS || meta.replica == REPLICA_INSTALL) {
+		OnReplicaRequest(meta, data); return;
+	}
+	if (hot_max_keys_ && meta.replica == -1 && meta.key_handle == Meta::kEmpty && data.lens.empty() && !consistency_) {
+		SampleHotKeys(data.keys);
+	}
+	if (block_versions_ && meta.pull && !meta.push && meta.replica == -1 && data.lens.empty()) {
+		// 在调用 handle 前记录版本：之后改变的 key 所在块的版本都大于它，基于这次回复的增量 pull 会重新拉取它们
+		meta.pull_version = version_;
+		if (delta_pull_ && msg.meta.since_version != Meta::kEmpty && !data.keys.empty() &&
+				!SelectChanged(msg.meta.since_version, &meta, &data)) {
+			return;
+		}
+	}
+	if (share_pulls_ && meta.pull && !meta.push && !meta.delta && meta.replica == -1 && !data.keys.empty() &&
+			data.lens.empty()) {
+		// 只读的 pull 不经过一致性控制，可以直接回复
+		if (RespondShared(meta)) return;
+		meta.shared_version = version_;
 	}
 	CHECK(static_cast<bool>(request_handle_));
-	request_handle_(meta, data, this);
+	if (consistency_) {
+		consistency_->OnRequest(meta, data);
+	} else {
+		request_handle_(meta, data, this);
+	}
 }
 
 template <typename Value>
 void KVServer<Value>::Response(const KVMeta& req, const KVPairs<Value>& res) {
+	if (req.replica == REPLICA_INSTALL) {
+		// 复制热点 key 时本节点发起的 pull，见 ReplicateHotKeys
+		InstallReplicas(res); return;
+	}
+	if (req.push && block_versions_) {
+		MarkChanged(req.keys);
+	}
+	// 分块的 push 只在所有块都回复后计一次
+	if (req.push && PushResponded(req)) {
+		++version_;
+	}
+	if (consistency_) {
+		consistency_->OnResponse(req, res);
+	} else {
+		SendResponse(req, res);
+	}
+}
+
+template <typename Value>
+void KVServer<Value>::SetConsistency(ConsistencyModel model, int staleness) {
+	delete consistency_;
+	consistency_ = nullptr;
+	if (model == ASYNC) return;
+	consistency_ = new ConsistencyController<Value>(model, staleness, PostOffice::Get()->num_workers(),
+		[this](const KVMeta& req_meta, const KVPairs<Value>& req_data) {
+			request_handle_(req_meta, req_data, this);
+		},
+		[this](const KVMeta& req_meta, const KVPairs<Value>& res) {
+			SendResponse(req_meta, res);
+		});
+}
+
+template <typename Value>
+void KVServer<Value>::SetMigrationHandle(const ExportHandle& export_handle, const ImportHandle& import_handle) {
+	CHECK(static_cast<bool>(export_handle) && static_cast<bool>(import_handle)) << "invalid migration handle";
+	export_handle_ = export_handle;
+	import_handle_ = import_handle;
+	Rebalancer* rebalancer = PostOffice::Get()->van()->rebalancer();
+	if (!rebalancer) return;
+	// 迁移消息与请求在同一线程中处理
+	rebalancer->SetMigrationHandle([this](const Message& msg) {
+		customer_->OnReceive(msg);
+	});
+}
+
+template <typename Value>
+void KVServer<Value>::Migrate(const Message& msg) {
+	CHECK_EQ(msg.meta.control.cmd, Control::UPDATE_RANGES);
+	CHECK(msg.meta.request);
+	int version = Rebalancer::BodyVersion(msg);
+	{
+		// 迁移改变本节点的参数，但不改变参数的版本
+		std::lock_guard<std::mutex> lk(shared_mu_);
+		shared_pulls_.clear();
+	}
+	int num_servers = PostOffice::Get()->num_servers();
+	if (msg.meta.sender == kScheduler) {
+		// 区间表已经更新，将属于其它 server 的参数发给它（没有也发送，接收者需要收齐）
+		int rank = PostOffice::Get()->my_rank();
+		std::vector<Range> ranges = PostOffice::Get()->GetServerRanges();
+		for (int i = 0; i < num_servers; ++i) {
+			if (i == rank) continue;
+			KVPairs<Value> kvs;
+			export_handle_(ranges[i], &kvs);
+			Message out;
+			out.meta.app_id = customer_->app_id();
+			out.meta.customer_id = customer_->app_id();
+			out.meta.request = true;
+			out.meta.receiver = PostOffice::Get()->ServerRankToID(i);
+			out.meta.timestamp = PostOffice::Get()->van()->GetAvailableTimestamp();
+			out.meta.control.cmd = Control::UPDATE_RANGES;
+			out.meta.body = Rebalancer::VersionBody(version);
+			if (kvs.keys.size()) {
+				out.AddData(kvs.keys);
+				out.AddData(kvs.vals);
+				if (kvs.lens.size()) {
+					out.AddData(kvs.lens);
+				}
+			}
+			PostOffice::Get()->van()->Send(out);
+		}
+		migrated_version_ = version;
+		// 各 worker 会按新的区间重新发送注册的 key
+		{
+			std::lock_guard<std::mutex> lk(keys_mu_);
+			registered_keys_.clear();
+		}
+	} else {
+		if (msg.data.size()) {
+			KVPairs<Value> kvs;
+			kvs.keys = GetKeyData(msg);
+			kvs.vals = GetValData<Value>(msg);
+			if (msg.data.size() > 2) {
+				kvs.lens = msg.data[2];
+			}
+			import_handle_(kvs);
+			if (block_versions_) {
+				MarkChanged(kvs.keys);
+			}
+		}
+		++imports_[version];
+	}
+	if (migrated_version_ == version && imports_[version] == num_servers - 1) {
+		imports_.erase(version);
+		// 参数所在的 server 改变，使 worker 的缓存失效
+		++version_;
+		PostOffice::Get()->van()->rebalancer()->FinishMigration(version);
+	}
+}
+
+template <typename Value>
+void KVServer<Value>::SetHotKeyReplication(size_t max_keys, double min_share, int sync_interval_ms) {
+	CHECK(PostOffice::Get()->van()->rebalancer() == nullptr)
+			<< "hot key replication cannot be used with key range rebalancing";
+	CHECK_GT(sync_interval_ms, 0);
+	hot_sync_interval_ = sync_interval_ms;
+	// 只有一个 server 时没有可以保存副本的节点
+	hot_max_keys_ = PostOffice::Get()->num_servers() > 1 ? max_keys : 0;
+	hot_min_share_ = min_share;
+}
+
+template <typename Value>
+void KVServer<Value>::SampleHotKeys(const SVector<Key>& keys) {
+	size_t n = keys.size();
+	if (n == 0) return;
+	size_t m = std::min(n, kHotKeySamples);
+	double weight = static_cast<double>(n) / m;
+	std::vector<std::pair<double, Key>> hot;
+	{
+		std::lock_guard<std::mutex> lk(hot_mu_);
+		for (size_t i = 0; i < m; ++i) {
+			Key key = keys[m == n ? i : hot_rng_() % n];
+			if (!hot_set_.count(key)) {
+				hot_counts_[key] += weight;
+			}
+		}
+		hot_total_ += n;
+		hot_samples_ += m;
+		if (hot_samples_ < kHotKeyWindow) return;
+		for (const auto& [key, count]: hot_counts_) {
+			if (count >= hot_min_share_ * hot_total_) {
+				hot.emplace_back(count, key);
+			}
+		}
+		hot_counts_.clear();
+		hot_total_ = 0;
+		hot_samples_ = 0;
+		size_t room = hot_max_keys_ - std::min(hot_max_keys_, hot_set_.size());
+		if (hot.size() > room) {
+			std::partial_sort(hot.begin(), hot.begin() + room, hot.end(), std::greater<>());
+			hot.resize(room);
+		}
+		for (const auto& h: hot) {
+			hot_set_.insert(h.second);
+		}
+	}
+	if (hot.empty()) return;
+	SVector<Key> hot_keys(hot.size());
+	for (size_t i = 0; i < hot.size(); ++i) {
+		hot_keys[i] = hot[i].second;
+	}
+	std::sort(hot_keys.begin(), hot_keys.end());
+	ReplicateHotKeys(hot_keys);
+}
+
+template <typename Value>
+void KVServer<Value>::ReplicateHotKeys(const SVector<Key>& keys) {
+	KVMeta meta;
+	meta.cmd = 0;
+	meta.push = false;
+	meta.pull = true;
+	meta.sender = PostOffice::Get()->van()->my_node().id;
+	meta.timestamp = Meta::kEmpty;
+	meta.customer_id = customer_->app_id();
+	meta.keys = keys;
+	meta.replica = REPLICA_INSTALL;
+	KVPairs<Value> data;
+	data.keys = keys;
+	CHECK(static_cast<bool>(request_handle_));
+	request_handle_(meta, data, this);
+}
+
+template <typename Value>
+void KVServer<Value>::InstallReplicas(const KVPairs<Value>& res) {
+	if (res.keys.empty()) return;
+	CHECK(res.lens.empty()) << "hot keys must have the same number of values";
+	CHECK_EQ(res.vals.size() % res.keys.size(), 0u) << "hot keys must have the same number of values";
+	int num_servers = PostOffice::Get()->num_servers();
+	int rank = PostOffice::Get()->my_rank();
+	int ts = customer_->NewRequest(kServerGroup);
+	customer_->AddResponse(ts, 1); // 本节点不需要回复
+	{
+		std::lock_guard<std::mutex> lk(hot_mu_);
+		installing_[ts] = {res.keys, num_servers - 1};
+	}
+	for (int i = 0; i < num_servers; ++i) {
+		if (i == rank) continue;
+		Message msg;
+		msg.meta.app_id = customer_->app_id();
+		msg.meta.customer_id = customer_->app_id();
+		msg.meta.request = true;
+		msg.meta.push = true;
+		msg.meta.timestamp = ts;
+		msg.meta.receiver = PostOffice::Get()->ServerRankToID(i);
+		msg.meta.replica = REPLICA_INSTALL;
+		AddKeyData(&msg, res.keys, false);
+		AddValData(&msg, res.vals, quantize::NONE, 0);
+		PostOffice::Get()->van()->Send(msg);
+	}
+}
+
+template <typename Value>
+void KVServer<Value>::OnReplicaRequest(const KVMeta& meta, const KVPairs<Value>& data) {
+	size_t n = data.keys.size();
+	KVPairs<Value> res;
+	{
+		std::lock_guard<std::mutex> lk(hot_mu_);
+		if (meta.replica == REPLICA_INSTALL) {
+			size_t k = n ? data.vals.size() / n : 0;
+			int owner = PostOffice::Get()->IDToRank(meta.sender);
+			for (size_t i = 0; i < n; ++i) {
+				Replica& r = replicas_[data.keys[i]];
+				r.owner = owner;
+				r.vals.assign(data.vals.data() + i * k, data.vals.data() + (i + 1) * k);
+				r.delta.assign(k, Value());
+			}
+			if (!sync_thread_) {
+				sync_thread_.reset(new std::thread(&KVServer<Value>::SyncThread, this));
+			}
+		} else {
+			if (meta.pull) {
+				res.keys = data.keys;
+			}
+			size_t k = 0;
+			for (size_t i = 0; i < n; ++i) {
+				auto it = replicas_.find(data.keys[i]);
+				CHECK(it != replicas_.end()) << "key " << data.keys[i] << " is not replicated on server "
+						<< PostOffice::Get()->my_rank();
+				Replica& r = it->second;
+				if (i == 0) {
+					k = r.vals.size();
+					if (meta.push) CHECK_EQ(data.vals.size(), n * k) << "unmatched value size of hot keys";
+					if (meta.pull) res.vals = ResponseBuffer(n * k);
+				}
+				CHECK_EQ(r.vals.size(), k) << "hot keys must have the same number of values";
+				if (meta.push) {
+					const Value* src = data.vals.data() + i * k;
+					for (size_t j = 0; j < k; ++j) r.delta[j] += src[j];
+					r.dirty = true;
+				}
+				if (meta.pull) {
+					std::copy(r.vals.begin(), r.vals.end(), res.vals.data() + i * k);
+				}
+			}
+		}
+	}
+	// 不经过 Response：副本的访问不改变本节点参数的版本
+	SendResponse(meta, res);
+}
+
+template <typename Value>
+void KVServer<Value>::OnReplicaResponse(const Message& msg) {
+	if (msg.meta.replica == REPLICA_INSTALL) {
+		std::lock_guard<std::mutex> lk(hot_mu_);
+		auto it = installing_.find(msg.meta.timestamp);
+		CHECK(it != installing_.end()) << "unexpected replica response";
+		if (--it->second.second == 0) {
+			const SVector<Key>& keys = it->second.first;
+			hot_keys_.insert(hot_keys_.end(), keys.begin(), keys.end());
+			PS_LOG_INFO << "Server " << PostOffice::Get()->my_rank() << " replicated " << keys.size()
+					<< " hot keys (" << hot_keys_.size() << " in total)";
+			installing_.erase(it);
+		}
+	} else if (msg.meta.replica == REPLICA_SYNC && msg.meta.pull) {
+		SVector<Key> keys = GetKeyData(msg);
+		SVector<Value> vals = GetValData<Value>(msg);
+		std::lock_guard<std::mutex> lk(hot_mu_);
+		size_t k = keys.empty() ? 0 : vals.size() / keys.size();
+		for (size_t i = 0; i < keys.size(); ++i) {
+			auto it = replicas_.find(keys[i]);
+			CHECK(it != replicas_.end());
+			it->second.vals.assign(vals.data() + i * k, vals.data() + (i + 1) * k);
+		}
+	}
+}
+
+template <typename Value>
+void KVServer<Value>::SyncThread() {
+	while (true) {
+		// 负责者 rank -> 副本的 key，以及有增量的 key
+		std::map<int, std::vector<Key>> pulls, dirty;
+		std::map<int, KVPairs<Value>> push_kvs;
+		{
+			std::unique_lock<std::mutex> lk(hot_mu_);
+			sync_cond_.wait_for(lk, std::chrono::milliseconds(hot_sync_interval_), [this] { return sync_exit_; });
+			if (sync_exit_) break;
+			for (const auto& [key, r]: replicas_) {
+				pulls[r.owner].push_back(key);
+				if (r.dirty) dirty[r.owner].push_back(key);
+			}
+			// 在锁内取出增量并清空
+			for (auto& [owner, keys]: dirty) {
+				std::sort(keys.begin(), keys.end());
+				KVPairs<Value>& kvs = push_kvs[owner];
+				size_t k = replicas_[keys[0]].delta.size();
+				kvs.keys.CopyFrom(keys.data(), keys.size());
+				kvs.vals.resize(keys.size() * k);
+				for (size_t i = 0; i < keys.size(); ++i) {
+					Replica& r = replicas_[keys[i]];
+					std::copy(r.delta.begin(), r.delta.end(), kvs.vals.data() + i * k);
+					std::fill(r.delta.begin(), r.delta.end(), Value());
+					r.dirty = false;
+				}
+			}
+		}
+		auto send = [this](int owner, bool push, const KVPairs<Value>& kvs) {
+			int receiver = PostOffice::Get()->ServerRankToID(owner);
+			Message msg;
+			msg.meta.app_id = customer_->app_id();
+			msg.meta.customer_id = customer_->app_id();
+			msg.meta.request = true;
+			msg.meta.push = push;
+			msg.meta.pull = !push;
+			msg.meta.timestamp = customer_->NewRequest(receiver);
+			msg.meta.receiver = receiver;
+			msg.meta.replica = REPLICA_SYNC;
+			AddKeyData(&msg, kvs.keys, false);
+			AddValData(&msg, kvs.vals, quantize::NONE, 0);
+			PostOffice::Get()->van()->Send(msg);
+		};
+		// 同一连接上的消息按顺序处理，拉取到的 value 包含刚合并的增量
+		for (const auto& [owner, kvs]: push_kvs) {
+			send(owner, true, kvs);
+		}
+		for (auto& [owner, keys]: pulls) {
+			std::sort(keys.begin(), keys.end());
+			KVPairs<Value> kvs;
+			kvs.keys.CopyFrom(keys.data(), keys.size());
+			send(owner, false, kvs);
+		}
+	}
+}
+
+template <typename Value>
+void KVServer<Value>::SetBackupWorkers(int num_backup, bool drop_late) {
+	CHECK(consistency_ != nullptr) << "SetConsistency(BSP) must be called before SetBackupWorkers";
+	consistency_->SetBackupWorkers(num_backup, drop_late);
+}
+
+template <typename Value>
+void KVServer<Value>::SendResponse(const KVMeta& req, const KVPairs<Value>& res) {
+	if (req.ack_seq) {
+		// 在 worker 请求确认时一起回复。消息不一定按发送的顺序处理，记录已回复的序号的最长前缀
+		std::lock_guard<std::mutex> lk(ack_mu_);
+		auto& acks = push_acks_[CustomerID(req.sender, req.customer_id)];
+		acks.done.push_back(req.timestamp);
+		acks.out_of_order.insert(req.ack_seq);
+		while (!acks.out_of_order.empty() && *acks.out_of_order.begin() == acks.responded + 1) {
+			acks.out_of_order.erase(acks.out_of_order.begin());
+			++acks.responded;
+		}
+		if (!acks.requests.empty()) {
+			SendAcks(req.sender, req.customer_id, &acks);
+		}
+		return;
+	}
 	// 根据 KVMeta 和 KVPairs 生成一个 Message
 	Message msg;
+	InitResponse(req, &msg);
+	// Message 中的 SVector 会与 request_handle_ 中产生的要返回的 KVPairs 中的数组共享所有权，以减少拷贝
+	// ~为什么不 move 而是引用计数？因为 Response 不一定能负责 res 的生命周期~
+	if (res.keys.size()) {
+		// 回复的 key 与请求的相同时，worker 可以按请求的切分放置 value（使用已注册 key 的请求，请求的 key 即注册的 key）
+		const SVector<Key>& keys = req.keys;
+		bool same_keys = keys.size() == res.keys.size() && (keys.data() == res.keys.data() ||
+				memcmp(keys.data(), res.keys.data(), keys.size() * sizeof(Key)) == 0);
+		bool omit_keys = req.omit_keys && same_keys;
+		if (req.shared_version >= 0 && res.lens.empty()) {
+			std::unique_lock<std::mutex> lk(shared_mu_);
+			SharedPull* shared = FindSharedPull(req, keys);
+			if (!shared && req.shared_version == shared_version_ && shared_pulls_.size() < kMaxSharedPulls) {
+				// 从收到请求到回复，参数的版本没有改变，回复可以共享
+				shared = &shared_pulls_.emplace_back();
+				shared->keys = keys;
+				shared->cmd = req.cmd;
+				shared->codec = req.pull_codec;
+				shared->res_keys = res.keys;
+				shared->same_keys = same_keys;
+				Message vals;
+				AddValData(&vals, res.vals, req.pull_codec, quantize_seed_.fetch_add(0x9e3779b9u), &response_pool_);
+				shared->val_frame = vals.data[0];
+				shared->val_type = vals.meta.data_type[0];
+			}
+			if (shared) {
+				AddSharedData(shared, omit_keys, &msg);
+				lk.unlock();
+				PostOffice::Get()->van()->Send(msg);
+				return;
+			}
+		}
+		AddKeyData(&msg, omit_keys ? SVector<Key>() : res.keys, encode_keys_, &response_pool_);
+		AddValData(&msg, res.vals, req.pull_codec, quantize_seed_.fetch_add(0x9e3779b9u), &response_pool_);
+		if (res.lens.size()) {
+			msg.AddData(res.lens);
+		}
+	}
+	PostOffice::Get()->van()->Send(msg);
+}
+
+template <typename Value>
+void KVServer<Value>::InitResponse(const KVMeta& req, Message* out) {
+	Message& msg = *out;
 	msg.meta.app_id = customer_->app_id();
 	msg.meta.customer_id = req.customer_id;
 	msg.meta.request	 = false;
@@ -500,16 +2434,135 @@ void KVServer<Value>::Response(const KVMeta& req, const KVPairs<Value>& res) {
 	msg.meta.head	 	 = req.cmd;
 	msg.meta.timestamp	 = req.timestamp;
 	msg.meta.receiver	 = req.sender;
-	// Message 中的 SVector 会与 request_handle_ 中产生的要返回的 KVPairs 中的数组共享所有权，以减少拷贝
-	// ~为什么不 move 而是引用计数？因为 Response 不一定能负责 res 的生命周期~
-	if (res.keys.size()) {
-		msg.AddData(res.keys);
-		msg.AddData(res.vals);
-		if (res.lens.size()) {
-			msg.AddData(res.lens);
+	msg.meta.version	 = req.pull_version >= 0 ? req.pull_version : version_.load();
+	msg.meta.delta		 = req.delta;
+	msg.meta.key_handle	 = req.key_handle;
+	msg.meta.chunk_id	 = req.chunk_id;
+	msg.meta.num_chunks	 = req.num_chunks;
+	msg.meta.replica	 = req.replica;
+	msg.meta.queue_depth = customer_->queue_depth();
+	msg.meta.tick		 = req.push && consistency_;
+	if (hot_max_keys_ && req.replica == -1) {
+		// 将新复制的热点 key 告知 worker
+		std::lock_guard<std::mutex> lk(hot_mu_);
+		size_t& told = hot_told_[CustomerID(req.sender, req.customer_id)];
+		if (told < hot_keys_.size()) {
+			msg.meta.body.assign(reinterpret_cast<const char*>(hot_keys_.data() + told),
+					(hot_keys_.size() - told) * sizeof(Key));
+			told = hot_keys_.size();
+		}
+	}
+}
+
+template <typename Value>
+typename KVServer<Value>::SharedPull* KVServer<Value>::FindSharedPull(const KVMeta& req, const SVector<Key>& keys) {
+	int version = version_;
+	if (shared_version_ != version) {
+		// 参数已经更新，之前的回复都不能再使用
+		shared_pulls_.clear();
+		shared_version_ = version;
+	}
+	for (auto& shared: shared_pulls_) {
+		if (shared.cmd == req.cmd && shared.codec == req.pull_codec && shared.keys.size() == keys.size() &&
+				(shared.keys.data() == keys.data() ||
+				memcmp(shared.keys.data(), keys.data(), keys.size() * sizeof(Key)) == 0)) {
+			return &shared;
 		}
 	}
+	return nullptr;
+}
+
+template <typename Value>
+void KVServer<Value>::AddSharedData(SharedPull* shared, bool omit_keys, Message* msg) {
+	if (omit_keys) {
+		AddKeyData(msg, SVector<Key>(), false);
+	} else {
+		if (!shared->has_key_frame) {
+			Message keys;
+			AddKeyData(&keys, shared->res_keys, encode_keys_, &response_pool_);
+			shared->key_frame = keys.data[0];
+			shared->key_type = keys.meta.data_type[0];
+			shared->has_key_frame = true;
+		}
+		msg->AddData(shared->key_frame, shared->key_type);
+	}
+	msg->AddData(shared->val_frame, shared->val_type);
+}
+
+template <typename Value>
+bool KVServer<Value>::RespondShared(const KVMeta& req) {
+	Message msg;
+	{
+		std::lock_guard<std::mutex> lk(shared_mu_);
+		SharedPull* shared = FindSharedPull(req, req.keys);
+		if (!shared) return false;
+		AddSharedData(shared, req.omit_keys && shared->same_keys, &msg);
+	}
+	++shared_pull_hits_;
+	InitResponse(req, &msg);
 	PostOffice::Get()->van()->Send(msg);
+	return true;
+}
+
+template <typename Value>
+void KVServer<Value>::MarkChanged(const SVector<Key>& keys) {
+	int version = version_ + 1;
+	for (Key key: keys) {
+		std::atomic<int>& block = block_versions_[DeltaBlock(key)];
+		int v = block.load();
+		// 并发回复的 push 可能已经记录了更大的版本
+		while (v < version && !block.compare_exchange_weak(v, version)) {}
+	}
+}
+
+template <typename Value>
+bool KVServer<Value>::SelectChanged(int since, KVMeta* meta, KVPairs<Value>* data) {
+	const SVector<Key>& keys = data->keys;
+	std::vector<Key> changed;
+	for (Key key: keys) {
+		if (block_versions_[DeltaBlock(key)] > since) {
+			changed.push_back(key);
+		}
+	}
+	if (changed.size() == keys.size()) return true;
+	unchanged_keys_ += keys.size() - changed.size();
+	meta->delta = true;
+	if (changed.empty()) {
+		// 回复不带数据，worker 保留缓存的 value
+		Message msg;
+		InitResponse(*meta, &msg);
+		PostOffice::Get()->van()->Send(msg);
+		return false;
+	}
+	// worker 按回复中的 key 放置 value
+	data->keys = SVector<Key>(std::move(changed));
+	meta->keys = data->keys;
+	meta->omit_keys = false;
+	return true;
+}
+
+template <typename Value>
+void KVServer<Value>::SendAcks(int worker, int customer_id, PushAcks* acks) {
+	size_t n = 0;
+	while (n < acks->requests.size() && acks->requests[n].second <= acks->responded) {
+		Message msg;
+		msg.meta.app_id = customer_->app_id();
+		msg.meta.customer_id = customer_id;
+		msg.meta.request	 = false;
+		msg.meta.timestamp	 = acks->requests[n].first;
+		msg.meta.receiver	 = worker;
+		msg.meta.version	 = version_;
+		msg.meta.ack_seq	 = acks->requests[n].second;
+		msg.meta.queue_depth = customer_->queue_depth();
+		msg.meta.tick		 = consistency_ != nullptr;
+		if (!acks->done.empty()) {
+			msg.AddData(SVector<int>(acks->done));
+			acks->done.clear();
+		}
+		PostOffice::Get()->van()->Send(msg);
+		++n;
+	}
+	acks->requests.erase(acks->requests.begin(), acks->requests.begin() + n);
 }
 
 template <typename Value>
@@ -544,77 +2597,432 @@ void KVWorker<Value>::DefaultSlicer(
 	CHECK_EQ(pos[n], send.keys.size());
 	if (send.keys.empty()) return; // 如果在一开始就返回，注意 sliced 的 bool 和大小初始化？
 
-	// the length of value
-	size_t k = 0, val_begin = 0, val_end = 0;
-	if (send.lens.empty()) {
-		k = send.vals.size() / send.keys.size();
-		CHECK_EQ(k * send.keys.size(), send.vals.size());
-	} else {
-		CHECK_EQ(send.keys.size(), send.lens.size());
+	// the length of value
+	size_t k = 0, val_begin = 0, val_end = 0;
+	if (send.lens.empty()) {
+		k = send.vals.size() / send.keys.size();
+		CHECK_EQ(k * send.keys.size(), send.vals.size());
+	} else {
+		CHECK_EQ(send.keys.size(), send.lens.size());
+	}
+
+	// slice
+	for (size_t i = 0; i < n; ++i) {
+		if (pos[i+1] == pos[i]) {
+			sliced->at(i).first = false;
+			continue;
+		}
+		sliced->at(i).first = true;
+		auto& kv = sliced->at(i).second;
+		kv.keys = send.keys.Slice(pos[i], pos[i+1]);
+		if (send.lens.size()) {
+			kv.lens = send.lens.Slice(pos[i], pos[i+1]);
+			for (int l : kv.lens) val_end += l;
+			kv.vals = send.vals.Slice(val_begin, val_end);
+			val_begin = val_end;
+		} else {
+			kv.vals = send.vals.Slice(pos[i]*k, pos[i+1]*k);
+		}
+	}
+}
+
+template <typename Value>
+void KVWorker<Value>::HashSlicer(
+		KVPairs<Value>& send, const std::vector<Range>& ranges,
+		typename KVWorker<Value>::SlicedKVs* sliced) {
+	size_t n = ranges.size(), m = send.keys.size();
+	sliced->assign(n, {false, KVPairs<Value>()});
+	if (m == 0) return;
+	size_t k = 0;
+	if (send.lens.empty()) {
+		k = send.vals.size() / m;
+		CHECK_EQ(k * m, send.vals.size());
+	} else {
+		CHECK_EQ(send.lens.size(), m);
+	}
+	// 先统计每个 server 的 key 与 value 数量，再分配、拷贝
+	std::vector<int> dest(m);
+	std::vector<size_t> num_keys(n, 0), num_vals(n, 0);
+	for (size_t j = 0; j < m; ++j) {
+		dest[j] = HashPartition(send.keys[j], n);
+		++num_keys[dest[j]];
+		num_vals[dest[j]] += send.lens.empty() ? k : send.lens[j];
+	}
+	bool has_vals = !send.vals.empty();
+	for (size_t i = 0; i < n; ++i) {
+		auto& s = sliced->at(i);
+		s.first = num_keys[i] != 0;
+		if (!s.first) continue;
+		s.second.keys.resize_uninitialized(num_keys[i]);
+		if (has_vals) ResizeOutput(&s.second.vals, num_vals[i]);
+		if (send.lens.size()) s.second.lens.resize_uninitialized(num_keys[i]);
+	}
+	std::vector<size_t> key_pos(n, 0), val_pos(n, 0);
+	const Value* src = send.vals.data();
+	for (size_t j = 0; j < m; ++j) {
+		auto& kv = sliced->at(dest[j]).second;
+		size_t t = key_pos[dest[j]]++;
+		kv.keys[t] = send.keys[j];
+		size_t len = k;
+		if (send.lens.size()) {
+			len = send.lens[j];
+			kv.lens[t] = send.lens[j];
+		}
+		if (has_vals) {
+			memcpy(kv.vals.data() + val_pos[dest[j]], src, len * sizeof(Value));
+			val_pos[dest[j]] += len;
+			src += len;
+		}
+	}
+}
+
+template <typename Value>
+Partition KVWorker<Value>::ChoosePartition(const SVector<Key>& keys, const std::vector<Range>& ranges) {
+	size_t n = ranges.size();
+	if (n < 2 || keys.empty()) return RANGE_PARTITION;
+	std::vector<size_t> count(n, 0);
+	size_t i = 0;
+	for (Key key : keys) {
+		while (i + 1 < n && key >= ranges[i].end) ++i;
+		++count[i];
+	}
+	size_t max = *std::max_element(count.begin(), count.end());
+	return max > kAutoPartitionSkew * keys.size() / n ? HASH_PARTITION : RANGE_PARTITION;
+}
+
+template <typename Value>
+Partition KVWorker<Value>::AgreePartition(Partition proposal) {
+	CHECK(!customer_->InReceiveThread()) << "the first request with AUTO_PARTITION can't be sent in a callback";
+	Message msg;
+	msg.meta.app_id = customer_->app_id();
+	msg.meta.customer_id = customer_->customer_id();
+	msg.meta.request	 = true;
+	msg.meta.receiver	 = PostOffice::Get()->ServerRankToID(0);
+	msg.meta.timestamp	 = customer_->NewRequest(msg.meta.receiver);
+	msg.meta.partition	 = proposal;
+	if (Rebalancer* rebalancer = PostOffice::Get()->van()->rebalancer()) {
+		// 回复同样会被 Rebalancer 计为请求的完成
+		rebalancer->OnRequestSent();
+	}
+	PostOffice::Get()->van()->Send(msg);
+	customer_->WaitRequest(msg.meta.timestamp);
+	return static_cast<Partition>(agreed_partition_.load());
+}
+
+template <typename Value>
+void KVWorker<Value>::ResolvePartition(const SVector<Key>& keys) {
+	if (custom_slicer_ || keys.empty() || partition() != AUTO_PARTITION) return;
+	Partition agreed = AgreePartition(ChoosePartition(keys, PostOffice::Get()->GetServerRanges()));
+	std::lock_guard<std::mutex> lk(partition_mu_);
+	if (partition_ == AUTO_PARTITION) {
+		// 多个线程同时确定时，server 0 对所有提议回复同一个划分
+		partition_ = agreed;
+		PS_LOG_INFO << "Key partition: " << PartitionName[partition_];
 	}
+}
 
-	// slice
-	for (size_t i = 0; i < n; ++i) {
-		if (pos[i+1] == pos[i]) {
-			sliced->at(i).first = false;
-			continue;
-		}
-		sliced->at(i).first = true;
-		auto& kv = sliced->at(i).second;
-		kv.keys = send.keys.Slice(pos[i], pos[i+1]);
-		if (send.lens.size()) {
-			kv.lens = send.lens.Slice(pos[i], pos[i+1]);
-			for (int l : kv.lens) val_end += l;
-			kv.vals = send.vals.Slice(val_begin, val_end);
-			val_begin = val_end;
-		} else {
-			kv.vals = send.vals.Slice(pos[i]*k, pos[i+1]*k);
-		}
+template <typename Value>
+void KVWorker<Value>::PartitionSlicer(
+		KVPairs<Value>& send, const std::vector<Range>& ranges,
+		typename KVWorker<Value>::SlicedKVs* sliced) {
+	if (partition() == HASH_PARTITION) {
+		HashSlicer(send, ranges, sliced);
+	} else {
+		DefaultSlicer(send, ranges, sliced);
 	}
 }
 
 template <typename Value>
-void KVWorker<Value>::Send(int timestamp, bool push, bool pull, int cmd, const KVPairs<Value>& kvs) {
+void KVWorker<Value>::Send(int timestamp, bool push, bool pull, int cmd, const KVPairs<Value>& kvs, int key_handle,
+							const std::vector<int>* since, int since_range_version) {
+	ResolvePartition(kvs.keys);
+	// 区间表切换期间阻塞，持有到所有消息发出，使请求按 server 当前的区间表切分
+	auto ranges_lk = PostOffice::Get()->BeginRequest();
+	int range_version;
+	std::vector<Range> ranges = PostOffice::Get()->GetServerRanges(&range_version);
+	if (since && range_version != since_range_version) {
+		// 区间表已经更新，各 server 负责的 key 改变了
+		since = nullptr;
+	}
+	Rebalancer* rebalancer = PostOffice::Get()->van()->rebalancer();
 	// slice the message
 	// kvs 的切分结果会保存到 sliced 中。sliced 非 const 所以 kvs 也只能非 const
 	// 需要保证不修改 sliced 的内容
 	SlicedKVs sliced;
-	slicer_(const_cast<KVPairs<Value>&>(kvs), PostOffice::Get()->GetServerRanges(), &sliced);
+	std::vector<bool> acked;
+	// 稀疏 push 先加上残差，切分后再从每个切片中选出要发送的部分
+	std::unique_lock<std::mutex> sparse_lk(sparse_mu_);
+	bool sparse = push && !pull && kvs.lens.empty() && !kvs.keys.empty() &&
+			(sparse_ratio_ > 0 || sparse_threshold_ > 0);
+	if (!sparse) sparse_lk.unlock();
+	Data acc;
+	if (sparse) acc = AddResidual(kvs);
+	const Data& send = sparse ? acc : kvs;
+	if (key_handle != -1) {
+		{
+			std::lock_guard<std::mutex> lk(keys_mu_);
+			auto& r = registered_keys_[key_handle];
+			if (r.range_version != range_version) {
+				SliceRegisteredKeys(&r, ranges, range_version);
+			}
+		}
+		SliceWithHandle(send, key_handle, &sliced);
+		std::lock_guard<std::mutex> lk(keys_mu_);
+		acked = registered_keys_[key_handle].acked;
+	} else {
+		slicer_(const_cast<KVPairs<Value>&>(send), ranges, &sliced);
+	}
+	// sparse_slice[i]：发给 server i 的是稀疏的 key 子集
+	std::vector<bool> sparse_slice(sliced.size(), false);
+	if (sparse) {
+		std::vector<bool> sent(acc.keys.size(), false);
+		for (size_t i = 0; i < sliced.size(); ++i) {
+			auto& s = sliced[i];
+			if (!s.first) continue;
+			// server 还没有保存注册的 key 时，这次发送完整的切片
+			double ratio = key_handle != -1 && !acked[i] ? 1 : sparse_ratio_;
+			size_t n = s.second.keys.size();
+			s.second = SelectTopK(acc, s.second, ratio, sparse_threshold_, &sent);
+			sparse_slice[i] = s.second.keys.size() < n;
+		}
+		UpdateResidual(acc, sent);
+		sparse_lk.unlock();
+	}
+	// 热点 key 发给副本，使用已注册 key、带 lens 的请求除外
+	std::vector<Data> replicas;
+	if (key_handle == -1 && kvs.lens.empty()) {
+		SliceHotKeys(&sliced, &replicas);
+	}
+
+	// 较大的切片分块发送，每块都会得到一个回复。对副本的访问作为最后一块发送
+	std::vector<std::vector<Data>> chunks(sliced.size());
+	// owned[i]：发给 server i 的块中，它负责的 key 的块数
+	std::vector<size_t> owned(sliced.size(), 0);
+	int extra_chunks = 0;
+	for (size_t i = 0; i < sliced.size(); ++i) {
+		if (sliced[i].first) {
+			if (key_handle == -1) {
+				chunks[i] = SplitChunks(sliced[i].second);
+			} else {
+				chunks[i].push_back(sliced[i].second);
+			}
+		}
+		owned[i] = chunks[i].size();
+		if (!replicas.empty() && !replicas[i].keys.empty()) {
+			chunks[i].push_back(std::move(replicas[i]));
+			sliced[i].first = true;
+		}
+		if (!chunks[i].empty()) {
+			extra_chunks += chunks[i].size() - 1;
+		}
+	}
+	if (extra_chunks) {
+		customer_->AddExpectedResponse(timestamp, extra_chunks);
+	}
+	// 有 PullTarget 的 pull（不带 lens）按保存的切分放置回复，回复不需要 key
+	bool omit_keys = pull && SetPullOffsets(timestamp, kvs.keys, chunks);
 
+	// 使用 BSP 或 SSP 的 server 的时钟按 push 的次数推进，没有 key 的 server 也需要收到这次 push 的时钟
+	std::vector<bool> ticks(sliced.size(), false);
+	if (push) {
+		for (size_t i = 0; i < sliced.size(); ++i) {
+			ticks[i] = !sliced[i].first && clock_ticks_[i];
+		}
+	}
 	// need to add response first, since it will not always trigger the callback
 	int skipped = 0;
 	for (size_t i = 0; i < sliced.size(); ++i) {
-		if (!sliced[i].first) ++skipped;
+		if (!sliced[i].first && !ticks[i]) ++skipped;
 	}
 	customer_->AddResponse(timestamp, skipped);
 	if ((size_t)skipped == sliced.size()) {
+		// 回调中可能再次发送请求
+		ranges_lk.unlock();
 		RunCallback(timestamp);
 		// 此时实际可以直接 return 了
 		// 当没有消息被发时，也不会收到回复，即 OnReceive 不会被调用，也就不会再有人触发 callback，所以手动调用下
 	}
 
-	for (size_t i = 0; i < sliced.size(); ++i) {
-		const auto& s = sliced[i];
-		if (!s.first) continue;
+	// 自己的 push 会让相关 server 的版本加一，在发送前就更新，并使包含这些 key 的缓存失效，之后的 pull 不会使用 push 之前的缓存
+	if (push && cache_capacity_) {
+		std::lock_guard<std::mutex> lk(cache_mu_);
+		for (size_t i = 0; i < sliced.size(); ++i) {
+			if (sliced[i].first) ++known_versions_[i];
+		}
+		InvalidateCache(kvs.keys);
+	}
+
+	// 划分在第一次切分后确定
+	int partition = custom_slicer_ ? Meta::kEmpty : this->partition();
+	// 同一请求发给各 server 的部分使用相同的编码
+	quantize::Codec push_codec = push ? push_codec_.load() : quantize::NONE;
+	quantize::Codec pull_codec = pull ? pull_codec_.load() : quantize::NONE;
+	// 只 push 的请求由 server 批量确认。server 还没有保存注册的 key 时需要回复，使之后只发送编号
+	// ack_seqs[i]：发给 server i 的第一块的序号，为 0 时需要回复
+	std::vector<uint64_t> ack_seqs(sliced.size(), 0);
+	if (push && !pull && push_ack_interval_) {
+		std::vector<size_t> counts(sliced.size(), 0);
+		for (size_t i = 0; i < sliced.size(); ++i) {
+			if (sliced[i].first && (key_handle == -1 || acked[i])) {
+				counts[i] = chunks[i].size();
+			}
+		}
+		if (std::any_of(counts.begin(), counts.end(), [](size_t n) { return n > 0; })) {
+			ack_seqs = AddUnackedPush(timestamp, counts);
+		}
+	}
+	// 先按发送顺序生成所有消息，再逐个发送
+	std::vector<Message> msgs;
+	for (size_t i: ServerOrder(sliced.size(), timestamp)) {
+		if (ticks[i]) {
+			Message& msg = msgs.emplace_back();
+			msg.meta.app_id = customer_->app_id();
+			msg.meta.customer_id = customer_->customer_id();
+			msg.meta.request	 = true;
+			msg.meta.push		 = true;
+			msg.meta.head		 = cmd;
+			msg.meta.timestamp	 = timestamp;
+			msg.meta.receiver	 = PostOffice::Get()->ServerRankToID(i);
+			msg.meta.priority	 = kvs.priority;
+			msg.meta.tick		 = true;
+			if (rebalancer) {
+				rebalancer->OnRequestSent();
+			}
+		}
+		if (!sliced[i].first) continue;
+		for (size_t c = 0; c < chunks[i].size(); ++c) {
+			Message& msg = msgs.emplace_back();
+			msg.meta.app_id = customer_->app_id();
+			msg.meta.customer_id = customer_->customer_id();
+			msg.meta.request	 = true;
+			msg.meta.push		 = push;
+			msg.meta.pull		 = pull;
+			msg.meta.head		 = cmd;
+			msg.meta.timestamp	 = timestamp;
+			msg.meta.receiver	 = PostOffice::Get()->ServerRankToID(i);
+			msg.meta.priority	 = kvs.priority;
+			msg.meta.pull_codec	 = pull_codec;
+			msg.meta.chunk_id	 = c;
+			msg.meta.num_chunks	 = owned[i];
+			if (c >= owned[i]) {
+				// 副本的 chunk_id 在 owned[i] 之后，使回复按块放置
+				msg.meta.replica = REPLICA_ACCESS;
+				msg.meta.num_chunks = chunks[i].size();
+			}
+			msg.meta.omit_keys	 = omit_keys;
+			msg.meta.ack_seq	 = ack_seqs[i] ? ack_seqs[i] + c : 0;
+			msg.meta.partition	 = partition;
+			msg.meta.range_version = range_version;
+			if (since && c < owned[i] && (*since)[i] >= 0) {
+				msg.meta.since_version = (*since)[i];
+			}
+			const auto& kvs = chunks[i][c];
+			if (key_handle != -1) {
+				// server 已保存这组 key 时只发送编号，稀疏时另外发送选出的 key
+				msg.meta.key_handle = key_handle;
+				msg.meta.sparse = sparse_slice[i];
+				AddKeyData(&msg, acked[i] && !sparse_slice[i] ? SVector<Key>() : kvs.keys, encode_keys_);
+				AddValData(&msg, kvs.vals, push_codec, quantize_seed_.fetch_add(0x9e3779b9u));
+			} else if (kvs.keys.size()) {
+				AddKeyData(&msg, kvs.keys, encode_keys_);
+				AddValData(&msg, kvs.vals, push_codec, quantize_seed_.fetch_add(0x9e3779b9u));
+				if (kvs.lens.size()) {
+					msg.AddData(kvs.lens);
+				}
+			}
+			if (rebalancer) {
+				rebalancer->OnRequestSent();
+			}
+		}
+	}
+	FlowController* flow = PostOffice::Get()->van()->flow_controller();
+	if (flow && ranges_lk.owns_lock()) {
+		// 等待额度时不持有区间表：这些请求已计入 Rebalancer 的进行中请求，暂停会等待它们完成
+		ranges_lk.unlock();
+	}
+	int pacing_us = send_pacing_us_;
+	for (size_t m = 0; m < msgs.size(); ++m) {
+		int receiver = msgs[m].meta.receiver;
+		if (pacing_us && m > 0 && receiver != msgs[m - 1].meta.receiver) {
+			int depth = std::min(queue_depths_[PostOffice::Get()->IDToRank(receiver)].load(), kMaxPacingDepth);
+			if (depth > 0) {
+				std::this_thread::sleep_for(std::chrono::microseconds(pacing_us * depth));
+			}
+		}
+		if (flow) {
+			flow->Send(msgs[m]);
+		} else {
+			PostOffice::Get()->van()->Send(msgs[m]);
+		}
+	}
+}
+
+template <typename Value>
+std::vector<size_t> KVWorker<Value>::ServerOrder(size_t n, int timestamp) {
+	std::vector<size_t> order(n);
+	SendOrder mode = send_order_;
+	size_t start = mode == RANK_ORDER || n == 0 ? 0 : PostOffice::Get()->my_rank() % n;
+	for (size_t i = 0; i < n; ++i) {
+		order[i] = (start + i) % n;
+	}
+	if (mode == RANDOM_ORDER) {
+		// 由 rank 与时间戳确定，不需要共享的随机数生成器
+		std::minstd_rand rng((static_cast<uint32_t>(PostOffice::Get()->my_rank()) << 16) ^ timestamp);
+		std::shuffle(order.begin(), order.end(), rng);
+	} else if (mode == ADAPTIVE_ORDER) {
+		std::vector<int> depths(n);
+		for (size_t i = 0; i < n; ++i) {
+			depths[i] = queue_depths_[i];
+		}
+		std::stable_sort(order.begin(), order.end(), [&depths](size_t a, size_t b) { return depths[a] < depths[b]; });
+	}
+	return order;
+}
+
+template <typename Value>
+std::vector<uint64_t> KVWorker<Value>::AddUnackedPush(int timestamp, const std::vector<size_t>& counts) {
+	std::lock_guard<std::mutex> lk(ack_mu_);
+	std::vector<uint64_t> first(counts.size(), 0);
+	for (size_t i = 0; i < counts.size(); ++i) {
+		if (!counts[i]) continue;
+		first[i] = ack_seqs_[i] + 1;
+		ack_seqs_[i] += counts[i];
+		unacked_servers_[i] = true;
+	}
+	unacked_pushes_.insert(timestamp);
+	if (unacked_pushes_.size() >= static_cast<size_t>(push_ack_interval_)) {
+		RequestAcks();
+	}
+	return first;
+}
+
+template <typename Value>
+void KVWorker<Value>::RequestAcks() {
+	for (size_t i = 0; i < unacked_servers_.size(); ++i) {
+		if (!unacked_servers_[i]) continue;
 		Message msg;
 		msg.meta.app_id = customer_->app_id();
 		msg.meta.customer_id = customer_->customer_id();
 		msg.meta.request	 = true;
-		msg.meta.push		 = push;
-		msg.meta.pull		 = pull;
-		msg.meta.head		 = cmd;
-		msg.meta.timestamp	 = timestamp;
 		msg.meta.receiver	 = PostOffice::Get()->ServerRankToID(i);
-		msg.meta.priority	 = kvs.priority;
-		const auto& kvs = s.second;
-		if (kvs.keys.size()) {
-			msg.AddData(kvs.keys);
-			msg.AddData(kvs.vals);
-			if (kvs.lens.size()) {
-				msg.AddData(kvs.lens);
-			}
-		}
+		msg.meta.timestamp	 = customer_->NewRequest(msg.meta.receiver);
+		msg.meta.ack_seq	 = ack_seqs_[i];
 		PostOffice::Get()->van()->Send(msg);
+		unacked_servers_[i] = false;
+	}
+	unacked_pushes_.clear();
+}
+
+template <typename Value>
+void KVWorker<Value>::OnAcks(const Message& msg) {
+	if (msg.data.empty()) return;
+	SVector<int> done(msg.data[0]);
+	for (int ts: done) {
+		// 与 OnReceive 相同，先执行回调再计入回复
+		if (customer_->GetResponse(ts) == customer_->GetExpectedResponse(ts) - 1) {
+			RunCallback(ts);
+		}
+		customer_->AddResponse(ts);
 	}
 }
 
@@ -623,31 +3031,83 @@ void KVWorker<Value>::OnReceive(const Message& msg) {
 	if (msg.meta.simple_app) {
 		SimpleApp::OnReceive(msg); return;
 	}
+	if (!msg.meta.body.empty()) {
+		AddHotKeys(msg);
+	}
+	if (msg.meta.ack_seq) {
+		OnAcks(msg);
+	}
+	if (!msg.meta.request) {
+		queue_depths_[PostOffice::Get()->IDToRank(msg.meta.sender)] = msg.meta.queue_depth;
+		if (msg.meta.push || msg.meta.ack_seq) {
+			clock_ticks_[PostOffice::Get()->IDToRank(msg.meta.sender)] = msg.meta.tick;
+		}
+		if (!msg.meta.push && !msg.meta.pull && msg.meta.partition != Meta::kEmpty) {
+			// server 0 对 AgreePartition 的回复
+			agreed_partition_ = msg.meta.partition;
+		}
+	}
 	// store the data for pulling
 	int ts = msg.meta.timestamp;
-	if (msg.meta.pull) {
-		CHECK_GE(msg.data.size(), (size_t)2);
-		KVPairs<Value> kvs;
-		kvs.keys = msg.data[0];
-		kvs.vals = msg.data[1];
-		if (msg.data.size() > (size_t)2) {
-			kvs.lens = msg.data[2];
+	if (cache_capacity_ && msg.meta.version != Meta::kEmpty) {
+		int rank = PostOffice::Get()->IDToRank(msg.meta.sender);
+		std::lock_guard<std::mutex> lk(cache_mu_);
+		known_versions_[rank] = std::max(known_versions_[rank], msg.meta.version);
+		if (msg.meta.pull) {
+			auto it = cache_pulls_.find(ts);
+			if (it != cache_pulls_.end()) {
+				// 分块时取各块中最小的版本，使增量 pull 不会漏掉任何一块之后的改变
+				int& version = it->second->fetching_versions[rank];
+				version = version < 0 ? msg.meta.version : std::min(version, msg.meta.version);
+			}
 		}
+	}
+	if (msg.meta.key_handle != Meta::kEmpty) {
+		// server 回复后就已经保存了这组 key
+		int rank = PostOffice::Get()->IDToRank(msg.meta.sender);
+		std::lock_guard<std::mutex> lk(keys_mu_);
+		registered_keys_[msg.meta.key_handle].acked[rank] = true;
+	}
+	if (msg.meta.pull) {
+		// 增量 pull 的回复在没有改变时不带数据
+		CHECK(msg.data.size() >= 2 || msg.meta.delta);
 		mu_.lock();
-		recv_kvs_[ts].push_back(kvs);
+		auto it = pull_targets_.find(ts);
+		PullTarget* target = it == pull_targets_.end() ? nullptr : &it->second;
 		mu_.unlock();
+		if (target) {
+			WritePullResponse(target, msg);
+		} else {
+			KVPairs<Value> kvs;
+			kvs.keys = GetKeyData(msg);
+			kvs.vals = GetValData<Value>(msg);
+			if (msg.data.size() > (size_t)2) {
+				kvs.lens = msg.data[2];
+			}
+			mu_.lock();
+			recv_kvs_[ts].push_back(kvs);
+			mu_.unlock();
+		}
 	}
 
 	// finished, run callbacks
 	// Customer 接收消息的处理流程中，是先执行 recv_handle_ 即该函数，再执行 AddResponse、然后尝试唤醒
-	// 因此最后的 Response 是 num-1 而非 num
-	if (customer_->GetResponse(ts) == PostOffice::Get()->num_servers() - 1)	{
+	// 因此最后的 Response 是 num-1 而非 num（分块发送时 num 为所有块的数量）
+	if (customer_->GetResponse(ts) == customer_->GetExpectedResponse(ts) - 1)	{
 		RunCallback(ts);
 	}
 }
 template <typename Value>
 void KVWorker<Value>::RunCallback(int timestamp) {
 	mu_.lock();
+	// 不带 lens 的 pull：回复已写入输出缓冲区，检查是否收全
+	auto target = pull_targets_.find(timestamp);
+	if (target != pull_targets_.end()) {
+		size_t received = target->second.received;
+		size_t total = target->second.keys.size();
+		pull_targets_.erase(target);
+		CHECK_EQ(received, total) << "lost some servers?";
+	}
 	auto it = callbacks_.find(timestamp);
 	if (it != callbacks_.end()) {
 		// rehash 会导致迭代器 it 失效。因此应该先把 it->second 存到临时变量，然后移除、解锁，再执行
@@ -669,63 +3129,623 @@ int KVWorker<Value>::AddPullCB(
 		const SVector<Key>& keys, C* vals, D* lens, int cmd,
 		const Callback& cb) {
 	int ts = customer_->NewRequest(kServerGroup);
+	if (!lens) {
+		// 回复到达时直接写入 vals（见 WritePullResponse），完成时只需检查是否收全
+		{
+			std::lock_guard<std::mutex> lk(mu_);
+			PullTarget& target = pull_targets_[ts];
+			target.keys = keys;
+			target.buffer = [vals](size_t n) {
+				CHECK_NOTNULL(vals);
+				if (vals->empty()) {
+					ResizeOutput(vals, n);
+				} else {
+					CHECK_EQ(vals->size(), n);
+				}
+				return vals->data();
+			};
+		}
+		// 完成时由 RunCallback 检查并移除 PullTarget，不需要包装 cb
+		AddCallback(ts, cb);
+		return ts;
+	}
 	// ~keys 也要值捕获吗？~（SVector 的拷贝代价低，无所谓）
 	AddCallback(ts, [this, ts, keys, vals, lens, cb]() mutable {
 			mu_.lock();
-			auto& kvs = recv_kvs_[ts]; // 检查一下是否为空
+			auto kvs = std::move(recv_kvs_[ts]);
+			recv_kvs_.erase(ts);
 			mu_.unlock();
 
 			// do check
-			// 检查从各节点收到的 keys 是否对应原来的 keys
+			// 检查从各节点收到的 keys 是否对应原来的 keys：区间划分时是连续区间，哈希划分时是有序子序列
+			std::vector<PartPosition> parts;
 			size_t total_key = 0, total_val = 0;
 			for (const auto& s : kvs) {
-				// 将切分后的某一部分 key 映射到原来 key 的下标区间
-				Range range = FindRange(keys, s.keys.front(), s.keys.back()+1);
-				// s.keys 一定是原来 keys 的一个连续子区间
-				CHECK_EQ(range.size(), s.keys.size())
-						<< "unmatched keys size from one server";
-				if (lens) CHECK_EQ(s.lens.size(), s.keys.size()); // ? 不可以为 0 吗？
+				CHECK_EQ(s.lens.size(), s.keys.size()) << "unmatched lens size from one server";
+				parts.push_back(FindPart(keys, s.keys));
 				total_key += s.keys.size();
 				total_val += s.vals.size();
 			}
 			CHECK_EQ(total_key, keys.size()) << "lost some servers?";
 
 			// fill vals and lens
-			std::sort(kvs.begin(), kvs.end(), [](const KVPairs<Value>& a, const KVPairs<Value>& b) {
-				return a.keys.front() < b.keys.front();
-			});
 			CHECK_NOTNULL(vals);
 			if (vals->empty()) {
-				vals->resize(total_val);
+				ResizeOutput(vals, total_val);
 			} else {
 				CHECK_EQ(vals->size(), total_val); // GE 其实也可以
 			}
-			Value* p_vals = vals->data();
-			int *p_lens = nullptr;
-			if (lens) {
-				if (lens->empty()) {
-					lens->resize(keys.size());
+			if (lens->empty()) {
+				ResizeOutput(lens, keys.size());
+			} else {
+				CHECK_EQ(lens->size(), keys.size());
+			}
+			// 先填入 lens，由此得到每个 key 的 value 在 vals 中的位置
+			int* p_lens = lens->data();
+			for (size_t i = 0; i < kvs.size(); ++i) {
+				const auto& s = kvs[i];
+				if (parts[i].index.empty()) {
+					memcpy(p_lens + parts[i].offset, s.lens.data(), s.lens.size() * sizeof(int));
 				} else {
-					CHECK_EQ(lens->size(), keys.size());
+					for (size_t t = 0; t < s.lens.size(); ++t) p_lens[parts[i].index[t]] = s.lens[t];
 				}
-				p_lens = lens->data();
 			}
-			for (const auto& s : kvs) {
-				memcpy(p_vals, s.vals.data(), s.vals.size() * sizeof(Value));
-				p_vals += s.vals.size();
-				if (p_lens) {
-					memcpy(p_lens, s.lens.data(), s.lens.size() * sizeof(int));
-					p_lens += s.lens.size();
+			std::vector<size_t> val_pos(keys.size() + 1, 0);
+			for (size_t j = 0; j < keys.size(); ++j) val_pos[j + 1] = val_pos[j] + p_lens[j];
+			for (size_t i = 0; i < kvs.size(); ++i) {
+				const auto& s = kvs[i];
+				if (parts[i].index.empty()) {
+					memcpy(vals->data() + val_pos[parts[i].offset], s.vals.data(), s.vals.size() * sizeof(Value));
+					continue;
+				}
+				const Value* src = s.vals.data();
+				for (size_t t = 0; t < s.lens.size(); ++t) {
+					memcpy(vals->data() + val_pos[parts[i].index[t]], src, s.lens[t] * sizeof(Value));
+					src += s.lens[t];
 				}
 			}
 
-			mu_.lock();
-			recv_kvs_.erase(ts);
-			mu_.unlock();
 			if (cb) cb();
 		});
 
 	return ts;
 }
 
-} // namespace ps
\ No newline at end of file
+template <typename Value>
+template <typename C>
+int KVWorker<Value>::CachedPull(const SVector<Key>& keys, C* vals, const Callback& cb, int priority, int key_handle) {
+	std::unique_lock<std::mutex> lk(cache_mu_);
+	auto now = std::chrono::steady_clock::now();
+	size_t n = keys.size();
+	auto it = std::find_if(cache_.begin(), cache_.end(), [&](const CacheEntry& e) {
+		return e.keys.size() == n &&
+				(e.keys.data() == keys.data() || memcmp(e.keys.data(), keys.data(), n * sizeof(Key)) == 0);
+	});
+	if (it != cache_.end()) {
+		cache_.splice(cache_.begin(), cache_, it);
+	}
+	CacheEntry* entry = it == cache_.end() ? nullptr : &*it;
+	if (entry && key_handle != -1) {
+		entry->key_handle = key_handle;
+	}
+
+	if (entry && entry->valid && entry->range_version == PostOffice::Get()->GetServerRangesVersion()) {
+		int lag = CacheLag(*entry);
+		auto age = now - entry->time;
+		bool fresh = (cache_max_versions_ < 0 || lag <= cache_max_versions_) &&
+				(cache_max_age_.count() < 0 || age <= cache_max_age_);
+		if (fresh) {
+			++cache_hits_;
+			CopyCachedVals(entry->vals, vals);
+			if (!entry->refreshing && (lag > 0 || (cache_max_age_.count() >= 0 && age * 2 > cache_max_age_))) {
+				RefreshCache(entry, priority, (C*)nullptr, nullptr, lk);
+			} else {
+				lk.unlock();
+			}
+			// 构造一个已完成的请求，使 Wait 立即返回
+			int ts = customer_->NewRequest(kServerGroup);
+			customer_->AddResponse(ts, PostOffice::Get()->num_servers());
+			if (cb) cb();
+			return ts;
+		}
+	}
+	if (entry && entry->refreshing) return -1;
+	if (!entry) {
+		if (cache_.size() >= cache_capacity_) {
+			// 淘汰最久未使用、且没有在刷新的缓存
+			auto victim = std::find_if(cache_.rbegin(), cache_.rend(),
+					[](const CacheEntry& e) { return !e.refreshing; });
+			if (victim == cache_.rend()) return -1;
+			cache_.erase(std::next(victim).base());
+		}
+		cache_.emplace_front();
+		entry = &cache_.front();
+		entry->keys = keys;
+		entry->key_handle = key_handle;
+	}
+	return RefreshCache(entry, priority, vals, cb, lk);
+}
+
+template <typename Value>
+template <typename C>
+int KVWorker<Value>::RefreshCache(CacheEntry* entry, int priority, C* out, const Callback& cb,
+									std::unique_lock<std::mutex>& lk) {
+	int range_version = PostOffice::Get()->GetServerRangesVersion();
+	// 缓存有效且区间表没有更新时使用增量 pull：回复只带有改变的 value，写入缓存的副本中
+	bool delta = delta_pull_ && entry->valid && entry->range_version == range_version && !entry->vals.empty();
+	std::vector<int> since;
+	if (delta) {
+		since = entry->versions;
+		entry->fetching_vals = entry->vals;
+	}
+	entry->refreshing = true;
+	entry->stale = false;
+	entry->fetching_versions.assign(known_versions_.size(), -1);
+	entry->range_version = range_version;
+	auto fetch_time = std::chrono::steady_clock::now();
+	int ts = AddPullCB(entry->keys, &entry->fetching_vals, (std::vector<int>*)nullptr, 0,
+			[this, entry, fetch_time, out, cb]() {
+				{
+					std::lock_guard<std::mutex> lk(cache_mu_);
+					cache_pulls_.erase(entry->fetching_ts);
+					entry->vals.swap(entry->fetching_vals);
+					entry->versions.swap(entry->fetching_versions);
+					entry->time = fetch_time;
+					entry->valid = !entry->stale;
+					entry->refreshing = false;
+					if (out) CopyCachedVals(entry->vals, out);
+				}
+				if (cb) cb();
+			});
+	entry->fetching_ts = ts;
+	cache_pulls_[ts] = entry;
+	if (delta) {
+		std::lock_guard<std::mutex> target_lk(mu_);
+		PullTarget& target = pull_targets_[ts];
+		target.k = entry->vals.size() / entry->keys.size();
+		target.out = entry->fetching_vals.data();
+	}
+	lk.unlock();
+	// 刷新期间 entry 不会被淘汰，keys 也不会再改变
+	Data kvs;
+	kvs.keys = entry->keys;
+	kvs.priority = priority;
+	Send(ts, false, true, 0, kvs, entry->key_handle, delta ? &since : nullptr, range_version);
+	return ts;
+}
+
+template <typename Value>
+void KVWorker<Value>::InvalidateCache(const SVector<Key>& keys) {
+	for (CacheEntry& entry : cache_) {
+		// 两组 key 都升序排列，归并查找是否有相同的 key
+		const Key* a = entry.keys.begin();
+		const Key* b = keys.begin();
+		while (a != entry.keys.end() && b != keys.end() && *a != *b) {
+			if (*a < *b) ++a; else ++b;
+		}
+		if (a != entry.keys.end() && b != keys.end()) {
+			entry.valid = false;
+			entry.stale = entry.refreshing;
+		}
+	}
+}
+
+template <typename Value>
+KeyHandle KVWorker<Value>::RegisterKeys(const SVector<Key>& keys) {
+	CHECK(!keys.empty());
+	RegisteredKeys r;
+	r.keys = keys;
+	ResolvePartition(keys);
+	int range_version;
+	std::vector<Range> ranges = PostOffice::Get()->GetServerRanges(&range_version);
+	std::lock_guard<std::mutex> lk(keys_mu_);
+	SliceRegisteredKeys(&r, ranges, range_version);
+	registered_keys_.push_back(std::move(r));
+	return KeyHandle(registered_keys_.size() - 1);
+}
+
+template <typename Value>
+void KVWorker<Value>::SliceRegisteredKeys(RegisteredKeys* r, const std::vector<Range>& ranges, int range_version) {
+	Data kvs;
+	kvs.keys = r->keys;
+	SlicedKVs sliced;
+	slicer_(kvs, ranges, &sliced);
+	r->parts.clear();
+	size_t total = 0;
+	for (const auto& s : sliced) {
+		r->parts.push_back(s.first ? FindPart(r->keys, s.second.keys) : PartPosition());
+		total += r->parts.back().size;
+	}
+	CHECK_EQ(total, r->keys.size());
+	r->acked.assign(sliced.size(), false);
+	r->range_version = range_version;
+}
+
+template <typename Value>
+typename KVWorker<Value>::Data KVWorker<Value>::AddResidual(const Data& kvs) {
+	size_t n = kvs.keys.size();
+	size_t k = kvs.vals.size() / n;
+	CHECK_EQ(k * n, kvs.vals.size());
+	if (residual_keys_.empty()) {
+		residual_k_ = k;
+	} else {
+		CHECK_EQ(k, residual_k_) << "sparsified pushes must have the same number of values per key";
+	}
+	Data acc;
+	acc.keys = kvs.keys;
+	acc.vals.CopyFrom(kvs.vals.data(), kvs.vals.size());
+	acc.priority = kvs.priority;
+	// key 与残差的 key 都是升序的，归并一次即可
+	size_t r = 0, m = residual_keys_.size();
+	for (size_t i = 0; i < n && r < m; ++i) {
+		Key key = kvs.keys[i];
+		while (r < m && residual_keys_[r] < key) ++r;
+		if (r < m && residual_keys_[r] == key) {
+			const Value* res = residual_vals_.data() + r * k;
+			Value* val = acc.vals.data() + i * k;
+			for (size_t j = 0; j < k; ++j) val[j] += res[j];
+		}
+	}
+	return acc;
+}
+
+template <typename Value>
+typename KVWorker<Value>::Data KVWorker<Value>::SelectTopK(
+		const Data& acc, const Data& slice, double ratio, double threshold, std::vector<bool>* sent) {
+	size_t n = slice.keys.size();
+	size_t k = acc.vals.size() / acc.keys.size();
+	auto mark = [&](Key key) {
+		size_t pos = std::lower_bound(acc.keys.begin(), acc.keys.end(), key) - acc.keys.begin();
+		(*sent)[pos] = true;
+	};
+	size_t top = ratio > 0 ? static_cast<size_t>(std::ceil(ratio * n)) : 0;
+	if (top >= n) {
+		for (Key key : slice.keys) mark(key);
+		return slice;
+	}
+	std::vector<double> score(n, 0);
+	for (size_t i = 0; i < n; ++i) {
+		for (size_t j = 0; j < k; ++j) {
+			score[i] += std::abs(static_cast<double>(slice.vals[i * k + j]));
+		}
+	}
+	// 第 top 大的值为 kth，大于它的全部发送，等于它的发送到凑够 top 个为止
+	double kth = std::numeric_limits<double>::infinity();
+	size_t ties = 0;
+	if (top > 0) {
+		std::vector<double> tmp = score;
+		std::nth_element(tmp.begin(), tmp.begin() + (top - 1), tmp.end(), std::greater<double>());
+		kth = tmp[top - 1];
+		ties = top - std::count_if(score.begin(), score.end(), [kth](double v) { return v > kth; });
+	}
+	std::vector<size_t> chosen;
+	chosen.reserve(top + 1);
+	for (size_t i = 0; i < n; ++i) {
+		if (score[i] == 0) continue;
+		if (score[i] > kth || (score[i] == kth && ties > 0 && ties--) ||
+				(threshold > 0 && score[i] >= threshold)) {
+			chosen.push_back(i);
+		}
+	}
+	if (chosen.empty()) {
+		// 至少发送一个 key，使这个 server 仍然收到请求
+		chosen.push_back(std::max_element(score.begin(), score.end()) - score.begin());
+	}
+	Data out;
+	out.priority = slice.priority;
+	out.keys.resize(chosen.size());
+	out.vals.resize(chosen.size() * k);
+	for (size_t t = 0; t < chosen.size(); ++t) {
+		size_t i = chosen[t];
+		out.keys[t] = slice.keys[i];
+		memcpy(out.vals.data() + t * k, slice.vals.data() + i * k, k * sizeof(Value));
+		mark(slice.keys[i]);
+	}
+	return out;
+}
+
+template <typename Value>
+void KVWorker<Value>::UpdateResidual(const Data& acc, const std::vector<bool>& sent) {
+	size_t n = acc.keys.size(), m = residual_keys_.size();
+	size_t k = residual_k_;
+	std::vector<Key> keys;
+	std::vector<Value> vals;
+	keys.reserve(n + m);
+	vals.reserve((n + m) * k);
+	// 归并：本次 push 中未发送的 value，以及本次没有 push 的 key 原有的残差
+	size_t i = 0, r = 0;
+	while (i < n || r < m) {
+		if (r == m || (i < n && acc.keys[i] <= residual_keys_[r])) {
+			if (i < n && r < m && acc.keys[i] == residual_keys_[r]) ++r;
+			if (!sent[i]) {
+				const Value* v = acc.vals.data() + i * k;
+				if (std::any_of(v, v + k, [](Value x) { return x != Value(); })) {
+					keys.push_back(acc.keys[i]);
+					vals.insert(vals.end(), v, v + k);
+				}
+			}
+			++i;
+		} else {
+			keys.push_back(residual_keys_[r]);
+			vals.insert(vals.end(), residual_vals_.begin() + r * k, residual_vals_.begin() + (r + 1) * k);
+			++r;
+		}
+	}
+	residual_keys_.swap(keys);
+	residual_vals_.swap(vals);
+}
+
+template <typename Value>
+void KVWorker<Value>::SliceHotKeys(SlicedKVs* sliced, std::vector<Data>* replicas) {
+	size_t n = sliced->size();
+	// 发给各 server 的副本访问：(key, 切片, 在切片中的下标)
+	std::vector<std::vector<std::tuple<Key, size_t, size_t>>> moved(n);
+	{
+		std::lock_guard<std::mutex> lk(hot_mu_);
+		if (hot_keys_.empty()) return;
+		int rank = PostOffice::Get()->my_rank();
+		for (size_t i = 0; i < n; ++i) {
+			size_t r = (i + rank) % n;
+			const auto& s = sliced->at(i);
+			if (r == i || !s.first) continue;
+			// 热点 key 很少，逐个在有序的切片中查找
+			const SVector<Key>& keys = s.second.keys;
+			const Key* pos = keys.begin();
+			for (Key key: hot_keys_) {
+				pos = std::lower_bound(pos, keys.end(), key);
+				if (pos == keys.end()) break;
+				if (*pos == key) moved[r].emplace_back(key, i, pos - keys.begin());
+			}
+		}
+	}
+	replicas->assign(n, Data());
+	// 切片 i 中被移出的 key 的下标
+	std::vector<std::vector<size_t>> removed(n);
+	for (size_t r = 0; r < n; ++r) {
+		auto& list = moved[r];
+		if (list.empty()) continue;
+		std::sort(list.begin(), list.end());
+		Data& rep = replicas->at(r);
+		rep.keys.resize(list.size());
+		size_t k = 0;
+		for (size_t t = 0; t < list.size(); ++t) {
+			const auto& [key, i, j] = list[t];
+			const Data& s = sliced->at(i).second;
+			k = s.vals.size() / s.keys.size();
+			if (k && rep.vals.empty()) rep.vals.resize(list.size() * k);
+			rep.keys[t] = key;
+			std::copy_n(s.vals.data() + j * k, k, rep.vals.data() + t * k);
+			removed[i].push_back(j);
+		}
+	}
+	for (size_t i = 0; i < n; ++i) {
+		if (removed[i].empty()) continue;
+		std::sort(removed[i].begin(), removed[i].end());
+		Data& s = sliced->at(i).second;
+		size_t m = s.keys.size(), k = s.vals.size() / m;
+		size_t left = m - removed[i].size();
+		Data rest;
+		rest.priority = s.priority;
+		rest.keys.resize(left);
+		rest.vals.resize(left * k);
+		// 拷贝被移出的 key 之间的各段
+		size_t begin = 0, out = 0;
+		removed[i].push_back(m);
+		for (size_t end: removed[i]) {
+			std::copy(s.keys.data() + begin, s.keys.data() + end, rest.keys.data() + out);
+			std::copy(s.vals.data() + begin * k, s.vals.data() + end * k, rest.vals.data() + out * k);
+			out += end - begin;
+			begin = end + 1;
+		}
+		s = std::move(rest);
+		sliced->at(i).first = left != 0;
+	}
+}
+
+template <typename Value>
+void KVWorker<Value>::AddHotKeys(const Message& msg) {
+	size_t n = msg.meta.body.size() / sizeof(Key);
+	CHECK_EQ(n * sizeof(Key), msg.meta.body.size()) << "invalid hot keys from server " << msg.meta.sender;
+	std::vector<Key> keys(n);
+	memcpy(keys.data(), msg.meta.body.data(), msg.meta.body.size());
+	std::sort(keys.begin(), keys.end());
+	std::lock_guard<std::mutex> lk(hot_mu_);
+	std::vector<Key> merged;
+	merged.reserve(hot_keys_.size() + n);
+	std::set_union(hot_keys_.begin(), hot_keys_.end(), keys.begin(), keys.end(), std::back_inserter(merged));
+	hot_keys_.swap(merged);
+}
+
+template <typename Value>
+void KVWorker<Value>::SliceWithHandle(const Data& kvs, int key_handle, SlicedKVs* sliced) {
+	std::vector<PartPosition> parts;
+	{
+		std::lock_guard<std::mutex> lk(keys_mu_);
+		parts = registered_keys_[key_handle].parts;
+	}
+	size_t n = parts.size();
+	// SVector::Slice 不是 const 的，拷贝 SVector 只增加引用计数
+	SVector<Key> keys = kvs.keys;
+	SVector<Value> vals = kvs.vals;
+	size_t k = vals.size() / keys.size();
+	CHECK_EQ(k * keys.size(), vals.size());
+	sliced->resize(n);
+	for (size_t i = 0; i < n; ++i) {
+		const auto& part = parts[i];
+		auto& s = sliced->at(i);
+		s.first = part.size != 0;
+		if (!s.first) continue;
+		if (part.index.empty()) {
+			s.second.keys = keys.Slice(part.offset, part.offset + part.size);
+			s.second.vals = vals.Slice(part.offset * k, (part.offset + part.size) * k);
+			continue;
+		}
+		// 不连续的切片（如哈希划分）需要按下标取出 key 与 value
+		s.second.keys.resize_uninitialized(part.size);
+		ResizeOutput(&s.second.vals, part.size * k);
+		for (size_t j = 0; j < part.size; ++j) {
+			size_t t = part.index[j];
+			s.second.keys[j] = keys[t];
+			std::copy_n(vals.data() + t * k, k, s.second.vals.data() + j * k);
+		}
+	}
+}
+
+template <typename Value>
+bool KVWorker<Value>::SetPullOffsets(int timestamp, const SVector<Key>& keys,
+										const std::vector<std::vector<Data>>& chunks) {
+	{
+		std::lock_guard<std::mutex> lk(mu_);
+		if (!pull_targets_.count(timestamp)) return false;
+	}
+	std::vector<std::vector<PartPosition>> parts(chunks.size());
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		for (const auto& chunk : chunks[i]) {
+			parts[i].push_back(FindPart(keys, chunk.keys));
+		}
+	}
+	std::lock_guard<std::mutex> lk(mu_);
+	pull_targets_[timestamp].parts = std::move(parts);
+	return true;
+}
+
+template <typename Value>
+typename KVWorker<Value>::PartPosition KVWorker<Value>::FindPart(const SVector<Key>& keys, const SVector<Key>& part) {
+	PartPosition pos;
+	pos.size = part.size();
+	if (part.empty()) return pos;
+	// 区间划分的切片与分块与 keys 共享内存，否则按第一个 key 查找
+	pos.offset = part.data() >= keys.data() && part.data() < keys.data() + keys.size() ?
+			part.data() - keys.data() :
+			std::lower_bound(keys.begin(), keys.end(), part.front()) - keys.begin();
+	CHECK(pos.offset < keys.size() && keys[pos.offset] == part.front()) << "key " << part.front() << " is not requested";
+	if (pos.offset + pos.size <= keys.size() && keys[pos.offset + pos.size - 1] == part.back()) {
+		return pos; // 连续区间
+	}
+	// 有序子序列：顺序扫描一遍
+	pos.index.resize(pos.size);
+	size_t j = pos.offset;
+	for (size_t t = 0; t < pos.size; ++t) {
+		while (j < keys.size() && keys[j] < part[t]) ++j;
+		CHECK(j < keys.size() && keys[j] == part[t]) << "key " << part[t] << " is not requested";
+		pos.index[t] = j++;
+	}
+	return pos;
+}
+
+template <typename Value>
+void KVWorker<Value>::WritePullResponse(PullTarget* target, const Message& msg) {
+	int rank = PostOffice::Get()->IDToRank(msg.meta.sender);
+	CHECK_LT((size_t)rank, target->parts.size());
+	CHECK_LT((size_t)msg.meta.chunk_id, target->parts[rank].size()) << "unexpected chunk from server " << rank;
+	const PartPosition& part = target->parts[rank][msg.meta.chunk_id];
+	size_t num_keys = part.size;
+	if (msg.meta.delta) {
+		// 增量回复只带有改变的 key，其余位置保留缓存的 value（见 RefreshCache）
+		CHECK_NOTNULL(target->out);
+		if (!msg.data.empty()) {
+			SVector<Key> keys = GetKeyData(msg);
+			CHECK_EQ(ValDataCount<Value>(msg), keys.size() * target->k) << "unmatched delta pull response";
+			PartPosition pos = FindPart(target->keys, keys);
+			size_t k = target->k;
+			if (pos.index.empty()) {
+				CopyValData(msg, target->out + pos.offset * k);
+			} else {
+				SVector<Value> vals = GetValData<Value>(msg);
+				for (size_t t = 0; t < keys.size(); ++t) {
+					memcpy(target->out + pos.index[t] * k, vals.data() + t * k, k * sizeof(Value));
+				}
+			}
+		}
+		target->received += num_keys;
+		return;
+	}
+	// 省略 key 的回复即对应请求中的 key
+	size_t n = msg.data[0].empty() ? num_keys : KeyDataCount(msg);
+	CHECK_EQ(n, num_keys) << "unmatched keys size from one server";
+	if (n == 0) return;
+	size_t num_vals = ValDataCount<Value>(msg);
+	if (!target->out) {
+		CHECK_EQ(num_vals % n, 0u) << "pull responses must have the same number of values per key";
+		target->k = num_vals / n;
+		target->out = target->buffer(target->keys.size() * target->k);
+	}
+	CHECK_EQ(num_vals, n * target->k) << "pull responses must have the same number of values per key";
+	size_t k = target->k;
+	if (part.index.empty()) {
+		CopyValData(msg, target->out + part.offset * k);
+	} else {
+		SVector<Value> vals = GetValData<Value>(msg);
+		for (size_t t = 0; t < n; ++t) {
+			memcpy(target->out + part.index[t] * k, vals.data() + t * k, k * sizeof(Value));
+		}
+	}
+	target->received += n;
+}
+
+template <typename Value>
+std::vector<typename KVWorker<Value>::Data> KVWorker<Value>::SplitChunks(const Data& kvs) const {
+	size_t n = kvs.keys.size();
+	size_t num_vals = kvs.vals.empty() ? n : kvs.vals.size();
+	size_t bytes = n * sizeof(Key) + num_vals * sizeof(Value) + kvs.lens.size() * sizeof(int);
+	if (chunk_size_ == 0 || bytes <= chunk_size_ || n < 2) {
+		return {kvs};
+	}
+	size_t num = std::min(n, (bytes + chunk_size_ - 1) / chunk_size_);
+	// SVector::Slice 不是 const 的，拷贝 SVector 只增加引用计数
+	SVector<Key> keys = kvs.keys;
+	SVector<Value> vals = kvs.vals;
+	SVector<int> lens = kvs.lens;
+	size_t k = lens.empty() ? vals.size() / n : 0;
+	std::vector<Data> chunks(num);
+	size_t val_begin = 0;
+	for (size_t c = 0; c < num; ++c) {
+		size_t begin = n * c / num, end = n * (c + 1) / num;
+		Data& chunk = chunks[c];
+		chunk.priority = kvs.priority;
+		chunk.keys = keys.Slice(begin, end);
+		if (lens.size()) {
+			chunk.lens = lens.Slice(begin, end);
+			size_t val_end = val_begin;
+			for (int l : chunk.lens) val_end += l;
+			if (vals.size()) chunk.vals = vals.Slice(val_begin, val_end);
+			val_begin = val_end;
+		} else if (vals.size()) {
+			chunk.vals = vals.Slice(begin * k, end * k);
+		}
+	}
+	return chunks;
+}
+
+template <typename Value>
+template <typename C>
+int KVWorker<Value>::SendWithHandle(KeyHandle handle, bool push, bool pull, const SVector<Value>& vals, C* outs,
+									int cmd, const Callback& cb, int priority) {
+	CHECK(handle.valid()) << "invalid key handle";
+	Data kvs;
+	{
+		std::lock_guard<std::mutex> lk(keys_mu_);
+		CHECK_LT((size_t)handle.id, registered_keys_.size()) << "unknown key handle " << handle.id;
+		kvs.keys = registered_keys_[handle.id].keys;
+	}
+	if (!push && cmd == 0 && cache_capacity_) {
+		int ts = CachedPull(kvs.keys, outs, cb, priority, handle.id);
+		if (ts != -1) return ts;
+	}
+	int ts;
+	if (pull) {
+		ts = AddPullCB(kvs.keys, outs, (std::vector<int>*)nullptr, cmd, cb);
+	} else {
+		ts = customer_->NewRequest(kServerGroup);
+		AddCallback(ts, cb);
+	}
+	kvs.vals = vals;
+	kvs.priority = priority;
+	Send(ts, push, pull, cmd, kvs, handle.id);
+	return ts;
+}
+
+} // namespace ps
+
+// KVServer 的实现需要 ConsistencyController 的完整定义，而它又依赖上面的 KVMeta 与 KVPairs
+#include "../ps/Consistency.h"
@@ -0,0 +1,309 @@
+/**
+ * @file Optimizer.h
+ * @brief server 端内置的优化器 handle：SGD、Adagrad、Adam、FTRL。
+ * 优化器状态与参数存放在一起，应用不需要在自己的 request handle 里再实现一遍更新逻辑。
+ */
+#pragma once
+#include <array>
+#include <cmath>
+#include <vector>
+#include <cstring>
+#include <unordered_map>
+
+#include "../ps/KVApp.h"
+#include "../utility/SIMD.h"
+
+namespace ps {
+
+/**
+ * @brief 随机梯度下降：w -= lr * g
+ */
+template <typename Value>
+struct SGD {
+	/* 每个参数需要额外保存的状态数量 */
+	static constexpr int kNumStates = 0;
+
+	explicit SGD(Value learning_rate = 0.01): learning_rate(learning_rate) {}
+
+	/**
+	 * @brief 每次 push 开始前调用一次。
+	 */
+	void BeginStep() {}
+
+	/**
+	 * @brief 更新一段连续存放的参数。
+	 * @param w 参数
+	 * @param states 各状态数组，states[i] 与 w 一一对应
+	 * @param grad 梯度
+	 * @param n 元素数量
+	 */
+	void Update(Value* w, Value* const* states, const Value* grad, size_t n) const {
+		if constexpr (std::is_same_v<Value, float> || std::is_same_v<Value, double>) {
+			simd::Axpy(w, -learning_rate, grad, n);
+		} else {
+			const Value lr = learning_rate;
+			for (size_t i = 0; i < n; ++i) {
+				w[i] -= lr * grad[i];
+			}
+		}
+	}
+
+	Value learning_rate;
+};
+
+/**
+ * @brief Adagrad：h += g^2; w -= lr * g / (sqrt(h) + eps)
+ */
+template <typename Value>
+struct Adagrad {
+	static constexpr int kNumStates = 1;
+
+	explicit Adagrad(Value learning_rate = 0.01, Value epsilon = 1e-8)
+		: learning_rate(learning_rate), epsilon(epsilon) {}
+
+	void BeginStep() {}
+
+	void Update(Value* w, Value* const* states, const Value* grad, size_t n) const {
+		const Value lr = learning_rate, eps = epsilon;
+		Value* h = states[0];
+		for (size_t i = 0; i < n; ++i) {
+			Value g = grad[i];
+			h[i] += g * g;
+			w[i] -= lr * g / (std::sqrt(h[i]) + eps);
+		}
+	}
+
+	Value learning_rate;
+	Value epsilon;
+};
+
+/**
+ * @brief Adam。
+ * 偏差修正只与步数有关，因此在 BeginStep 中每步计算一次，并合并进步长与 epsilon，
+ * 不需要像逐元素计算那样每个参数调用两次 pow：
+ * lr_t = lr * sqrt(1 - beta2^t) / (1 - beta1^t), eps_t = eps * sqrt(1 - beta2^t)
+ * w -= lr_t * m / (sqrt(v) + eps_t)
+ * 步数 t 为该 handle 收到的 push 次数。
+ */
+template <typename Value>
+struct Adam {
+	static constexpr int kNumStates = 2;
+
+	explicit Adam(Value learning_rate = 0.001, Value beta1 = 0.9, Value beta2 = 0.999, Value epsilon = 1e-8)
+		: learning_rate(learning_rate), beta1(beta1), beta2(beta2), epsilon(epsilon) {}
+
+	void BeginStep() {
+		beta1_pow_ *= beta1;
+		beta2_pow_ *= beta2;
+		double correction = std::sqrt(1 - beta2_pow_);
+		step_size_ = static_cast<Value>(learning_rate * correction / (1 - beta1_pow_));
+		step_epsilon_ = static_cast<Value>(epsilon * correction);
+	}
+
+	void Update(Value* w, Value* const* states, const Value* grad, size_t n) const {
+		const Value b1 = beta1, b2 = beta2, c1 = 1 - beta1, c2 = 1 - beta2;
+		const Value lr = step_size_, eps = step_epsilon_;
+		Value* m = states[0];
+		Value* v = states[1];
+		for (size_t i = 0; i < n; ++i) {
+			Value g = grad[i];
+			m[i] = b1 * m[i] + c1 * g;
+			v[i] = b2 * v[i] + c2 * g * g;
+			w[i] -= lr * m[i] / (std::sqrt(v[i]) + eps);
+		}
+	}
+
+	Value learning_rate;
+	Value beta1;
+	Value beta2;
+	Value epsilon;
+
+ private:
+	/* beta^t，每步累乘一次 */
+	double beta1_pow_{1};
+	double beta2_pow_{1};
+	/* 当前步修正后的步长与 epsilon */
+	Value step_size_{0};
+	Value step_epsilon_{0};
+};
+
+/**
+ * @brief FTRL-Proximal。
+ * 状态为 z、n，参数由 z、n 直接求出：
+ * w = |z| <= l1 ? 0 : -(z - sign(z) * l1) / ((beta + sqrt(n)) / alpha + l2)
+ */
+template <typename Value>
+struct FTRL {
+	static constexpr int kNumStates = 2;
+
+	explicit FTRL(Value alpha = 0.05, Value beta = 1, Value l1 = 1, Value l2 = 1)
+		: alpha(alpha), beta(beta), l1(l1), l2(l2) {}
+
+	void BeginStep() {}
+
+	void Update(Value* w, Value* const* states, const Value* grad, size_t n) const {
+		const Value inv_alpha = 1 / alpha, b = beta, r1 = l1, r2 = l2;
+		Value* z = states[0];
+		Value* nn = states[1];
+		for (size_t i = 0; i < n; ++i) {
+			Value g = grad[i];
+			Value sqrt_old = std::sqrt(nn[i]);
+			nn[i] += g * g;
+			Value sqrt_new = std::sqrt(nn[i]);
+			z[i] += g - (sqrt_new - sqrt_old) * inv_alpha * w[i];
+			Value sign = z[i] < 0 ? -1 : 1;
+			Value shrink = z[i] - sign * r1;
+			Value denom = (b + sqrt_new) * inv_alpha + r2;
+			w[i] = std::abs(z[i]) <= r1 ? 0 : -shrink / denom;
+		}
+	}
+
+	Value alpha;
+	Value beta;
+	Value l1;
+	Value l2;
+};
+
+/**
+ * @brief 使用指定优化器处理 worker 请求的 handle：push 的值视为梯度，用于更新参数；pull 返回当前参数。
+ * 每个 key 对应 val_len 个 value，不支持 lens。未出现过的 key 参数初始为 0。
+ *
+ * 参数与优化器的各状态分别连续存放 (SoA)。key 首次出现时按请求中的顺序分配槽位，
+ * 因此同一批 key 的槽位是连续的，之后的更新会按连续槽位分段，对每段调用一次 Optimizer::Update，
+ * 即一个可以被编译器向量化的简单循环，而不是逐个 key 查找再逐个更新。
+ *
+ * 与 KVServerDefaultHandle 一样，SetRequestHandle 会拷贝 handle。如需在外部访问参数（比如保存模型），
+ * 用 std::ref(handle) 传入。
+ * @tparam Optimizer SGD、Adagrad、Adam、FTRL 或任何提供同样接口的类型
+ */
+template <typename Value, typename Optimizer>
+class KVServerOptimizerHandle {
+ public:
+	explicit KVServerOptimizerHandle(const Optimizer& optimizer = Optimizer(), size_t val_len = 1)
+		: optimizer_(optimizer), val_len_(val_len) {
+		CHECK_GT(val_len_, 0);
+	}
+
+	void operator() (const KVMeta& req_meta, const KVPairs<Value>& req_data, KVServer<Value>* server) {
+		CHECK(req_data.lens.empty()) << "KVServerOptimizerHandle doesn't support lens";
+		size_t n = req_data.keys.size();
+		const std::vector<size_t>& slots = FindSlots(req_data.keys);
+
+		KVPairs<Value> res;
+		if (req_meta.push) {
+			CHECK_EQ(n * val_len_, req_data.vals.size());
+			optimizer_.BeginStep();
+			ForEachRun(slots, [&](size_t i, size_t slot, size_t len) {
+				std::array<Value*, kNumStates + 1> states;
+				for (int s = 0; s < kNumStates; ++s) {
+					states[s] = states_[s].data() + slot * val_len_;
+				}
+				optimizer_.Update(weights_.data() + slot * val_len_, states.data(),
+						req_data.vals.data() + i * val_len_, len * val_len_);
+			});
+		}
+		if (req_meta.pull) {
+			res.keys = req_data.keys;
+			res.vals.resize(n * val_len_);
+			ForEachRun(slots, [&](size_t i, size_t slot, size_t len) {
+				memcpy(res.vals.data() + i * val_len_, weights_.data() + slot * val_len_,
+						len * val_len_ * sizeof(Value));
+			});
+		}
+		server->Response(req_meta, res);
+	}
+
+	/**
+	 * @brief 直接设置若干 key 的参数（比如从已有模型初始化），不经过优化器。
+	 */
+	void Set(const SVector<Key>& keys, const SVector<Value>& vals) {
+		CHECK_EQ(keys.size() * val_len_, vals.size());
+		const std::vector<size_t>& slots = FindSlots(keys);
+		ForEachRun(slots, [&](size_t i, size_t slot, size_t len) {
+			memcpy(weights_.data() + slot * val_len_, vals.data() + i * val_len_,
+					len * val_len_ * sizeof(Value));
+		});
+	}
+
+	/**
+	 * @brief 获取某个 key 的参数。key 不存在时返回 nullptr。
+	 */
+	const Value* Get(Key key) const {
+		auto it = index_.find(key);
+		return it == index_.end() ? nullptr : weights_.data() + it->second * val_len_;
+	}
+
+	size_t size() const {
+		return index_.size();
+	}
+	Optimizer& optimizer() {
+		return optimizer_;
+	}
+
+ private:
+	static constexpr int kNumStates = Optimizer::kNumStates;
+
+	/**
+	 * @brief 获取每个 key 的槽位，为新出现的 key 分配槽位。
+	 * 同一组 key 重复请求时（常见于稠密模型）直接复用上次的结果，不再逐个查找。
+	 */
+	const std::vector<size_t>& FindSlots(const SVector<Key>& keys) {
+		size_t n = keys.size();
+		if (n == last_keys_.size() && n != 0 &&
+				(keys.data() == last_keys_.data() || memcmp(keys.data(), last_keys_.data(), n * sizeof(Key)) == 0)) {
+			return last_slots_;
+		}
+		last_slots_.resize(n);
+		for (size_t i = 0; i < n; ++i) {
+			auto [it, inserted] = index_.try_emplace(keys[i], index_.size());
+			last_slots_[i] = it->second;
+		}
+		if (weights_.size() < index_.size() * val_len_) {
+			weights_.resize(index_.size() * val_len_, 0);
+			for (auto& state: states_) {
+				state.resize(index_.size() * val_len_, 0);
+			}
+		}
+		last_keys_ = keys;
+		return last_slots_;
+	}
+
+	/**
+	 * @brief 将槽位按连续段划分，对每段调用 func(段在请求中的起始下标, 起始槽位, 长度)。
+	 */
+	template <typename Func>
+	static void ForEachRun(const std::vector<size_t>& slots, Func&& func) {
+		size_t n = slots.size();
+		for (size_t i = 0, j; i < n; i = j) {
+			for (j = i + 1; j < n && slots[j] == slots[j - 1] + 1; ++j);
+			func(i, slots[i], j - i);
+		}
+	}
+
+	Optimizer optimizer_;
+	/* 每个 key 的 value 长度 */
+	size_t val_len_;
+
+	/* key -> 槽位 */
+	std::unordered_map<Key, size_t> index_;
+	/* 参数。槽位 i 的参数为 weights_[i*val_len_, (i+1)*val_len_) */
+	std::vector<Value> weights_;
+	/* 优化器状态，与 weights_ 布局相同 */
+	std::array<std::vector<Value>, kNumStates> states_;
+
+	/* 上次请求的 key 及其槽位 */
+	SVector<Key> last_keys_;
+	std::vector<size_t> last_slots_;
+};
+
+/* 常用优化器 handle */
+template <typename Value>
+using KVServerSGDHandle = KVServerOptimizerHandle<Value, SGD<Value>>;
+template <typename Value>
+using KVServerAdagradHandle = KVServerOptimizerHandle<Value, Adagrad<Value>>;
+template <typename Value>
+using KVServerAdamHandle = KVServerOptimizerHandle<Value, Adam<Value>>;
+template <typename Value>
+using KVServerFTRLHandle = KVServerOptimizerHandle<Value, FTRL<Value>>;
+
+} // namespace ps
@@ -9,6 +9,8 @@
 
 #include "../ps/Base.h"
 #include "../ps/KVApp.h"
+#include "../ps/Coroutine.h"
+#include "../ps/Optimizer.h"
 #include "../internal/PostOffice.h"
 
 namespace ps {
@@ -0,0 +1,117 @@
+/**
+ * @file Consistency_test.cpp
+ */
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "../Consistency.h"
+
+using namespace ps;
+using std::vector;
+
+namespace {
+
+/**
+ * @brief 一个 server 上的一致性控制器，记录交给 handle 的请求与发出的回复
+ */
+struct Server {
+	Server(ConsistencyModel model, int staleness, int num_workers)
+		: controller(model, staleness, num_workers,
+				[this](const KVMeta& meta, const KVPairs<float>& data) { handled.emplace_back(meta, data); },
+				[this](const KVMeta& meta, const KVPairs<float>&) { sent.push_back(meta); }) {}
+
+	/**
+	 * @brief worker rank 的第 timestamp 次 push，key 为 keys，value 均为 1
+	 */
+	void Push(int rank, int timestamp, const vector<Key>& keys) {
+		KVMeta meta;
+		meta.cmd = 0;
+		meta.push = true;
+		meta.pull = false;
+		meta.sender = PostOffice::WorkerRankToID(rank);
+		meta.timestamp = timestamp;
+		meta.customer_id = 0;
+		KVPairs<float> data;
+		data.keys = SVector<Key>(keys);
+		data.vals = SVector<float>(keys.size(), 1);
+		controller.OnRequest(meta, data);
+	}
+	void Tick(int rank) {
+		controller.OnTick(PostOffice::WorkerRankToID(rank));
+	}
+	/**
+	 * @brief 模拟 handle 回复第 i 个收到的请求
+	 */
+	void Respond(size_t i) {
+		controller.OnResponse(handled.at(i).first, KVPairs<float>());
+	}
+
+	ConsistencyController<float> controller;
+	vector<std::pair<KVMeta, KVPairs<float>>> handled;
+	vector<KVMeta> sent;
+};
+
+} // namespace
+
+TEST(ConsistencyTest, BSPRoundClosesWithTicks) {
+	// 两个 server，worker 1 的 key 都属于 server 0：server 1 只收到 worker 1 的时钟
+	Server s1(BSP, 0, 2);
+	s1.Push(0, 1, {10, 11});
+	EXPECT_TRUE(s1.handled.empty());
+	s1.Tick(1);
+	ASSERT_EQ(s1.handled.size(), 1u);
+	EXPECT_TRUE(s1.handled[0].first.merged);
+	EXPECT_EQ(s1.handled[0].first.clock, 1);
+	EXPECT_EQ(s1.handled[0].second.keys.size(), 2u);
+	s1.Respond(0);
+	ASSERT_EQ(s1.sent.size(), 1u);
+	EXPECT_EQ(s1.sent[0].sender, PostOffice::WorkerRankToID(0));
+
+	// 时钟先于推送到达
+	s1.Tick(1);
+	s1.Push(0, 2, {10});
+	ASSERT_EQ(s1.handled.size(), 2u);
+	EXPECT_EQ(s1.handled[1].first.clock, 2);
+}
+
+TEST(ConsistencyTest, BSPRoundWithOnlyTicks) {
+	Server s(BSP, 0, 2);
+	// 该轮所有 worker 都没有发给本节点的 key，不调用 handle
+	s.Tick(0);
+	s.Tick(1);
+	EXPECT_TRUE(s.handled.empty());
+	s.Push(0, 2, {1});
+	s.Push(1, 2, {1});
+	ASSERT_EQ(s.handled.size(), 1u);
+	EXPECT_EQ(s.handled[0].first.clock, 2);
+	EXPECT_EQ(s.handled[0].second.vals[0], 2);
+}
+
+TEST(ConsistencyTest, BackupWorkersWithTicks) {
+	// 3 个 worker，1 个备份：worker 2 的时钟使该轮收到足够的推送
+	Server s(BSP, 0, 3);
+	s.controller.SetBackupWorkers(1, true);
+	s.Push(0, 1, {1});
+	EXPECT_TRUE(s.handled.empty());
+	s.Tick(2);
+	ASSERT_EQ(s.handled.size(), 1u);
+	// 迟到的推送被立即回复
+	s.Push(1, 1, {1});
+	EXPECT_EQ(s.controller.late_pushes(), 1);
+	EXPECT_EQ(s.sent.size(), 1u);
+}
+
+TEST(ConsistencyTest, SSPReleasesDeferredOnTick) {
+	Server s1(SSP, 0, 2);
+	s1.Push(0, 1, {10});
+	ASSERT_EQ(s1.handled.size(), 1u);
+	EXPECT_EQ(s1.handled[0].first.clock, 1);
+	// worker 0 领先 worker 1 一个时钟，超过 staleness，回复被推迟
+	s1.Respond(0);
+	EXPECT_TRUE(s1.sent.empty());
+	// worker 1 的 push 发给了其它 server，这里只收到时钟
+	s1.Tick(1);
+	ASSERT_EQ(s1.sent.size(), 1u);
+	EXPECT_EQ(s1.sent[0].sender, PostOffice::WorkerRankToID(0));
+}
@@ -0,0 +1,116 @@
+/**
+ * @file Optimizer_test.cpp
+ */
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include "../Optimizer.h"
+
+using namespace ps;
+using std::vector;
+
+namespace {
+
+constexpr double kEps = 1e-12;
+
+/**
+ * @brief 对单个参数执行一步：BeginStep 后 Update
+ */
+template <typename Optimizer>
+void Step(Optimizer& opt, double* w, vector<double>& states, double g) {
+	vector<double*> ptrs;
+	for (auto& s: states) ptrs.push_back(&s);
+	opt.BeginStep();
+	opt.Update(w, ptrs.data(), &g, 1);
+}
+
+} // namespace
+
+TEST(OptimizerTest, SGD) {
+	SGD<double> opt(0.1);
+	// 足够长，经过 SIMD 的主循环与尾部
+	vector<double> w(19), g(19);
+	for (size_t i = 0; i < w.size(); ++i) {
+		w[i] = i;
+		g[i] = 0.5 * i - 1;
+	}
+	opt.BeginStep();
+	opt.Update(w.data(), nullptr, g.data(), w.size());
+	for (size_t i = 0; i < w.size(); ++i) {
+		EXPECT_NEAR(w[i], i - 0.1 * (0.5 * i - 1), kEps) << i;
+	}
+}
+
+TEST(OptimizerTest, Adagrad) {
+	Adagrad<double> opt(0.1, 0);
+	double w = 0;
+	vector<double> h(1, 0);
+	// h = 4, w = -0.1 * 2 / 2
+	Step(opt, &w, h, 2);
+	EXPECT_NEAR(h[0], 4, kEps);
+	EXPECT_NEAR(w, -0.1, kEps);
+	// h = 5, w -= 0.1 * 1 / sqrt(5)
+	Step(opt, &w, h, 1);
+	EXPECT_NEAR(h[0], 5, kEps);
+	EXPECT_NEAR(w, -0.1447213595499958, kEps);
+}
+
+TEST(OptimizerTest, Adam) {
+	Adam<double> opt(0.1, 0.5, 0.75, 0);
+	double w = 0;
+	vector<double> mv(2, 0);
+	// m = 1, v = 1，修正后 m = 2, v = 4，w = -0.1 * 2 / 2
+	Step(opt, &w, mv, 2);
+	EXPECT_NEAR(mv[0], 1, kEps);
+	EXPECT_NEAR(mv[1], 1, kEps);
+	EXPECT_NEAR(w, -0.1, kEps);
+	// m = 1, v = 1，修正后 m = 1 / 0.75, v = 1 / 0.4375，w -= 0.1 * sqrt(0.4375) / 0.75
+	Step(opt, &w, mv, 1);
+	EXPECT_NEAR(mv[0], 1, kEps);
+	EXPECT_NEAR(mv[1], 1, kEps);
+	EXPECT_NEAR(w, -0.1881917103688197, kEps);
+}
+
+TEST(OptimizerTest, AdamEpsilon) {
+	// 合并进步长的 epsilon 与逐元素修正时加在 sqrt(v_hat) 上的 epsilon 等价
+	const double lr = 0.01, b1 = 0.9, b2 = 0.999, eps = 0.1;
+	Adam<double> opt(lr, b1, b2, eps);
+	double w = 0, expected = 0, m = 0, v = 0;
+	vector<double> mv(2, 0);
+	for (int t = 1; t <= 5; ++t) {
+		double g = 0.3 * t - 1;
+		Step(opt, &w, mv, g);
+		m = b1 * m + (1 - b1) * g;
+		v = b2 * v + (1 - b2) * g * g;
+		double m_hat = m / (1 - std::pow(b1, t)), v_hat = v / (1 - std::pow(b2, t));
+		expected -= lr * m_hat / (std::sqrt(v_hat) + eps);
+		EXPECT_NEAR(w, expected, kEps) << t;
+	}
+}
+
+TEST(OptimizerTest, FTRL) {
+	FTRL<double> opt(1, 1, 1, 0);
+	double w = 0;
+	vector<double> zn(2, 0);
+	// n = 4, z = 2, w = -(2 - 1) / (1 + 2)
+	Step(opt, &w, zn, 2);
+	EXPECT_NEAR(zn[0], 2, kEps);
+	EXPECT_NEAR(zn[1], 4, kEps);
+	EXPECT_NEAR(w, -1.0 / 3, kEps);
+	// n = 5, z = 2 + 1 + (sqrt(5) - 2) / 3, w = -(z - 1) / (1 + sqrt(5))
+	Step(opt, &w, zn, 1);
+	EXPECT_NEAR(zn[0], 3.0786893258332633, kEps);
+	EXPECT_NEAR(zn[1], 5, kEps);
+	EXPECT_NEAR(w, -0.6423503277082807, kEps);
+	Step(opt, &w, zn, -3);
+	EXPECT_NEAR(zn[0], 1.0458051762746314, kEps);
+	EXPECT_NEAR(zn[1], 14, kEps);
+	EXPECT_NEAR(w, -0.009660161529678905, kEps);
+	// |z| <= l1 时参数为 0
+	Step(opt, &w, zn, -0.5);
+	EXPECT_NEAR(zn[0], 0.5461264716132026, kEps);
+	EXPECT_NEAR(zn[1], 14.25, kEps);
+	EXPECT_EQ(w, 0);
+}
@@ -0,0 +1,112 @@
+/**
+ * @file BufferPool.h
+ * @brief 复用接收、回复缓冲区的内存池。
+ */
+#pragma once
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <type_traits>
+
+#include "../utility/SVector.h"
+
+namespace ps {
+
+/**
+ * @brief 按 2 的幂分级缓存释放的缓冲区。
+ * Get 返回的 SVector 在最后一个引用释放时，将内存归还到池中（池中已缓存的字节数超过上限时直接释放）。
+ * 归还可能发生在任意线程，因此是线程安全的；缓冲区可以比 BufferPool 存在更久。
+ * 加入 Message 发送的缓冲区由 Van 持有引用直到传输层用完（如 ZMQVan 在 ZMQ 的释放回调中释放），之后才会归还，
+ * 因此不会被仍在发送的消息使用。
+ */
+class BufferPool {
+ public:
+	/* 最小的缓冲区大小，更小的请求也分配这么多 */
+	static constexpr size_t kMinSize = 4096;
+
+	/**
+	 * @param max_cached_bytes 池中最多缓存的字节数
+	 */
+	explicit BufferPool(size_t max_cached_bytes = 64 << 20)
+			: state_(std::make_shared<State>()) {
+		state_->max_cached = max_cached_bytes;
+	}
+
+	/**
+	 * @brief 获取一个有 size 个元素的缓冲区，内容未初始化
+	 * @tparam T 元素类型，只支持平凡类型
+	 */
+	template <typename T = char>
+	SVector<T> Get(size_t size) {
+		static_assert(std::is_trivial_v<T>, "BufferPool only supports trivial types");
+		int level = Level(size * sizeof(T));
+		char* buf = nullptr;
+		{
+			std::lock_guard<std::mutex> lk(state_->mu);
+			auto& list = state_->free[level];
+			if (!list.empty()) {
+				buf = list.back();
+				list.pop_back();
+				state_->cached -= kMinSize << level;
+				++state_->hits;
+			}
+		}
+		if (!buf) buf = new char[kMinSize << level];
+		// new char[] 的对齐满足大小不超过它的任何基本类型
+		SVector<T> out;
+		out.reset(reinterpret_cast<T*>(buf), size,
+				[state = state_, level](T* p) { state->Put(reinterpret_cast<char*>(p), level); });
+		return out;
+	}
+
+	/**
+	 * @brief 由池中缓存的内存满足的请求数
+	 */
+	size_t hits() const {
+		std::lock_guard<std::mutex> lk(state_->mu);
+		return state_->hits;
+	}
+
+ private:
+	/* 可能比 BufferPool 存在更久（被未释放的缓冲区引用），因此单独保存 */
+	struct State {
+		~State() {
+			for (auto& list: free) {
+				for (char* p: list) delete[] p;
+			}
+		}
+
+		void Put(char* p, int level) {
+			{
+				std::lock_guard<std::mutex> lk(mu);
+				if (cached + (kMinSize << level) <= max_cached) {
+					free[level].push_back(p);
+					cached += kMinSize << level;
+					return;
+				}
+			}
+			delete[] p;
+		}
+
+		mutable std::mutex mu;
+		/* free[i] 为大小 kMinSize << i 的空闲缓冲区 */
+		std::vector<char*> free[48];
+		size_t cached{0};
+		size_t max_cached{0};
+		size_t hits{0};
+	};
+
+	/**
+	 * @brief 能容纳 size 的最小级别
+	 */
+	static int Level(size_t size) {
+		int level = 0;
+		while ((kMinSize << level) < size) ++level;
+		return level;
+	}
+
+	std::shared_ptr<State> state_;
+};
+
+} // namespace ps
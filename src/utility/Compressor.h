@@ -0,0 +1,266 @@
+/**
+ * @file Compressor.h
+ * @brief Van 发送消息时对数据帧使用的压缩算法。
+ *
+ * Compressor 为压缩算法的接口，可以通过 Van::SetCompressor 替换；内置的 LZCompressor 是一个类似 LZ4 的快速 LZ77 压缩。
+ *
+ * LZCompressor 的格式与 LZ4 block 相同的思路：由若干 sequence 组成，每个 sequence 为
+ * [token: 1B，高 4 位为字面量长度，低 4 位为匹配长度 - kMinMatch][字面量长度的扩展字节][字面量][offset: 2B][匹配长度的扩展字节]
+ * 长度为 15 时后接扩展字节，每个扩展字节加到长度上，直到某个字节小于 255。最后一个 sequence 只有字面量，没有 offset。
+ * 匹配使用 4 字节哈希查找，窗口为 64KB。
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <algorithm>
+
+namespace ps {
+
+/**
+ * @brief 压缩算法的接口。实现需要是无状态的（或自行保证线程安全），可能被多个线程同时调用。
+ */
+class Compressor {
+ public:
+	virtual ~Compressor() = default;
+
+	/**
+	 * @brief 创建指定类型的 Compressor。目前支持 "lz"，不支持的类型返回 nullptr。
+	 */
+	static Compressor* Create(const std::string& type);
+
+	/**
+	 * @brief 算法名称
+	 */
+	virtual const char* name() const = 0;
+	/**
+	 * @brief 压缩 size 字节需要的输出缓冲区大小
+	 */
+	virtual size_t MaxCompressedSize(size_t size) const = 0;
+	/**
+	 * @brief size 字节的压缩结果最多能解压出的字节数。用于检查收到的原始大小，避免按错误的大小分配内存
+	 */
+	virtual size_t MaxDecompressedSize(size_t size) const = 0;
+	/**
+	 * @brief 压缩
+	 * @param dst 输出缓冲区，大小至少为 MaxCompressedSize(size)
+	 * @return 压缩结果的字节数
+	 */
+	virtual size_t Compress(const char* src, size_t size, char* dst) const = 0;
+	/**
+	 * @brief 解压
+	 * @param raw_size 原始数据的字节数（由调用者保存），dst 的大小
+	 * @return 数据格式错误时返回 false
+	 */
+	virtual bool Decompress(const char* src, size_t size, char* dst, size_t raw_size) const = 0;
+};
+
+/**
+ * @brief 内置的 LZ77 压缩，见文件说明。
+ */
+class LZCompressor: public Compressor {
+ public:
+	/* 最短匹配长度 */
+	static constexpr size_t kMinMatch = 4;
+	/* 最大 offset */
+	static constexpr size_t kMaxOffset = 65535;
+	/* 哈希表大小为 2^kHashLog */
+	static constexpr int kHashLog = 14;
+	/* 末尾这么多字节只作为字面量，使查找匹配时总能读取 8 字节 */
+	static constexpr size_t kLastLiterals = 12;
+
+	const char* name() const override { return "lz"; }
+
+	size_t MaxCompressedSize(size_t size) const override {
+		return size + size / 255 + 16;
+	}
+
+	size_t MaxDecompressedSize(size_t size) const override {
+		// 每个扩展字节最多表示 255 字节的长度，token 与 offset 表示的更少
+		return size * 255 + 16;
+	}
+
+	size_t Compress(const char* src, size_t size, char* dst) const override {
+		const uint8_t* const base = reinterpret_cast<const uint8_t*>(src);
+		const uint8_t* const end = base + size;
+		uint8_t* op = reinterpret_cast<uint8_t*>(dst);
+		// dst 的大小至少为 MaxCompressedSize(size)，离末尾足够远时可以多写
+		uint8_t* const ocap = op + MaxCompressedSize(size);
+		const uint8_t* anchor = base;
+		if (size > kLastLiterals + kMinMatch) {
+			uint32_t table[1 << kHashLog] = {};
+			const uint8_t* const match_limit = end - kLastLiterals;
+			const uint8_t* ip = base + 1;
+			// 连续找不到匹配时加大步长，快速跳过不可压缩的数据
+			uint32_t misses = 1 << 6;
+			while (ip < match_limit) {
+				uint32_t seq = Load32(ip);
+				uint32_t h = Hash(seq);
+				const uint8_t* ref = base + table[h];
+				table[h] = static_cast<uint32_t>(ip - base);
+				if (ref >= ip || static_cast<size_t>(ip - ref) > kMaxOffset || Load32(ref) != seq) {
+					ip += misses++ >> 6;
+					continue;
+				}
+				misses = 1 << 6;
+				// 向前扩展匹配
+				while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+					--ip;
+					--ref;
+				}
+				// 向后扩展匹配，每次比较 8 字节
+				const uint8_t* const min_end = ip + kMinMatch;
+				const uint8_t* mp = min_end;
+				const uint8_t* mr = ref + kMinMatch;
+				while (mp < match_limit) {
+					uint64_t diff = Load64(mp) ^ Load64(mr);
+					if (diff) {
+						mp += __builtin_ctzll(diff) >> 3;
+						break;
+					}
+					mp += 8;
+					mr += 8;
+				}
+				mp = std::max(min_end, std::min(mp, match_limit));
+				op = WriteSequence(op, ocap, anchor, end, ip - anchor, ip - ref, mp - ip - kMinMatch);
+				// 匹配内部的位置也加入哈希表，提高之后的命中率
+				if (mp - 2 > ip) {
+					table[Hash(Load32(mp - 2))] = static_cast<uint32_t>(mp - 2 - base);
+				}
+				ip = anchor = mp;
+			}
+		}
+		// 剩余部分作为最后一个 sequence 的字面量
+		size_t lit = end - anchor;
+		*op++ = static_cast<uint8_t>(std::min<size_t>(lit, 15) << 4);
+		if (lit >= 15) op = WriteExtra(op, lit - 15);
+		memcpy(op, anchor, lit);
+		op += lit;
+		return op - reinterpret_cast<uint8_t*>(dst);
+	}
+
+	bool Decompress(const char* src, size_t size, char* dst, size_t raw_size) const override {
+		const uint8_t* ip = reinterpret_cast<const uint8_t*>(src);
+		const uint8_t* const iend = ip + size;
+		uint8_t* const obase = reinterpret_cast<uint8_t*>(dst);
+		uint8_t* op = obase;
+		uint8_t* const oend = obase + raw_size;
+		while (ip < iend) {
+			uint8_t token = *ip++;
+			size_t lit = token >> 4;
+			if (lit == 15 && !ReadLength(&ip, iend, &lit)) return false;
+			if (lit > static_cast<size_t>(iend - ip) || lit > static_cast<size_t>(oend - op)) return false;
+			if (RoundUp16(lit) <= static_cast<size_t>(std::min(iend - ip, oend - op))) {
+				// 离末尾足够远时按 16 字节复制，多写的部分会被之后的内容覆盖
+				WildCopy16(op, ip, lit);
+			} else {
+				memcpy(op, ip, lit);
+			}
+			ip += lit;
+			op += lit;
+			if (ip == iend) break; // 最后一个 sequence
+			if (iend - ip < 2) return false;
+			size_t offset = ip[0] | (ip[1] << 8);
+			ip += 2;
+			size_t len = token & 15;
+			if (len == 15 && !ReadLength(&ip, iend, &len)) return false;
+			len += kMinMatch;
+			if (offset == 0 || offset > static_cast<size_t>(op - obase) || len > static_cast<size_t>(oend - op)) {
+				return false;
+			}
+			const uint8_t* ref = op - offset;
+			if (offset >= 16 && RoundUp16(len) <= static_cast<size_t>(oend - op)) {
+				// 每 16 字节的来源都在目标之前，已经写好
+				WildCopy16(op, ref, len);
+			} else if (offset >= len) {
+				memcpy(op, ref, len);
+			} else {
+				// 与输出重叠（重复的模式）：已输出的部分是以 offset 为周期的，每次可以复制的长度翻倍
+				size_t copied = 0, step = offset;
+				while (copied < len) {
+					size_t n = std::min(step, len - copied);
+					memcpy(op + copied, op + copied - step, n);
+					copied += n;
+					step *= 2;
+				}
+			}
+			op += len;
+		}
+		return op == oend;
+	}
+
+ private:
+	static uint32_t Load32(const uint8_t* p) {
+		uint32_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+	static uint64_t Load64(const uint8_t* p) {
+		uint64_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+	static uint32_t Hash(uint32_t seq) {
+		return (seq * 2654435761u) >> (32 - kHashLog);
+	}
+
+	static size_t RoundUp16(size_t n) {
+		return (n + 15) & ~size_t(15);
+	}
+	/**
+	 * @brief 以 16 字节为单位复制 n 个字节，会写入 RoundUp16(n) 个字节
+	 */
+	static void WildCopy16(uint8_t* dst, const uint8_t* src, size_t n) {
+		for (size_t i = 0; i < n; i += 16) {
+			memcpy(dst + i, src + i, 16);
+		}
+	}
+
+	static uint8_t* WriteExtra(uint8_t* op, size_t len) {
+		for (; len >= 255; len -= 255) *op++ = 255;
+		*op++ = static_cast<uint8_t>(len);
+		return op;
+	}
+	static bool ReadLength(const uint8_t** ip, const uint8_t* iend, size_t* len) {
+		uint8_t b;
+		do {
+			if (*ip == iend) return false;
+			b = *(*ip)++;
+			*len += b;
+		} while (b == 255);
+		return true;
+	}
+
+	/**
+	 * @brief 写入一个 sequence
+	 * @param end 源数据的末尾，按固定长度复制字面量时不会读到它之后
+	 * @param match_len 匹配长度 - kMinMatch
+	 */
+	static uint8_t* WriteSequence(uint8_t* op, uint8_t* ocap, const uint8_t* lit, const uint8_t* end,
+			size_t lit_len, size_t offset, size_t match_len) {
+		uint8_t* token = op++;
+		*token = static_cast<uint8_t>((std::min<size_t>(lit_len, 15) << 4) | std::min<size_t>(match_len, 15));
+		if (lit_len >= 15) op = WriteExtra(op, lit_len - 15);
+		if (lit_len <= 16 && ocap - op >= 16 && end - lit >= 16) {
+			// 短字面量按固定长度复制，多写的部分会被之后的内容覆盖
+			memcpy(op, lit, 16);
+		} else {
+			memcpy(op, lit, lit_len);
+		}
+		op += lit_len;
+		*op++ = static_cast<uint8_t>(offset);
+		*op++ = static_cast<uint8_t>(offset >> 8);
+		if (match_len >= 15) op = WriteExtra(op, match_len - 15);
+		return op;
+	}
+};
+
+inline Compressor* Compressor::Create(const std::string& type) {
+	if (type == "lz") {
+		return new LZCompressor();
+	}
+	return nullptr;
+}
+
+} // namespace ps
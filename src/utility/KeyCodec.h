@@ -0,0 +1,166 @@
+/**
+ * @file KeyCodec.h
+ * @brief 有序 key 的差分位压缩编码。
+ * 请求中的 key 唯一且升序，相邻 key 之差通常远小于 2^64，因此只保存差值，并按块用固定位宽紧凑存放。
+ *
+ * 格式（小端）：
+ * [key 数量 n: 8B][第一个 key: 8B]
+ * 之后的 n-1 个差值 d[i] = key[i] - key[i-1] - 1 每 kBlockSize 个一块，每块为
+ * [位宽 b: 1B][cnt*b 位，按位紧密排列，向上取整到字节]，b 为块内最大差值的位数（连续的 key 为 0）
+ * 末尾另有 kPadding 个字节的填充，使解码时总能按 8 字节读取，不需要处理边界。
+ *
+ * 同一块内位宽固定，没有 varint 那样逐个值的续位判断，解包是一个没有分支的循环，可以被编译器向量化；
+ * 差值的前缀和在解包之后单独计算。
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+namespace ps {
+namespace keycodec {
+
+/* 每块的差值数量 */
+constexpr size_t kBlockSize = 128;
+/* 头部长度：key 数量与第一个 key */
+constexpr size_t kHeaderSize = 16;
+/* 编码结果末尾的填充字节数 */
+constexpr size_t kPadding = 8;
+
+namespace detail {
+
+inline uint64_t Load64(const char* p) {
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+inline void Store64(char* p, uint64_t v) {
+	memcpy(p, &v, sizeof(v));
+}
+inline int BitWidth(uint64_t v) {
+	int b = 0;
+	while (v) {
+		++b;
+		v >>= 1;
+	}
+	return b;
+}
+
+} // namespace detail
+
+/**
+ * @brief 编码 n 个 key 最多需要的字节数（Encode 的输出缓冲区大小）。
+ */
+inline size_t MaxEncodedSize(size_t n) {
+	size_t blocks = n > 1 ? (n - 1 + kBlockSize - 1) / kBlockSize : 0;
+	return kHeaderSize + blocks * (1 + kBlockSize * 8) + kPadding;
+}
+
+/**
+ * @brief 编码严格升序的 key。
+ * @param out 输出缓冲区，大小至少为 MaxEncodedSize(n)
+ * @return 编码结果的字节数
+ */
+inline size_t Encode(const uint64_t* keys, size_t n, char* out) {
+	detail::Store64(out, n);
+	detail::Store64(out + 8, n ? keys[0] : 0);
+	size_t pos = kHeaderSize;
+	uint64_t delta[kBlockSize];
+	for (size_t start = 1; start < n; start += kBlockSize) {
+		size_t cnt = std::min(kBlockSize, n - start);
+		uint64_t max_delta = 0;
+		for (size_t j = 0; j < cnt; ++j) {
+			delta[j] = keys[start + j] - keys[start + j - 1] - 1;
+			max_delta |= delta[j];
+		}
+		int b = detail::BitWidth(max_delta);
+		out[pos++] = static_cast<char>(b);
+		size_t bytes = (cnt * b + 7) / 8;
+		if (b) {
+			// 在 64 位累加器中拼接，满 64 位写出一次
+			char* q = out + pos;
+			uint64_t acc = 0;
+			int fill = 0;
+			for (size_t j = 0; j < cnt; ++j) {
+				acc |= delta[j] << fill;
+				fill += b;
+				if (fill >= 64) {
+					detail::Store64(q, acc);
+					q += 8;
+					fill -= 64;
+					acc = fill ? delta[j] >> (b - fill) : 0;
+				}
+			}
+			// 剩余不足 64 位，写出 8 字节，多出的部分会被下一块覆盖或落在填充中
+			detail::Store64(q, acc);
+		}
+		pos += bytes;
+	}
+	memset(out + pos, 0, kPadding);
+	return pos + kPadding;
+}
+
+/**
+ * @brief 读取编码中 key 的数量。
+ * @return 格式错误时返回 false
+ */
+inline bool DecodedSize(const char* data, size_t size, size_t* n) {
+	if (size < kHeaderSize + kPadding) return false;
+	*n = detail::Load64(data);
+	return true;
+}
+
+/**
+ * @brief 解码。
+ * @param out 输出，大小至少为 DecodedSize 得到的数量
+ * @return 格式错误时返回 false
+ */
+inline bool Decode(const char* data, size_t size, uint64_t* out) {
+	size_t n;
+	if (!DecodedSize(data, size, &n)) return false;
+	if (n == 0) return true;
+	uint64_t prev = detail::Load64(data + 8);
+	out[0] = prev;
+	size_t pos = kHeaderSize;
+	uint64_t delta[kBlockSize];
+	for (size_t start = 1; start < n; start += kBlockSize) {
+		size_t cnt = std::min(kBlockSize, n - start);
+		if (pos >= size) return false;
+		int b = static_cast<unsigned char>(data[pos++]);
+		if (b > 64) return false;
+		size_t bytes = (cnt * b + 7) / 8;
+		if (pos + bytes + kPadding > size) return false;
+		const char* p = data + pos;
+		if (b == 0) {
+			std::fill(delta, delta + cnt, 0);
+		} else if (b <= 56) {
+			// 一个值最多跨越 8 个字节，一次读取即可
+			const uint64_t mask = (uint64_t(1) << b) - 1;
+			for (size_t j = 0; j < cnt; ++j) {
+				size_t bit = j * b;
+				delta[j] = (detail::Load64(p + (bit >> 3)) >> (bit & 7)) & mask;
+			}
+		} else {
+			const uint64_t mask = b == 64 ? ~uint64_t(0) : (uint64_t(1) << b) - 1;
+			for (size_t j = 0; j < cnt; ++j) {
+				size_t bit = j * b;
+				size_t shift = bit & 7;
+				uint64_t v = detail::Load64(p + (bit >> 3)) >> shift;
+				if (shift + b > 64) {
+					v |= detail::Load64(p + (bit >> 3) + 8) << (64 - shift);
+				}
+				delta[j] = v & mask;
+			}
+		}
+		for (size_t j = 0; j < cnt; ++j) {
+			prev += delta[j] + 1;
+			out[start + j] = prev;
+		}
+		pos += bytes;
+	}
+	return pos + kPadding == size;
+}
+
+} // namespace keycodec
+} // namespace ps
@@ -0,0 +1,276 @@
+/**
+ * @file Quantize.h
+ * @brief 传输 value 时使用的低精度编码：FP16、BF16，以及按块缩放、随机舍入的 INT8。
+ *
+ * 格式（小端）：
+ * - FP16 / BF16：每个值 2 字节。FP16 与 BF16 均为就近舍入（ties to even）。
+ * - INT8：[值的数量 n: 8B][每块的缩放系数: ceil(n / kInt8BlockSize) 个 float][n 个 int8]
+ *   每块的缩放系数为 max|x| / 127，q = floor(x / scale + u)，u 为 [0, 1) 上的均匀随机数，
+ *   即随机舍入，E[q * scale] = x，多次 push 累加的梯度没有系统偏差。
+ */
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+
+#include "../utility/SIMD.h"
+
+#if PS_SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+#define PS_TARGET_F16C __attribute__((target("avx2,f16c")))
+#else
+#define PS_TARGET_F16C
+#endif
+
+namespace ps {
+namespace quantize {
+
+/**
+ * @brief value 的编码方式
+ */
+enum Codec: int {
+	NONE, FP16, BF16, INT8
+};
+inline const char* const CodecName[] = {
+	"NONE", "FP16", "BF16", "INT8"
+};
+
+/* INT8 中共用一个缩放系数的值的数量 */
+constexpr size_t kInt8BlockSize = 256;
+
+namespace detail {
+
+inline uint32_t FloatBits(float f) {
+	uint32_t u;
+	memcpy(&u, &f, sizeof(u));
+	return u;
+}
+inline float BitsFloat(uint32_t u) {
+	float f;
+	memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+/**
+ * @brief float -> half，就近舍入。
+ * https://gist.github.com/rygorous/2156668 (float_to_half_fast3_rtne)
+ */
+inline uint16_t FloatToHalf(float f) {
+	uint32_t u = FloatBits(f);
+	uint32_t sign = u & 0x80000000u;
+	u ^= sign;
+	uint32_t o;
+	if (u >= (127u + 16) << 23) {
+		// 溢出为 Inf，NaN 保持为 NaN
+		o = u > 255u << 23 ? 0x7e00 : 0x7c00;
+	} else if (u < 113u << 23) {
+		// 结果为非规格化数或 0：加上 0.5 由浮点加法完成舍入
+		const float magic = BitsFloat(126u << 23);
+		o = FloatBits(BitsFloat(u) + magic) - (126u << 23);
+	} else {
+		uint32_t mant_odd = (u >> 13) & 1;
+		u += ((15u - 127u) << 23) + 0xfff + mant_odd;
+		o = u >> 13;
+	}
+	return static_cast<uint16_t>(o | (sign >> 16));
+}
+
+/**
+ * @brief half -> float
+ */
+inline float HalfToFloat(uint16_t h) {
+	const uint32_t shifted_exp = 0x7c00u << 13;
+	uint32_t o = (h & 0x7fffu) << 13;
+	uint32_t exp = o & shifted_exp;
+	o += (127u - 15) << 23;
+	float f;
+	if (exp == shifted_exp) {
+		// Inf/NaN
+		f = BitsFloat(o + ((128u - 16) << 23));
+	} else if (exp == 0) {
+		// 0 或非规格化数
+		f = BitsFloat(o + (1u << 23)) - BitsFloat(113u << 23);
+	} else {
+		f = BitsFloat(o);
+	}
+	return BitsFloat(FloatBits(f) | ((h & 0x8000u) << 16));
+}
+
+/**
+ * @brief float -> bfloat16，就近舍入
+ */
+inline uint16_t FloatToBF16(float f) {
+	uint32_t u = FloatBits(f);
+	if ((u & 0x7fffffffu) > 0x7f800000u) {
+		return static_cast<uint16_t>((u >> 16) | 0x40);
+	}
+	return static_cast<uint16_t>((u + 0x7fff + ((u >> 16) & 1)) >> 16);
+}
+inline float BF16ToFloat(uint16_t h) {
+	return BitsFloat(static_cast<uint32_t>(h) << 16);
+}
+
+/**
+ * @brief 由种子和下标得到 [0, 1) 上的均匀随机数。只用 32 位乘法，循环可以向量化
+ */
+inline float Uniform(uint32_t seed, uint32_t i) {
+	uint32_t h = seed ^ (i * 0x9e3779b9u);
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	h ^= h >> 16;
+	return (h >> 8) * (1.0f / 16777216);
+}
+
+#if PS_SIMD_X86
+PS_TARGET_F16C inline void FloatToHalfF16C(const float* src, size_t n, uint16_t* dst) {
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+	}
+	for (; i < n; ++i) dst[i] = FloatToHalf(src[i]);
+}
+PS_TARGET_F16C inline void HalfToFloatF16C(const uint16_t* src, size_t n, float* dst) {
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		_mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+	}
+	for (; i < n; ++i) dst[i] = HalfToFloat(src[i]);
+}
+#endif
+
+/**
+ * @brief 是否使用 F16C 指令转换 FP16。支持 AVX2 的 CPU 均支持 F16C
+ */
+inline bool UseF16C() {
+#if PS_SIMD_X86
+	static const bool use = simd::DetectIsa() >= simd::AVX2;
+	return use;
+#else
+	return false;
+#endif
+}
+
+} // namespace detail
+
+/**
+ * @brief 编码 n 个值需要的字节数
+ */
+inline size_t EncodedSize(Codec codec, size_t n) {
+	switch (codec) {
+		case FP16:
+		case BF16:
+			return n * 2;
+		case INT8:
+			return 8 + (n + kInt8BlockSize - 1) / kInt8BlockSize * sizeof(float) + n;
+		default:
+			return 0;
+	}
+}
+
+/**
+ * @brief 由编码结果得到值的数量
+ * @return 格式错误时返回 false
+ */
+inline bool DecodedCount(Codec codec, const char* data, size_t size, size_t* n) {
+	switch (codec) {
+		case FP16:
+		case BF16:
+			*n = size / 2;
+			return size % 2 == 0;
+		case INT8:
+			if (size < 8) return false;
+			memcpy(n, data, sizeof(uint64_t));
+			return EncodedSize(INT8, *n) == size;
+		default:
+			return false;
+	}
+}
+
+/**
+ * @brief 编码。T 为 float 或 double（double 先转换为 float）。
+ * @param out 输出缓冲区，大小为 EncodedSize(codec, n)
+ * @param seed INT8 随机舍入使用的种子，每次编码应当不同
+ */
+template <typename T>
+void Encode(Codec codec, const T* src, size_t n, char* out, uint32_t seed = 0) {
+	static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>);
+	if (codec == FP16) {
+		uint16_t* dst = reinterpret_cast<uint16_t*>(out);
+#if PS_SIMD_X86
+		if constexpr (std::is_same_v<T, float>) {
+			if (detail::UseF16C()) {
+				detail::FloatToHalfF16C(src, n, dst);
+				return;
+			}
+		}
+#endif
+		for (size_t i = 0; i < n; ++i) dst[i] = detail::FloatToHalf(static_cast<float>(src[i]));
+	} else if (codec == BF16) {
+		uint16_t* dst = reinterpret_cast<uint16_t*>(out);
+		for (size_t i = 0; i < n; ++i) dst[i] = detail::FloatToBF16(static_cast<float>(src[i]));
+	} else if (codec == INT8) {
+		uint64_t count = n;
+		memcpy(out, &count, sizeof(count));
+		size_t blocks = (n + kInt8BlockSize - 1) / kInt8BlockSize;
+		float* scales = reinterpret_cast<float*>(out + 8);
+		int8_t* q = reinterpret_cast<int8_t*>(out + 8 + blocks * sizeof(float));
+		for (size_t b = 0; b < blocks; ++b) {
+			size_t begin = b * kInt8BlockSize, end = std::min(n, begin + kInt8BlockSize);
+			float max_abs = 0;
+			for (size_t i = begin; i < end; ++i) {
+				max_abs = std::max(max_abs, std::abs(static_cast<float>(src[i])));
+			}
+			float scale = max_abs / 127;
+			float inv = max_abs > 0 ? 127 / max_abs : 0;
+			scales[b] = scale;
+			for (size_t i = begin; i < end; ++i) {
+				// floor 用截断加修正实现，不调用 libm，循环可以向量化
+				float v = static_cast<float>(src[i]) * inv + detail::Uniform(seed, i);
+				int t = static_cast<int>(v);
+				t -= v < static_cast<float>(t);
+				q[i] = static_cast<int8_t>(std::min(127, std::max(-127, t)));
+			}
+		}
+	}
+}
+
+/**
+ * @brief 解码 n 个值（n 由 DecodedCount 得到）
+ */
+template <typename T>
+void Decode(Codec codec, const char* data, size_t n, T* out) {
+	static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>);
+	if (codec == FP16) {
+		const uint16_t* src = reinterpret_cast<const uint16_t*>(data);
+#if PS_SIMD_X86
+		if constexpr (std::is_same_v<T, float>) {
+			if (detail::UseF16C()) {
+				detail::HalfToFloatF16C(src, n, out);
+				return;
+			}
+		}
+#endif
+		for (size_t i = 0; i < n; ++i) out[i] = detail::HalfToFloat(src[i]);
+	} else if (codec == BF16) {
+		const uint16_t* src = reinterpret_cast<const uint16_t*>(data);
+		for (size_t i = 0; i < n; ++i) out[i] = detail::BF16ToFloat(src[i]);
+	} else if (codec == INT8) {
+		size_t blocks = (n + kInt8BlockSize - 1) / kInt8BlockSize;
+		const float* scales = reinterpret_cast<const float*>(data + 8);
+		const int8_t* q = reinterpret_cast<const int8_t*>(data + 8 + blocks * sizeof(float));
+		for (size_t b = 0; b < blocks; ++b) {
+			size_t begin = b * kInt8BlockSize, end = std::min(n, begin + kInt8BlockSize);
+			const float scale = scales[b];
+			for (size_t i = begin; i < end; ++i) out[i] = q[i] * scale;
+		}
+	}
+}
+
+} // namespace quantize
+} // namespace ps
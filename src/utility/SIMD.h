@@ -0,0 +1,269 @@
+/**
+ * @file SIMD.h
+ * @brief 梯度合并与参数更新使用的向量化内核：Add、Axpy、Scale、Clip，支持 float 与 double。
+ * 运行时根据 CPU 选择 AVX-512、AVX2 或标量实现。
+ */
+#pragma once
+#include <cstddef>
+#include <algorithm>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PS_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#else
+#define PS_SIMD_X86 0
+#endif
+
+// GCC/Clang 需要为使用指令集的函数单独开启 target，MSVC 不需要
+#if PS_SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+#define PS_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define PS_TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define PS_TARGET_AVX2
+#define PS_TARGET_AVX512
+#endif
+
+namespace ps {
+namespace simd {
+
+/**
+ * @brief 可用的指令集，按能力从低到高排列。
+ */
+enum Isa: int {
+	SCALAR, AVX2, AVX512
+};
+inline const char* const IsaName[] = {
+	"SCALAR", "AVX2", "AVX512"
+};
+
+// --- 标量实现
+namespace scalar {
+
+template <typename T>
+void Add(T* dst, const T* src, size_t n) {
+	for (size_t i = 0; i < n; ++i) dst[i] += src[i];
+}
+template <typename T>
+void Axpy(T* y, T a, const T* x, size_t n) {
+	for (size_t i = 0; i < n; ++i) y[i] += a * x[i];
+}
+template <typename T>
+void Scale(T* x, T a, size_t n) {
+	for (size_t i = 0; i < n; ++i) x[i] *= a;
+}
+template <typename T>
+void Clip(T* x, T bound, size_t n) {
+	for (size_t i = 0; i < n; ++i) x[i] = std::min(std::max(x[i], -bound), bound);
+}
+
+} // namespace scalar
+
+#if PS_SIMD_X86
+// --- 各指令集下对寄存器的基本操作，供下面的通用循环使用
+struct Avx2Float {
+	using T = float;
+	using V = __m256;
+	static constexpr size_t kWidth = 8;
+	PS_TARGET_AVX2 static V Load(const T* p) { return _mm256_loadu_ps(p); }
+	PS_TARGET_AVX2 static void Store(T* p, V v) { _mm256_storeu_ps(p, v); }
+	PS_TARGET_AVX2 static V Set(T a) { return _mm256_set1_ps(a); }
+	PS_TARGET_AVX2 static V Add(V a, V b) { return _mm256_add_ps(a, b); }
+	PS_TARGET_AVX2 static V Mul(V a, V b) { return _mm256_mul_ps(a, b); }
+	PS_TARGET_AVX2 static V FMAdd(V a, V b, V c) { return _mm256_fmadd_ps(a, b, c); }
+	PS_TARGET_AVX2 static V Min(V a, V b) { return _mm256_min_ps(a, b); }
+	PS_TARGET_AVX2 static V Max(V a, V b) { return _mm256_max_ps(a, b); }
+};
+struct Avx2Double {
+	using T = double;
+	using V = __m256d;
+	static constexpr size_t kWidth = 4;
+	PS_TARGET_AVX2 static V Load(const T* p) { return _mm256_loadu_pd(p); }
+	PS_TARGET_AVX2 static void Store(T* p, V v) { _mm256_storeu_pd(p, v); }
+	PS_TARGET_AVX2 static V Set(T a) { return _mm256_set1_pd(a); }
+	PS_TARGET_AVX2 static V Add(V a, V b) { return _mm256_add_pd(a, b); }
+	PS_TARGET_AVX2 static V Mul(V a, V b) { return _mm256_mul_pd(a, b); }
+	PS_TARGET_AVX2 static V FMAdd(V a, V b, V c) { return _mm256_fmadd_pd(a, b, c); }
+	PS_TARGET_AVX2 static V Min(V a, V b) { return _mm256_min_pd(a, b); }
+	PS_TARGET_AVX2 static V Max(V a, V b) { return _mm256_max_pd(a, b); }
+};
+// min/max 使用全 1 掩码的 maskz 版本：GCC 12 中不带掩码的版本会产生误报的 -Wmaybe-uninitialized
+struct Avx512Float {
+	using T = float;
+	using V = __m512;
+	static constexpr size_t kWidth = 16;
+	PS_TARGET_AVX512 static V Load(const T* p) { return _mm512_loadu_ps(p); }
+	PS_TARGET_AVX512 static void Store(T* p, V v) { _mm512_storeu_ps(p, v); }
+	PS_TARGET_AVX512 static V Set(T a) { return _mm512_set1_ps(a); }
+	PS_TARGET_AVX512 static V Add(V a, V b) { return _mm512_add_ps(a, b); }
+	PS_TARGET_AVX512 static V Mul(V a, V b) { return _mm512_mul_ps(a, b); }
+	PS_TARGET_AVX512 static V FMAdd(V a, V b, V c) { return _mm512_fmadd_ps(a, b, c); }
+	PS_TARGET_AVX512 static V Min(V a, V b) { return _mm512_maskz_min_ps(0xffff, a, b); }
+	PS_TARGET_AVX512 static V Max(V a, V b) { return _mm512_maskz_max_ps(0xffff, a, b); }
+};
+struct Avx512Double {
+	using T = double;
+	using V = __m512d;
+	static constexpr size_t kWidth = 8;
+	PS_TARGET_AVX512 static V Load(const T* p) { return _mm512_loadu_pd(p); }
+	PS_TARGET_AVX512 static void Store(T* p, V v) { _mm512_storeu_pd(p, v); }
+	PS_TARGET_AVX512 static V Set(T a) { return _mm512_set1_pd(a); }
+	PS_TARGET_AVX512 static V Add(V a, V b) { return _mm512_add_pd(a, b); }
+	PS_TARGET_AVX512 static V Mul(V a, V b) { return _mm512_mul_pd(a, b); }
+	PS_TARGET_AVX512 static V FMAdd(V a, V b, V c) { return _mm512_fmadd_pd(a, b, c); }
+	PS_TARGET_AVX512 static V Min(V a, V b) { return _mm512_maskz_min_pd(0xff, a, b); }
+	PS_TARGET_AVX512 static V Max(V a, V b) { return _mm512_maskz_max_pd(0xff, a, b); }
+};
+
+// --- 通用循环。target 不能随模板参数变化，所以每个指令集各写一份；不足一个寄存器的尾部用标量处理
+#define PS_SIMD_KERNELS(NS, TARGET) \
+namespace NS { \
+template <typename Ops, typename T = typename Ops::T> \
+TARGET void Add(T* dst, const T* src, size_t n) { \
+	size_t i = 0; \
+	for (; i + Ops::kWidth <= n; i += Ops::kWidth) \
+		Ops::Store(dst + i, Ops::Add(Ops::Load(dst + i), Ops::Load(src + i))); \
+	scalar::Add(dst + i, src + i, n - i); \
+} \
+template <typename Ops, typename T = typename Ops::T> \
+TARGET void Axpy(T* y, T a, const T* x, size_t n) { \
+	auto va = Ops::Set(a); \
+	size_t i = 0; \
+	for (; i + Ops::kWidth <= n; i += Ops::kWidth) \
+		Ops::Store(y + i, Ops::FMAdd(va, Ops::Load(x + i), Ops::Load(y + i))); \
+	scalar::Axpy(y + i, a, x + i, n - i); \
+} \
+template <typename Ops, typename T = typename Ops::T> \
+TARGET void Scale(T* x, T a, size_t n) { \
+	auto va = Ops::Set(a); \
+	size_t i = 0; \
+	for (; i + Ops::kWidth <= n; i += Ops::kWidth) \
+		Ops::Store(x + i, Ops::Mul(va, Ops::Load(x + i))); \
+	scalar::Scale(x + i, a, n - i); \
+} \
+template <typename Ops, typename T = typename Ops::T> \
+TARGET void Clip(T* x, T bound, size_t n) { \
+	auto hi = Ops::Set(bound), lo = Ops::Set(-bound); \
+	size_t i = 0; \
+	for (; i + Ops::kWidth <= n; i += Ops::kWidth) \
+		Ops::Store(x + i, Ops::Min(Ops::Max(Ops::Load(x + i), lo), hi)); \
+	scalar::Clip(x + i, bound, n - i); \
+} \
+}
+
+PS_SIMD_KERNELS(avx2, PS_TARGET_AVX2)
+PS_SIMD_KERNELS(avx512, PS_TARGET_AVX512)
+#undef PS_SIMD_KERNELS
+
+/**
+ * @brief 检查 CPU（及操作系统）支持的最高指令集。
+ */
+inline Isa DetectIsa() {
+#if defined(__GNUC__) || defined(__clang__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) return AVX512;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return AVX2;
+	return SCALAR;
+#else
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return SCALAR;
+	__cpuidex(info, 1, 0);
+	bool osxsave = (info[2] >> 27) & 1, fma = (info[2] >> 12) & 1;
+	if (!osxsave) return SCALAR;
+	unsigned long long xcr0 = _xgetbv(0);
+	__cpuidex(info, 7, 0);
+	bool avx2 = (info[1] >> 5) & 1, avx512f = (info[1] >> 16) & 1;
+	if (avx512f && (xcr0 & 0xe6) == 0xe6) return AVX512;
+	if (avx2 && fma && (xcr0 & 0x6) == 0x6) return AVX2;
+	return SCALAR;
+#endif
+}
+#else
+inline Isa DetectIsa() {
+	return SCALAR;
+}
+#endif // PS_SIMD_X86
+
+/**
+ * @brief 某个类型的所有内核。
+ */
+template <typename T>
+struct KernelTable {
+	void (*add)(T* dst, const T* src, size_t n);
+	void (*axpy)(T* y, T a, const T* x, size_t n);
+	void (*scale)(T* x, T a, size_t n);
+	void (*clip)(T* x, T bound, size_t n);
+};
+
+/**
+ * @brief 获取指定指令集的内核。指令集不可用时退化为标量实现。
+ */
+template <typename T>
+KernelTable<T> GetKernelTable(Isa isa) {
+	static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>, "only float and double are supported");
+#if PS_SIMD_X86
+	using Avx2Ops = std::conditional_t<std::is_same_v<T, float>, Avx2Float, Avx2Double>;
+	using Avx512Ops = std::conditional_t<std::is_same_v<T, float>, Avx512Float, Avx512Double>;
+	isa = std::min(isa, DetectIsa());
+	if (isa == AVX512) {
+		return {avx512::Add<Avx512Ops>, avx512::Axpy<Avx512Ops>, avx512::Scale<Avx512Ops>, avx512::Clip<Avx512Ops>};
+	}
+	if (isa == AVX2) {
+		return {avx2::Add<Avx2Ops>, avx2::Axpy<Avx2Ops>, avx2::Scale<Avx2Ops>, avx2::Clip<Avx2Ops>};
+	}
+#endif
+	return {scalar::Add<T>, scalar::Axpy<T>, scalar::Scale<T>, scalar::Clip<T>};
+}
+
+/**
+ * @brief 当前使用的内核，第一次使用时根据 CPU 选择。
+ */
+template <typename T>
+KernelTable<T>& Kernels() {
+	static KernelTable<T> table = GetKernelTable<T>(AVX512);
+	return table;
+}
+
+/**
+ * @brief 强制使用不超过 isa 的指令集（用于测试与对比）。非线程安全，应在使用内核前调用。
+ */
+inline void SetIsa(Isa isa) {
+	Kernels<float>() = GetKernelTable<float>(isa);
+	Kernels<double>() = GetKernelTable<double>(isa);
+}
+
+/**
+ * @brief dst[i] += src[i]
+ */
+template <typename T>
+inline void Add(T* dst, const T* src, size_t n) {
+	Kernels<T>().add(dst, src, n);
+}
+/**
+ * @brief y[i] += a * x[i]
+ */
+template <typename T>
+inline void Axpy(T* y, T a, const T* x, size_t n) {
+	Kernels<T>().axpy(y, a, x, n);
+}
+/**
+ * @brief x[i] *= a
+ */
+template <typename T>
+inline void Scale(T* x, T a, size_t n) {
+	Kernels<T>().scale(x, a, n);
+}
+/**
+ * @brief x[i] = clamp(x[i], -bound, bound)
+ */
+template <typename T>
+inline void Clip(T* x, T bound, size_t n) {
+	Kernels<T>().clip(x, bound, n);
+}
+
+} // namespace simd
+} // namespace ps
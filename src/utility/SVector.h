@@ -229,6 +229,16 @@ class SVector {
 	explicit SVector(const std::vector<T>& vec): allocator_() {
 		CopyFrom(vec.data(), vec.size());
 	}
+	/**
+	 * @brief 通过 vector 构造，接管其数组，无需拷贝。vec 被移动后为空。
+	 */
+	explicit SVector(std::vector<T>&& vec): allocator_() {
+		auto sp = std::make_shared<std::vector<T>>(std::move(vec));
+		// [size, capacity) 的元素还未构造，不能作为 SVector 的容量
+		size_ = sp->size();
+		capacity_ = sp->size();
+		ptr_ = std::shared_ptr<T>(sp, sp->data());
+	}
 
 	/**
 	 * @brief 通过 shared_ptr<vector> 构造，与其共享底层数组和引用计数，无需拷贝。但要注意尽管 vector 的生命周期与 SVector 一致，仍要保证 v.data() 的有效性。
@@ -414,6 +424,23 @@ class SVector {
 		reset(newData, new_size, NeedDestruct);
 	}
 
+	/**
+	 * @brief 与 resize 相同，但超过原容量的位置不初始化（默认初始化），用于之后会被完整写入的缓冲区，避免填充的开销。
+	 * 只支持平凡类型。
+	 * @param size 新的大小
+	 */
+	void resize_uninitialized(size_t new_size) requires std::is_trivial_v<T> {
+		if (new_size <= capacity_) {
+			size_ = new_size;
+			return;
+		}
+		T* newData = Allocate(new_size);
+		if (capacity_) {
+			memcpy(newData, data(), capacity_ * sizeof(T));
+		}
+		reset(newData, new_size, NeedDestruct);
+	}
+
 	/**
 	 * @brief 增加 SVector 的容量以容纳 new_cap 个元素。不改变 size。
 	 * 与 vector 不同，新元素会进行构造和值初始化。
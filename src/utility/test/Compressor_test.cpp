@@ -0,0 +1,187 @@
+/**
+ * @file Compressor_test.cpp
+ */
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+#include <string>
+
+#include "../Compressor.h"
+#include "../BufferPool.h"
+
+using namespace ps;
+using std::vector;
+
+namespace {
+
+vector<char> Compress(const vector<char>& raw) {
+	LZCompressor lz;
+	vector<char> buf(lz.MaxCompressedSize(raw.size()));
+	buf.resize(lz.Compress(raw.data(), raw.size(), buf.data()));
+	return buf;
+}
+
+void ExpectRoundTrip(const vector<char>& raw) {
+	LZCompressor lz;
+	vector<char> buf = Compress(raw);
+	EXPECT_LE(buf.size(), lz.MaxCompressedSize(raw.size()));
+	vector<char> out(raw.size());
+	ASSERT_TRUE(lz.Decompress(buf.data(), buf.size(), out.data(), out.size()));
+	EXPECT_EQ(out, raw);
+}
+
+vector<char> RandomBytes(size_t n, uint32_t seed) {
+	std::mt19937 rng(seed);
+	vector<char> v(n);
+	for (auto& c: v) c = static_cast<char>(rng());
+	return v;
+}
+
+/**
+ * @brief n 个 float，其中 density 比例非 0
+ */
+vector<char> SparseFloats(size_t n, double density, uint32_t seed) {
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> u(0, 1);
+	vector<float> v(n, 0);
+	for (auto& x: v) {
+		if (u(rng) < density) x = u(rng) - 0.5f;
+	}
+	vector<char> out(n * sizeof(float));
+	memcpy(out.data(), v.data(), out.size());
+	return out;
+}
+
+} // namespace
+
+TEST(CompressorTest, Create) {
+	std::unique_ptr<Compressor> c(Compressor::Create("lz"));
+	ASSERT_NE(c, nullptr);
+	EXPECT_STREQ(c->name(), "lz");
+	EXPECT_EQ(Compressor::Create("unknown"), nullptr);
+}
+
+TEST(CompressorTest, Small) {
+	for (size_t n = 0; n < 40; ++n) {
+		ExpectRoundTrip(vector<char>(n, 'a'));
+		ExpectRoundTrip(RandomBytes(n, n));
+	}
+}
+
+TEST(CompressorTest, Zeros) {
+	// 重叠的长匹配（offset 为 1）
+	vector<char> raw(1 << 20, 0);
+	ExpectRoundTrip(raw);
+	EXPECT_LT(Compress(raw).size(), raw.size() / 200);
+	// 压缩比最高的数据也不超过 MaxDecompressedSize，Van 用它检查收到的原始大小
+	EXPECT_LE(raw.size(), LZCompressor().MaxDecompressedSize(Compress(raw).size()));
+}
+
+TEST(CompressorTest, Patterns) {
+	for (size_t period: {2, 3, 7, 8, 13, 100, 1000}) {
+		vector<char> raw(100000);
+		vector<char> unit = RandomBytes(period, period);
+		for (size_t i = 0; i < raw.size(); ++i) raw[i] = unit[i % period];
+		ExpectRoundTrip(raw);
+		EXPECT_LT(Compress(raw).size(), raw.size() / 20) << period;
+	}
+}
+
+TEST(CompressorTest, Random) {
+	// 不可压缩的数据不应明显变大
+	vector<char> raw = RandomBytes(1 << 20, 1);
+	ExpectRoundTrip(raw);
+	EXPECT_LE(Compress(raw).size(), raw.size() + raw.size() / 255 + 16);
+}
+
+TEST(CompressorTest, SparseFloats) {
+	for (double density: {0.01, 0.1, 0.5, 1.0}) {
+		vector<char> raw = SparseFloats(300000, density, 7);
+		ExpectRoundTrip(raw);
+		if (density <= 0.1) {
+			EXPECT_LT(Compress(raw).size(), raw.size() / 3) << density;
+		}
+	}
+	// 大于窗口的数据，匹配的 offset 不能超过 64KB
+	ExpectRoundTrip(SparseFloats(5 << 20, 0.05, 3));
+}
+
+TEST(CompressorTest, RandomLengths) {
+	// 短字面量与匹配交替，长度随机，末尾的 sequence 离源数据结尾很近（配合 sanitizer 检查不会读越界）
+	std::mt19937 rng(11);
+	for (int round = 0; round < 2000; ++round) {
+		size_t n = rng() % 300;
+		vector<char> raw;
+		while (raw.size() < n) {
+			size_t lit = rng() % 20;
+			for (size_t i = 0; i < lit; ++i) raw.push_back(static_cast<char>(rng()));
+			if (raw.size() >= 8) {
+				size_t offset = 1 + rng() % std::min<size_t>(raw.size(), 64);
+				size_t len = 4 + rng() % 24;
+				for (size_t i = 0; i < len; ++i) raw.push_back(raw[raw.size() - offset]);
+			}
+		}
+		raw.resize(n);
+		raw.shrink_to_fit();
+		ExpectRoundTrip(raw);
+	}
+}
+
+TEST(CompressorTest, Corrupted) {
+	LZCompressor lz;
+	vector<char> raw = SparseFloats(10000, 0.1, 5);
+	vector<char> buf = Compress(raw);
+	vector<char> out(raw.size());
+	// 截断
+	for (size_t len: {size_t(0), size_t(1), buf.size() / 2, buf.size() - 1}) {
+		EXPECT_FALSE(lz.Decompress(buf.data(), len, out.data(), out.size())) << len;
+	}
+	// 原始大小错误
+	EXPECT_FALSE(lz.Decompress(buf.data(), buf.size(), out.data(), out.size() - 1));
+	vector<char> larger(raw.size() + 1);
+	EXPECT_FALSE(lz.Decompress(buf.data(), buf.size(), larger.data(), larger.size()));
+	// 随机数据不应越界（配合 sanitizer 检查）
+	for (uint32_t seed = 0; seed < 200; ++seed) {
+		vector<char> garbage = RandomBytes(64 + seed, seed);
+		lz.Decompress(garbage.data(), garbage.size(), out.data(), out.size());
+	}
+}
+
+TEST(BufferPoolTest, Reuse) {
+	BufferPool pool;
+	const char* first;
+	{
+		SVector<char> buf = pool.Get(10000);
+		EXPECT_EQ(buf.size(), 10000u);
+		first = buf.data();
+		memset(buf.data(), 1, buf.size());
+	}
+	// 同一级别的缓冲区被复用
+	SVector<char> buf = pool.Get(12000);
+	EXPECT_EQ(buf.data(), first);
+	EXPECT_EQ(pool.hits(), 1u);
+	SVector<char> other = pool.Get(100);
+	EXPECT_NE(other.data(), first);
+	EXPECT_EQ(pool.hits(), 1u);
+}
+
+TEST(BufferPoolTest, Limit) {
+	BufferPool pool(BufferPool::kMinSize);
+	{
+		SVector<char> a = pool.Get(100), b = pool.Get(100);
+	}
+	// 只缓存了一个
+	SVector<char> a = pool.Get(100), b = pool.Get(100);
+	EXPECT_EQ(pool.hits(), 1u);
+}
+
+TEST(BufferPoolTest, OutlivePool) {
+	SVector<char> buf;
+	{
+		BufferPool pool;
+		buf = pool.Get(5000);
+		SVector<char> shared = buf;
+	}
+	memset(buf.data(), 0, buf.size());
+}
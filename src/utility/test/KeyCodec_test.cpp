@@ -0,0 +1,109 @@
+/**
+ * @file KeyCodec_test.cpp
+ */
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "../KeyCodec.h"
+
+using namespace ps;
+using std::vector;
+
+namespace {
+
+vector<char> Encode(const vector<uint64_t>& keys) {
+	vector<char> buf(keycodec::MaxEncodedSize(keys.size()));
+	buf.resize(keycodec::Encode(keys.data(), keys.size(), buf.data()));
+	return buf;
+}
+
+vector<uint64_t> Decode(const vector<char>& buf) {
+	size_t n = 0;
+	EXPECT_TRUE(keycodec::DecodedSize(buf.data(), buf.size(), &n));
+	vector<uint64_t> keys(n);
+	EXPECT_TRUE(keycodec::Decode(buf.data(), buf.size(), keys.data()));
+	return keys;
+}
+
+/**
+ * @brief 从 [0, range) 中随机取 n 个不同的 key，升序
+ */
+vector<uint64_t> RandomKeys(size_t n, uint64_t range, uint32_t seed) {
+	std::mt19937_64 rng(seed);
+	vector<uint64_t> keys(n);
+	for (auto& k: keys) k = range ? rng() % range : rng();
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+	return keys;
+}
+
+} // namespace
+
+TEST(KeyCodecTest, Empty) {
+	vector<uint64_t> keys;
+	EXPECT_EQ(Decode(Encode(keys)), keys);
+}
+
+TEST(KeyCodecTest, Single) {
+	for (uint64_t k: {uint64_t(0), uint64_t(12345), ~uint64_t(0)}) {
+		vector<uint64_t> keys = {k};
+		EXPECT_EQ(Decode(Encode(keys)), keys);
+	}
+}
+
+TEST(KeyCodecTest, Consecutive) {
+	// 连续的 key 差值为 0，每块只需要 1 字节
+	vector<uint64_t> keys(1000);
+	for (size_t i = 0; i < keys.size(); ++i) keys[i] = 1000 + i;
+	auto buf = Encode(keys);
+	EXPECT_EQ(buf.size(), keycodec::kHeaderSize + 8 + keycodec::kPadding);
+	EXPECT_EQ(Decode(buf), keys);
+}
+
+TEST(KeyCodecTest, BlockBoundaries) {
+	for (size_t n: {size_t(2), keycodec::kBlockSize, keycodec::kBlockSize + 1,
+			keycodec::kBlockSize + 2, 3 * keycodec::kBlockSize + 1}) {
+		auto keys = RandomKeys(n, uint64_t(1) << 40, n);
+		EXPECT_EQ(Decode(Encode(keys)), keys) << "n = " << n;
+	}
+}
+
+TEST(KeyCodecTest, AllWidths) {
+	// 每种位宽（包括需要跨越 8 字节读取的 57~64 位）
+	for (int b = 0; b <= 64; ++b) {
+		vector<uint64_t> keys;
+		uint64_t k = 0;
+		std::mt19937_64 rng(b);
+		for (int i = 0; i < 300 && (keys.empty() || k > keys.back()); ++i) {
+			keys.push_back(k);
+			uint64_t max_delta = b == 64 ? ~uint64_t(0) >> 2 : (b == 0 ? 0 : (uint64_t(1) << b) - 1);
+			k += 1 + (max_delta ? rng() % max_delta : 0);
+		}
+		EXPECT_EQ(Decode(Encode(keys)), keys) << "width = " << b;
+	}
+	vector<uint64_t> extreme = {0, ~uint64_t(0)};
+	EXPECT_EQ(Decode(Encode(extreme)), extreme);
+}
+
+TEST(KeyCodecTest, SparseIsSmaller) {
+	// 10 万个 key 取自 2^24 的空间，平均差值约 2^7.4，编码后不到原来的 1/4
+	auto keys = RandomKeys(100000, uint64_t(1) << 24, 1);
+	auto buf = Encode(keys);
+	EXPECT_LT(buf.size() * 4, keys.size() * sizeof(uint64_t));
+	EXPECT_EQ(Decode(buf), keys);
+}
+
+TEST(KeyCodecTest, RejectsMalformed) {
+	auto keys = RandomKeys(500, uint64_t(1) << 30, 2);
+	auto buf = Encode(keys);
+	vector<uint64_t> out(keys.size());
+	size_t n;
+	EXPECT_FALSE(keycodec::DecodedSize(buf.data(), 10, &n));
+	EXPECT_FALSE(keycodec::Decode(buf.data(), buf.size() - 1, out.data()));
+	auto bad = buf;
+	bad[keycodec::kHeaderSize] = 65; // 非法位宽
+	EXPECT_FALSE(keycodec::Decode(bad.data(), bad.size(), out.data()));
+}
@@ -0,0 +1,144 @@
+/**
+ * @file Quantize_test.cpp
+ */
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "../Quantize.h"
+
+using namespace ps;
+using namespace ps::quantize;
+using std::vector;
+
+namespace {
+
+template <typename T>
+vector<T> RoundTrip(Codec codec, const vector<T>& src, uint32_t seed = 0) {
+	vector<char> buf(EncodedSize(codec, src.size()));
+	Encode(codec, src.data(), src.size(), buf.data(), seed);
+	size_t n = 0;
+	EXPECT_TRUE(DecodedCount(codec, buf.data(), buf.size(), &n));
+	EXPECT_EQ(n, src.size());
+	vector<T> out(n);
+	Decode(codec, buf.data(), n, out.data());
+	return out;
+}
+
+vector<float> RandomFloats(size_t n, float range, uint32_t seed) {
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> dist(-range, range);
+	vector<float> v(n);
+	for (auto& x: v) x = dist(rng);
+	return v;
+}
+
+} // namespace
+
+TEST(QuantizeTest, HalfExactValues) {
+	// 可以精确表示的值：整数、2 的幂、最大值、最小的非规格化数
+	vector<float> v = {0.f, -0.f, 1.f, -2.f, 0.5f, 1024.f, 65504.f, -65504.f, 6.103515625e-05f, 5.9604644775390625e-08f};
+	EXPECT_EQ(RoundTrip(FP16, v), v);
+	EXPECT_EQ(detail::FloatToHalf(1.f), 0x3c00);
+	EXPECT_EQ(detail::FloatToHalf(-2.f), 0xc000);
+}
+
+TEST(QuantizeTest, HalfRounding) {
+	// 1 + 2^-11 正好在 1 与 1 + 2^-10 中间，舍入到偶数 1
+	EXPECT_EQ(detail::FloatToHalf(1.f + std::ldexp(1.f, -11)), 0x3c00);
+	// 1 + 3 * 2^-11 在 1 + 2^-10 与 1 + 2^-9 中间，舍入到偶数 1 + 2^-9
+	EXPECT_EQ(detail::FloatToHalf(1.f + 3 * std::ldexp(1.f, -11)), 0x3c02);
+	EXPECT_EQ(detail::FloatToHalf(65520.f), 0x7c00); // 溢出为 Inf
+	EXPECT_EQ(detail::FloatToHalf(std::numeric_limits<float>::infinity()), 0x7c00);
+	EXPECT_TRUE(std::isnan(detail::HalfToFloat(detail::FloatToHalf(std::nanf("")))));
+}
+
+TEST(QuantizeTest, HalfMatchesScalar) {
+	// F16C 与标量实现逐位一致（包括非规格化数与溢出）
+	vector<float> v = RandomFloats(10007, 70000.f, 1);
+	for (float& x: RandomFloats(1000, 1e-4f, 2)) v.push_back(x);
+	vector<char> buf(EncodedSize(FP16, v.size()));
+	Encode(FP16, v.data(), v.size(), buf.data());
+	const uint16_t* h = reinterpret_cast<const uint16_t*>(buf.data());
+	for (size_t i = 0; i < v.size(); ++i) {
+		ASSERT_EQ(h[i], detail::FloatToHalf(v[i])) << v[i];
+	}
+	vector<float> out = RoundTrip(FP16, v);
+	for (size_t i = 0; i < v.size(); ++i) {
+		ASSERT_EQ(detail::FloatBits(out[i]), detail::FloatBits(detail::HalfToFloat(h[i])));
+	}
+}
+
+TEST(QuantizeTest, HalfRelativeError) {
+	vector<float> v = RandomFloats(4096, 100.f, 3);
+	vector<float> out = RoundTrip(FP16, v);
+	for (size_t i = 0; i < v.size(); ++i) {
+		if (std::abs(v[i]) > 1e-4f) {
+			EXPECT_LE(std::abs(out[i] - v[i]), std::abs(v[i]) * std::ldexp(1.f, -11));
+		}
+	}
+}
+
+TEST(QuantizeTest, BF16) {
+	vector<float> v = {0.f, 1.f, -3.f, 1e30f, -1e-30f};
+	vector<float> out = RoundTrip(BF16, v);
+	for (size_t i = 0; i < v.size(); ++i) {
+		EXPECT_LE(std::abs(out[i] - v[i]), std::abs(v[i]) * std::ldexp(1.f, -8));
+	}
+	EXPECT_EQ(detail::FloatToBF16(1.f + std::ldexp(1.f, -8)), 0x3f80); // 中点舍入到偶数
+	EXPECT_EQ(detail::FloatToBF16(1.f + 3 * std::ldexp(1.f, -8)), 0x3f82);
+	EXPECT_TRUE(std::isnan(detail::BF16ToFloat(detail::FloatToBF16(std::nanf("")))));
+}
+
+TEST(QuantizeTest, Int8Error) {
+	// 每个值的误差不超过所在块的缩放系数
+	for (size_t n: {size_t(1), size_t(255), size_t(256), size_t(1000)}) {
+		vector<float> v = RandomFloats(n, 10.f, n);
+		vector<float> out = RoundTrip(INT8, v, 7);
+		for (size_t b = 0; b < n; b += kInt8BlockSize) {
+			size_t end = std::min(n, b + kInt8BlockSize);
+			float max_abs = 0;
+			for (size_t i = b; i < end; ++i) max_abs = std::max(max_abs, std::abs(v[i]));
+			for (size_t i = b; i < end; ++i) {
+				EXPECT_LE(std::abs(out[i] - v[i]), max_abs / 127 * 1.0001f);
+			}
+		}
+	}
+	vector<float> zeros(300, 0.f);
+	EXPECT_EQ(RoundTrip(INT8, zeros), zeros);
+}
+
+TEST(QuantizeTest, Int8Unbiased) {
+	// 随机舍入：多次编码的平均值接近原值，误差远小于一个量化间隔
+	vector<float> v = RandomFloats(256, 1.f, 4);
+	v[0] = 1.f; // 固定缩放系数为 1/127
+	vector<double> sum(v.size(), 0);
+	const int rounds = 2000;
+	for (int r = 0; r < rounds; ++r) {
+		vector<float> out = RoundTrip(INT8, v, r);
+		for (size_t i = 0; i < v.size(); ++i) sum[i] += out[i];
+	}
+	for (size_t i = 0; i < v.size(); ++i) {
+		EXPECT_NEAR(sum[i] / rounds, v[i], 0.1 / 127);
+	}
+}
+
+TEST(QuantizeTest, Double) {
+	vector<double> v = {0.5, -1.25, 3.0};
+	EXPECT_EQ(RoundTrip(FP16, v), v);
+	EXPECT_EQ(RoundTrip(BF16, v), v);
+}
+
+TEST(QuantizeTest, Size) {
+	EXPECT_EQ(EncodedSize(FP16, 10), 20u);
+	EXPECT_EQ(EncodedSize(INT8, 257), 8 + 2 * sizeof(float) + 257);
+	size_t n;
+	vector<char> buf(EncodedSize(INT8, 100));
+	vector<float> v(100, 1.f);
+	Encode(INT8, v.data(), v.size(), buf.data());
+	EXPECT_FALSE(DecodedCount(INT8, buf.data(), buf.size() - 1, &n));
+	EXPECT_FALSE(DecodedCount(FP16, buf.data(), 3, &n));
+}
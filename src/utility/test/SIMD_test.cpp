@@ -0,0 +1,94 @@
+/**
+ * @file SIMD_test.cpp
+ */
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+#include "../SIMD.h"
+
+using namespace ps;
+using std::vector;
+
+// 包含不足一个寄存器的长度、恰好整数个寄存器的长度以及带尾部的长度
+static const size_t kSizes[] = {0, 1, 3, 4, 7, 8, 15, 16, 17, 31, 33, 64, 1000, 1027};
+
+template <typename T>
+vector<T> RandomVector(size_t n, std::mt19937& rng) {
+	std::uniform_real_distribution<T> dist(-10, 10);
+	vector<T> v(n);
+	for (auto& x: v) x = dist(rng);
+	return v;
+}
+
+template <typename T>
+class SIMDTest: public ::testing::Test {};
+using ValueTypes = ::testing::Types<float, double>;
+TYPED_TEST_SUITE(SIMDTest, ValueTypes);
+
+// 每个可用指令集的结果都应与标量实现一致
+TYPED_TEST(SIMDTest, MatchScalar) {
+	using T = TypeParam;
+	std::mt19937 rng(2024);
+	// Axpy 在向量实现中使用 FMA，结果可能与先乘后加相差一个舍入误差
+	const T eps = std::is_same_v<T, float> ? 1e-4 : 1e-12;
+	for (int isa = simd::SCALAR; isa <= simd::DetectIsa(); ++isa) {
+		auto table = simd::GetKernelTable<T>(static_cast<simd::Isa>(isa));
+		for (size_t n: kSizes) {
+			SCOPED_TRACE(std::string(simd::IsaName[isa]) + " n=" + std::to_string(n));
+			auto x = RandomVector<T>(n, rng), y = RandomVector<T>(n, rng);
+
+			auto expect = y, actual = y;
+			simd::scalar::Add(expect.data(), x.data(), n);
+			table.add(actual.data(), x.data(), n);
+			EXPECT_EQ(expect, actual);
+
+			expect = y, actual = y;
+			simd::scalar::Axpy(expect.data(), T(-0.3), x.data(), n);
+			table.axpy(actual.data(), T(-0.3), x.data(), n);
+			for (size_t i = 0; i < n; ++i) {
+				EXPECT_NEAR(expect[i], actual[i], eps);
+			}
+
+			expect = y, actual = y;
+			simd::scalar::Scale(expect.data(), T(1.5), n);
+			table.scale(actual.data(), T(1.5), n);
+			EXPECT_EQ(expect, actual);
+
+			expect = y, actual = y;
+			simd::scalar::Clip(expect.data(), T(2.5), n);
+			table.clip(actual.data(), T(2.5), n);
+			EXPECT_EQ(expect, actual);
+		}
+	}
+}
+
+TYPED_TEST(SIMDTest, Values) {
+	using T = TypeParam;
+	vector<T> x{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17};
+	vector<T> y(x.size(), 1);
+	size_t n = x.size();
+
+	simd::Add(y.data(), x.data(), n);
+	for (size_t i = 0; i < n; ++i) EXPECT_EQ(y[i], x[i] + 1);
+
+	simd::Axpy(y.data(), T(-1), x.data(), n);
+	for (size_t i = 0; i < n; ++i) EXPECT_EQ(y[i], 1);
+
+	simd::Scale(x.data(), T(0.5), n);
+	for (size_t i = 0; i < n; ++i) EXPECT_EQ(x[i], T(i + 1) / 2);
+
+	simd::Clip(x.data(), T(3), n);
+	for (size_t i = 0; i < n; ++i) EXPECT_EQ(x[i], std::min(T(i + 1) / 2, T(3)));
+}
+
+// 不支持的指令集应退化为可用的实现
+TEST(SIMDTest, SetIsa) {
+	simd::SetIsa(simd::SCALAR);
+	EXPECT_EQ(simd::Kernels<float>().add, &simd::scalar::Add<float>);
+	simd::SetIsa(simd::AVX512);
+	vector<float> x(40, 1), y(40, 2);
+	simd::Add(y.data(), x.data(), y.size());
+	for (float v: y) EXPECT_EQ(v, 3);
+}
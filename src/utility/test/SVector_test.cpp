@@ -350,6 +350,49 @@ TEST(ConstructorTest, T4) {
 	}
 }
 
+TEST(ConstructorTest, T5) {
+	// SVector(std::vector<T>&&)
+	int counter = 0;
+	{
+		vector<A> v;
+		v.reserve(8);
+		v.push_back(AC(1));
+		v.push_back(AC(2));
+		v.push_back(AC(3));
+		const A* data = v.data();
+		{
+			SVector<A> s1(std::move(v));
+			EXPECT_TRUE(v.empty());
+			// 不拷贝，vector 多余的容量不属于 SVector
+			EXPECT_EQ(s1.data(), data);
+			EXPECT_EQ(s1.size(), 3);
+			EXPECT_EQ(s1.capacity(), 3);
+			EXPECT_EQ(s1[2], 3);
+			{
+				SVector<A> s2(s1);
+				s2[0] = AC(-1);
+			}
+			EXPECT_EQ(s1[0], -1);
+
+			s1.emplace_back(4, &counter);
+			EXPECT_EQ(s1.size(), 4);
+			EXPECT_EQ(s1[1], 2);
+			EXPECT_EQ(s1[3], 4);
+		}
+	}
+	EXPECT_EQ(counter, 0);
+	{
+		vector<string> v {"abc", V_strings[0], V_strings[1]};
+		SVector<string> s1(std::move(v));
+		EXPECT_EQ(s1.size(), 3);
+		EXPECT_EQ(s1[1], V_strings[0]);
+		s1.resize(5, V_strings[2]);
+		EXPECT_EQ(s1[0], "abc");
+		EXPECT_EQ(s1[2], V_strings[1]);
+		EXPECT_EQ(s1[4], V_strings[2]);
+	}
+}
+
 TEST(CopyFromTest, T) {
 	// SVector
 	{
@@ -666,6 +709,41 @@ TEST(ResizeTest, T3) {
 	}
 }
 
+TEST(ResizeTest, T4) {
+	// resize_uninitialized
+	SVector<int> s1 {1, 2, 3};
+	s1.resize_uninitialized(2);
+	EXPECT_EQ(s1.size(), 2);
+	EXPECT_EQ(s1.capacity(), 3);
+	// 不超过容量时不重新分配，原有的元素保留
+	const int* data = s1.data();
+	s1.resize_uninitialized(3);
+	EXPECT_EQ(s1.data(), data);
+	EXPECT_EQ(s1[2], 3);
+
+	s1.resize_uninitialized(100);
+	EXPECT_EQ(s1.size(), 100);
+	EXPECT_EQ(s1.capacity(), 100);
+	EXPECT_EQ(s1[0], 1);
+	EXPECT_EQ(s1[2], 3);
+	s1[99] = 99;
+	EXPECT_EQ(s1[99], 99);
+
+	// 共享数组的 SVector 不受扩容影响
+	SVector<int> s2(s1);
+	s2.resize_uninitialized(200);
+	EXPECT_NE(s2.data(), s1.data());
+	EXPECT_EQ(s2[99], 99);
+	s2[0] = -1;
+	EXPECT_EQ(s1[0], 1);
+
+	SVector<double> s3;
+	s3.resize_uninitialized(4);
+	EXPECT_EQ(s3.size(), 4);
+	s3.resize_uninitialized(0);
+	EXPECT_TRUE(s3.empty());
+}
+
 TEST(ReserveTest, T) {
 	int counter = 0;
 	{
@@ -31,8 +31,8 @@ void RunWorker(int customer_id) {
 	int test_period = ps::Environment::GetInt("TEST_PERIOD");
 
 	int sync_mode = ps::Environment::GetInt("SYNC_MODE");
-	bool is_async = sync_mode == 1;
-	bool output_result = is_async || rank == 0; // 只让一个 worker 输出信息
+	bool is_sync = sync_mode == 0;
+	bool output_result = !is_sync || rank == 0; // 同步时只让一个 worker 输出信息
 
 	constexpr bool track_comm = true; // 记录每轮的通信量
 
@@ -87,6 +87,7 @@ void RunWorker(int customer_id) {
 		out << "Worker[" << rank << "] finished training at "  << std::put_time(std::localtime(&tmNow), "%F %T")
 			<< "\n\ttime: " << ms
 			<< ", iteration: " << iteration
+			<< ", iterations/s: " << iteration * 1000. / std::max<int64_t>(ms.count(), 1)
 			<< ", batch_size: " << batch_size;
 		std::cout << out.str() << std::endl;
 		LOG(WARNING) << out.str();
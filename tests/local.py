@@ -72,7 +72,7 @@ def create_cfg(role, cfg_name):
 	if use_lr:
 		cfg['DATA_DIR'] = './LR'
 		cfg['NUM_FEATURE'] = 123
-		cfg['SYNC_MODE'] = 0 # 0: sync, 1: async
+		cfg['SYNC_MODE'] = 0 # 0: sync, 1: async, 2: ssp
 		cfg['TEST_PERIOD'] = 1 # 10
 		cfg['C'] = 1 # 1
 
@@ -26,10 +26,16 @@ class Adam {
 	 * @param iteration 迭代次数
 	 */
 	double GetGrad(double gradient, int index, int iteration) {
+		if (iteration != bias_iteration) {
+			// 偏差修正只与迭代次数有关，每轮迭代计算一次即可，不需要每个参数都调用 pow
+			bias_iteration = iteration;
+			bias1 = 1 - std::pow(beta1, iteration + 1);
+			bias2 = 1 - std::pow(beta2, iteration + 1);
+		}
 		m[index] = beta1 * m[index] + (1 - beta1) * gradient;
 		v[index] = beta2 * v[index] + (1 - beta2) * gradient * gradient;
-		double m_hat = m[index] / (1 - std::pow(beta1,iteration + 1));
-		double v_hat = v[index] / (1 - std::pow(beta2,iteration + 1));
+		double m_hat = m[index] / bias1;
+		double v_hat = v[index] / bias2;
 		return learning_rate * m_hat / (std::sqrt(v_hat) + epsilon);
 	}
 
@@ -39,6 +45,10 @@ class Adam {
 	double beta2;
 	double epsilon;
 	// int iteration; // 不在这里统计了
+	/* 当前缓存的偏差修正对应的迭代次数，及 1 - beta^(iteration+1) */
+	int bias_iteration{-1};
+	double bias1{1};
+	double bias2{1};
 
 	std::vector<double> m; // 一阶矩估计的累积变量
 	std::vector<double> v; // 二阶矩估计的累积变量
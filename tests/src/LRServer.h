@@ -1,33 +1,15 @@
 #pragma once
+#include <memory>
+#include <numeric>
 #include <functional>
 
 #include "ps/ps.h"
 #include "ps/KVApp.h"
+#include "ps/Optimizer.h"
 #include "internal/Env.h"
 
-#include "./Adam.h"
 #include "./DataLoader.h"
 
-namespace std {
-template<>
-struct hash<ps::SVector<uint64_t>> {
-	/**
-	 * @brief 用于 key caching。
-	 * https://codeforces.com/blog/entry/62393
-	 */
-	uint64_t operator()(const ps::SVector<uint64_t>& vec) const noexcept {
-		uint64_t seed = vec.size();
-		for(auto x : vec) {
-			x += 0x9e3779b97f4a7c15;
-			x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
-			x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
-			seed ^= x ^ x >> 31;
-		}
-		return seed;
-	}
-};
-} // namespace std
-
 namespace lr {
 
 /**
@@ -75,18 +57,32 @@ class LRServer {
 		current_iteration_ = 0;
 
 		sync_mode_ = ps::Environment::GetInt("SYNC_MODE");
+		static constexpr ps::ConsistencyModel kModels[] = {ps::BSP, ps::ASYNC, ps::SSP};
+		CHECK(sync_mode_ >= 0 && sync_mode_ <= 2) << "Invalid SYNC_MODE: " << sync_mode_;
+		ps_server_->SetConsistency(kModels[sync_mode_], ps::Environment::GetIntOrDefault("STALENESS", 1));
+		// 参数只在回复 push 前更新，两次更新之间各 worker 的 pull 可以共享同一个回复
+		ps_server_->SetPullSharing(true);
+		int backup_workers = ps::Environment::GetIntOrDefault("BACKUP_WORKERS", 0);
+		if (sync_mode_ == 0 && backup_workers > 0) {
+			ps_server_->SetBackupWorkers(backup_workers, ps::Environment::Get("FOLD_LATE_GRADIENT") == nullptr);
+		}
 		learning_rate_ = std::stof(std::string(ps::Environment::GetOrFail("LEARNING_RATE")));
 
 		int num_feature = ps::Environment::GetIntOrFail("NUM_FEATURE");
 		weight_.resize(num_feature);
 
+		InitWeight(weight_, seed_, total_iteration_, current_iteration_);
+
 		if (ps::Environment::Get("USE_ADAM") != nullptr) {
-			adam_ = new Adam(num_feature, learning_rate_);
+			// 使用内置的 Adam handle：参数与优化器状态保存在其中，偏差修正每次更新（同步模式下每轮）计算一次
+			auto adam = std::make_unique<ps::KVServerAdamHandle<FType>>(ps::Adam<FType>(learning_rate_));
+			std::vector<ps::Key> keys(num_feature);
+			std::iota(keys.begin(), keys.end(), 0);
+			adam->Set(ps::SVector<ps::Key>(keys), ps::SVector<FType>(weight_));
+			adam_ = std::move(adam);
 		}
 
-		InitWeight(weight_, seed_, total_iteration_, current_iteration_);
-
-		std::string mode = sync_mode_ == 0 ? "sync" : "async";
+		std::string mode = ps::ConsistencyModelName[kModels[sync_mode_]];
 		std::cout << "new Server: mode: " << mode
 			<< ", learning_rate: " << learning_rate_
 			<< ", seed: " << seed_ << std::endl;
@@ -94,7 +90,6 @@ class LRServer {
 
 	~LRServer() {
 		delete ps_server_;
-		delete adam_;
 
 		// 输出模型参数
 		auto ptr = ps::Environment::Get("DATA_DIR");
@@ -105,6 +100,7 @@ class LRServer {
 	 * @brief 将模型参数保存到指定文件。
 	 */
 	void SaveModel(const std::string& filename) {
+		SyncWeight();
 		std::ofstream fout(filename);
 		fout << total_iteration_ << '\n';
 		fout << weight_.size() << '\n';
@@ -115,108 +111,72 @@ class LRServer {
 	}
 
 	const std::vector<FType>& GetWeight() {
+		SyncWeight();
 		return weight_;
 	}
 
  private:
+	/**
+	 * @brief 使用 Adam 时参数保存在 handle 中，将其复制到 weight_。
+	 */
+	void SyncWeight() {
+		if (!adam_) return;
+		for (size_t i = 0; i < weight_.size(); ++i) {
+			weight_[i] = *adam_->Get(i);
+		}
+	}
+
 	void RequestHandle(const ps::KVMeta& req_meta,
 					const ps::KVPairs<FType>& req_data,
 					ps::KVServer<FType>* server) {
 		// Customer 每次仅取出一个 handle 执行，所以线程安全
+		// worker 使用已注册的 key 列表时，KVServer 会补全 key，这里总能拿到完整的 key
 		size_t n = req_data.keys.size();
-		if (use_key_cache_) {
-			if (n == 1) {
-				// 读取缓存的 key 列表
-				// 用 单个哈希值 代表一个缓存的 key 列表，只要注意不发送单个参数即可（也可以用 (-1, 哈希值)，但是要指定 lens）
-				auto it = key_cache_.find(req_data.keys[0]);
-				CHECK(it != key_cache_.end()) << "Keys don't exist with hash value: " << req_data.keys[0];
-				const auto& keys = it->second;
-				n = keys.size();
-			} else {
-				// 缓存该 key 列表
-				auto hash = std::hash<ps::SVector<uint64_t>>{}(req_data.keys);
-				if (key_cache_.count(hash) == 0) {
-					key_cache_[hash] = req_data.keys;
-				}
-			}
-		}
 
 		// 在示例中维度只有123，总是发送所有的123个参数或梯度以简化下代码
 		CHECK_EQ(n, weight_.size()) << "Unmatched keys";
 
-		if (req_meta.push) {
-			CHECK_EQ(n, req_data.vals.size());
-			CHECK(!weight_.empty()) << "Weights haven't been inited";
+		if (adam_) {
+			// Adam handle 更新并返回参数
+			(*adam_)(req_meta, req_data, server);
+		} else {
+			if (req_meta.push) {
+				CHECK_EQ(n, req_data.vals.size());
+				CHECK(!weight_.empty()) << "Weights haven't been inited";
 
-			if (sync_mode_ == 0) {
-				// 同步更新梯度：将 worker 推送的梯度缓存到 merge_buf_
-				// 在所有 worker 均完成推送后，更新梯度，再通知 worker 请求完成
-				if (merge_buf_.vals.empty()) {
-					merge_buf_.vals.resize(n, 0);
-				}
-				// 汇总梯度再更新以减少计算量
+				// 同步模式下，KVServer 会在所有 worker 均完成推送后，用汇总的梯度调用一次 handle，
+				// 并在 Response 时通知所有 worker 请求完成；异步与 SSP 模式下每次推送都会调用 handle
 				for (size_t i = 0; i < n; ++i) {
-					merge_buf_.vals[i] += req_data.vals[i]; // merge_buf_.vals[keys[i]] += req_data.vals[i];
+					// 梯度下降
+					weight_[i] -= learning_rate_ * req_data.vals[i];
 				}
+				server->Response(req_meta);
+			}
+			if (req_meta.pull) {
+				CHECK(!weight_.empty()) << "Weights hasn't been inited";
 
-				merge_buf_.request.push_back(req_meta);
-				if (merge_buf_.request.size() == static_cast<size_t>(ps::NumWorkers())) {
-					// 所有 worker 均推送完成
-					for (size_t i = 0; i < n; ++i) {
-						// 梯度下降
-						double grad = learning_rate_ * merge_buf_.vals[i]; // / merge_buf_.request.size()
-						if (adam_) {
-							grad = adam_->GetGrad(grad, i, current_iteration_);
-						}
-						weight_[i] -= grad;
-					}
-					for (const auto& req : merge_buf_.request) {
-						server->Response(req);
-					}
-					merge_buf_.request.clear();
-					merge_buf_.vals.clear();
-				}
-			} else {
-				// 异步更新梯度：每次收到 worker 推送，就进行梯度下降，然后通知 worker 请求完成
+				ps::KVPairs<FType> res;
+				res.keys = req_data.keys;
+				res.vals = server->ResponseBuffer(n);
 				for (size_t i = 0; i < n; ++i) {
-					double grad = learning_rate_ * req_data.vals[i];
-					if (adam_) {
-						grad = adam_->GetGrad(grad, i, current_iteration_);
-					}
-					weight_[i] -= grad;
+					res.vals[i] = weight_[i]; // 需要拷贝一份，不能零拷贝，因为还会更新？
 				}
-				server->Response(req_meta);
-			}
-			// cmd = 1 代表一轮迭代结束
-			// 仅在 0 号 worker 发送 cmd 1 时更新迭代次数
-			if (req_meta.cmd == 1 && req_meta.sender == ps::PostOffice::WorkerRankToID(0)) {
-				++current_iteration_;
+				server->Response(req_meta, res);
 			}
 		}
-		if (req_meta.pull) {
-			CHECK(!weight_.empty()) << "Weights hasn't been inited";
-
-			ps::KVPairs<FType> res;
-			res.keys = req_data.keys;
-			res.vals.resize(n);
-			for (size_t i = 0; i < n; ++i) {
-				res.vals[i] = weight_[i]; // 需要拷贝一份，不能零拷贝，因为还会更新？
-			}
-			server->Response(req_meta, res);
+		// cmd = 1 代表一轮迭代结束
+		// 同步模式下每轮的推送合并为一个请求，其 cmd 与该轮各 worker 相同；使用备份 worker 时 0 号 worker
+		// 可能迟到而不在合并的请求中，因此不能按发送者判断。其余模式下仅在 0 号 worker 发送 cmd 1 时更新迭代次数
+		if (req_meta.push && req_meta.cmd == 1 &&
+				(req_meta.merged || req_meta.sender == ps::PostOffice::WorkerRankToID(0))) {
+			++current_iteration_;
 		}
 	}
-	/* 同步模式。0：同步；1：异步 */
+	/* 同步模式。0：同步；1：异步；2：SSP */
 	int sync_mode_;
 	/* 学习率 */
 	float learning_rate_;
 
-	struct Buffer {
-		std::vector<ps::KVMeta> request;
-		std::vector<FType> vals;
-	};
-	/* 用于同步模式下，汇总合并 worker 的梯度 */
-	Buffer merge_buf_;
-
 	/* 模型参数 */
 	std::vector<FType> weight_;
 
@@ -224,16 +184,13 @@ class LRServer {
 
 	/* 生成初始模型的种子 */
 	int seed_;
-	/* 当前已进行的迭代次数。用于 Adam */
+	/* 当前已进行的迭代次数（包括旧模型的迭代次数） */
 	int current_iteration_;
 	/* 当前模型最终训练的迭代次数。用于最终输出 */
 	int total_iteration_;
 
-	Adam* adam_{nullptr};
-
-	/* 缓存的 key 列表 */
-	std::unordered_map<uint64_t, ps::SVector<uint64_t>> key_cache_;
-	bool use_key_cache_;
+	/* 设置了 USE_ADAM 时使用的 handle，此时参数保存在其中 */
+	std::unique_ptr<ps::KVServerAdamHandle<FType>> adam_;
 };
 
 } // namespace lr
\ No newline at end of file
@@ -39,7 +39,22 @@ class LRWorker {
 		learning_rate_ = std::stof(std::string(ps::Environment::Get("LEARNING_RATE")));
 		C_ = std::stof(std::string(ps::Environment::GetOrDefault("C", "1")));
 
-		use_key_cache_ = ps::Environment::Get("USE_KEY_CACHING") == nullptr ? false : true;
+		if constexpr (UsePS) {
+			// 注册 key 列表，之后的请求只发送编号
+			// 稀疏 push 也需要注册：LRServer 的 handle 要求完整的 key，KVServer 只对已注册的 key 补全稀疏 push
+			if (ps::Environment::Get("USE_KEY_CACHING") != nullptr || ps::Environment::Get("PUSH_SPARSITY") != nullptr) {
+				key_handle_ = worker_->RegisterKeys(key_);
+			}
+			// 稀疏 push：每次只推送绝对值最大的一部分梯度，其余累积到之后的 push 中
+			if (auto ratio = ps::Environment::Get("PUSH_SPARSITY")) {
+				worker_->SetSparsification(std::stod(ratio));
+			}
+			// 使用 worker 端缓存，参数足够新时 Pull 不访问 server
+			if (ps::Environment::Get("PULL_CACHE_VERSIONS") != nullptr || ps::Environment::Get("PULL_CACHE_MS") != nullptr) {
+				worker_->SetCache(ps::Environment::GetIntOrDefault("PULL_CACHE_VERSIONS", -1),
+						ps::Environment::GetIntOrDefault("PULL_CACHE_MS", -1));
+			}
+		}
 
 		if constexpr (!UsePS) {
 			// 如果不使用 PS，则将 server 的逻辑放到 worker 内
@@ -186,11 +201,10 @@ class LRWorker {
 	 * 可以把 weights_ 改为 SVector 实现零拷贝。
 	 */
 	int Pull(bool block = true) requires UsePS {
-		int ts = worker_->Pull(key_, &weight_);
+		int ts = key_handle_.valid() ? worker_->Pull(key_handle_, &weight_) : worker_->Pull(key_, &weight_);
 		if (block) {
 			worker_->Wait(ts);
 		}
-		CacheKey();
 		return ts;
 	}
 	/**
@@ -201,22 +215,12 @@ class LRWorker {
 	 * @param cmd 如果为 1，则通知 server 一轮迭代完成
 	 */
 	int Push(const std::vector<FType>& grad, bool block = true, int cmd = 0) requires UsePS {
-		int ts = worker_->Push(key_, grad, {}, cmd);
+		int ts = key_handle_.valid() ? worker_->Push(key_handle_, grad, cmd) : worker_->Push(key_, grad, {}, cmd);
 		if (block) {
 			worker_->Wait(ts);
 		}
-		CacheKey();
 		return ts;
 	}
-	/**
-	 * @brief 发送完某个 key 列表后，转为 单个哈希值 存储，后续不再发送所有 key。
-	 */
-	void CacheKey() {
-		if (use_key_cache_ && key_hash_ == 0) {
-			key_hash_ = std::hash<ps::SVector<uint64_t>>{}(ps::SVector<uint64_t>(key_));
-			key_ = std::vector<uint64_t>{key_hash_};
-		}
-	}
 
 	/**
 	 * @brief 预测某个样本的结果：计算 W*X，判断正负（等价于传入 sigmoid，判断是否 > 0.5）。
@@ -282,9 +286,8 @@ class LRWorker {
 
 	Adam* adam_{nullptr};
 
-	/* key 列表的哈希值。如果发送的 key 与之前相同，可以直接发送该哈希值代替发送 key 列表 */
-	uint64_t key_hash_{0};
-	bool use_key_cache_;
+	/* key_ 的注册编号。注册后请求中不再携带 key 列表 */
+	ps::KeyHandle key_handle_;
 
  public:
 	/* 每轮迭代发送和接收的字节数，用于统计 */
@@ -0,0 +1,72 @@
+/**
+ * @file test_incast_benchmark.cpp
+ * @brief 测试所有 worker 同时 push 时请求的延迟分布，比较 KVWorker::SetSendOrder 的几种发送顺序。
+ * 每轮所有 worker 先 Barrier，再同时 push 覆盖所有 server 的 key，记录从 push 到完成的时间。
+ * 环境变量：
+ * - PS_SEND_ORDER、PS_SEND_PACING_US：见 README
+ * - NUM_KEYS：每次 push 的 key 数量，默认 200000
+ * - REPEAT：轮数，默认 50
+ * - HANDLE_US：server 处理每条消息额外耗费的微秒数，模拟较慢的 server，默认 0
+ * 例：python local.py -ns=4 -nw=32 -exec=./exe/test_incast_benchmark
+ */
+#include <chrono>
+#include <thread>
+#include <sstream>
+#include <algorithm>
+#include "ps/ps.h"
+#include "internal/Env.h"
+
+using namespace ps;
+
+void StartServer() {
+	if (!IsServer()) return;
+	auto server = new KVServer<float>(0);
+	int handle_us = Environment::GetIntOrDefault("HANDLE_US", 0);
+	server->SetRequestHandle([handle_us](const KVMeta& req_meta, const KVPairs<float>& req_data, KVServer<float>* server) {
+		if (handle_us) {
+			std::this_thread::sleep_for(std::chrono::microseconds(handle_us));
+		}
+		server->Response(req_meta, KVPairs<float>());
+	});
+	RegisterExitCallback([server]() { delete server; });
+}
+
+void RunWorker() {
+	if (!IsWorker()) return;
+	KVWorker<float> kv(0, 0);
+
+	int num = Environment::GetIntOrDefault("NUM_KEYS", 200000);
+	int repeat = Environment::GetIntOrDefault("REPEAT", 50);
+	std::vector<Key> keys(num);
+	std::vector<float> vals(num, 1);
+	for (int i = 0; i < num; ++i) {
+		keys[i] = kMaxKey / num * i;
+	}
+
+	std::vector<double> latency;
+	for (int i = 0; i < repeat; ++i) {
+		Barrier(0, kWorkerGroup);
+		auto start = std::chrono::high_resolution_clock::now();
+		kv.Wait(kv.Push(keys, vals));
+		auto end = std::chrono::high_resolution_clock::now();
+		latency.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+	}
+	std::sort(latency.begin(), latency.end());
+	auto percentile = [&latency](double p) {
+		return latency[std::min(latency.size() - 1, static_cast<size_t>(p * latency.size()))];
+	};
+	std::ostringstream out;
+	out << "worker " << MyRank() << ", order = " << Environment::GetOrDefault("PS_SEND_ORDER", "RANK")
+		<< ", push latency (us): p50 " << percentile(0.5) << ", p99 " << percentile(0.99)
+		<< ", max " << latency.back() << std::endl;
+	std::cout << out.str();
+	LOG(WARNING) << out.str();
+}
+
+int main(int argc, char* argv[]) {
+	Start(0, argc, argv);
+	StartServer();
+	RunWorker();
+	Finalize(0, true);
+	return 0;
+}
@@ -1,30 +1,21 @@
 #include <chrono>
+#include <cstring>
 #include <sstream>
 #include "ps/ps.h"
+#include "internal/Env.h"
 
 using namespace ps;
-std::unordered_map<int, KVPairs<float> > mem_map;
-
 template <typename Val>
 void EmptyHandler(const KVMeta &req_meta, const KVPairs<Val> &req_data, KVServer<Val> *server) {
 	if (req_meta.push) {
 		KVPairs<float> res;
 		server->Response(req_meta, res);
 	} else {
-		auto iter = mem_map.find(0);
-		if(iter==mem_map.end()){
-			LOG(INFO) << "init...";
-			KVPairs<float> res;
-			res.keys = req_data.keys;
-			res.vals.resize(req_data.keys.size());
-			server->Response(req_meta, res);
-		}else{
-			LOG(INFO) << "in-place memory reuse";
-			KVPairs<float> *res_ptr = &iter->second;
-			res_ptr->keys = req_data.keys;
-			res_ptr->vals.resize(req_data.keys.size());
-			server->Response(req_meta, *res_ptr);
-		}
+		// 回复的 value 使用 server 的内存池，发送完成后归还，之后的 pull 复用
+		KVPairs<Val> res;
+		res.keys = req_data.keys;
+		res.vals = server->ResponseBuffer(req_data.keys.size());
+		server->Response(req_meta, res);
 	}
 }
 
@@ -39,19 +30,29 @@ void RunWorker() {
 	if (!IsWorker()) return;
 	KVWorker<float> kv(0, 0);
 
+	// 可选：环境变量 QUANTIZE 指定 push 与 pull 回复中 value 的编码：NONE, FP16, BF16, INT8
+	const char* codec_name = Environment::GetOrDefault("QUANTIZE", "NONE");
+	quantize::Codec codec = quantize::NONE;
+	for (int c = quantize::NONE; c <= quantize::INT8; ++c) {
+		if (strcmp(codec_name, quantize::CodecName[c]) == 0) codec = static_cast<quantize::Codec>(c);
+	}
+	kv.SetQuantization(codec, codec);
+
 	// init
 	int num = 10000000;
 	std::vector<Key> keys(num);
 	std::vector<float> vals(num);
 
+	// 可选：环境变量 DENSITY 指定非 0 的 value 所占的比例（0~1），用于测试稀疏数据（如 PS_COMPRESSION 的效果）
+	double density = std::stod(Environment::GetOrDefault("DENSITY", "1"));
 	int rank = MyRank();
 	srand(rank + 7);
 	for (int i = 0; i < num; ++i) {
 		keys[i] = kMaxKey / num * i + rank;
-		vals[i] = (rand() % 1000);
+		vals[i] = rand() < density * RAND_MAX ? (rand() % 1000) : 0;
 	}
 
-	int repeat = 1;
+	int repeat = Environment::GetIntOrDefault("REPEAT", 1);
 
 	// push
 	auto start = std::chrono::high_resolution_clock::now();
@@ -61,7 +62,8 @@ void RunWorker() {
 	auto end = std::chrono::high_resolution_clock::now();
 	{
 		std::ostringstream out;
-		out << "num = " << num << ", Push average time: " << (end - start).count() / 1e6 << "ms" << std::endl;
+		out << "num = " << num << ", codec = " << quantize::CodecName[codec]
+			<< ", Push average time: " << (end - start).count() / 1e6 / repeat << "ms" << std::endl;
 		std::cout << out.str();
 		LOG(WARNING) << out.str(); // 输出到文件避免混乱
 	}
@@ -75,7 +77,8 @@ void RunWorker() {
 	end = std::chrono::high_resolution_clock::now();
 	{
 		std::ostringstream out;
-		out << "num = " << num << ", Pull average time: " << (end - start).count() / 1e6 << "ms" << std::endl;
+		out << "num = " << num << ", codec = " << quantize::CodecName[codec]
+			<< ", Pull average time: " << (end - start).count() / 1e6 / repeat << "ms" << std::endl;
 		std::cout << out.str();
 		LOG(WARNING) << out.str();
 	}